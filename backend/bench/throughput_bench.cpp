@@ -0,0 +1,210 @@
+// Throughput scaling benchmark
+// Runs deposits and withdrawals through BankingService from a growing number
+// of client threads and reports transactions per second at each step. Each
+// thread works on its own random accounts, so the numbers show how far the
+// service scales when clients do not contend for the same account. The
+// accounts' daily limit is lifted so withdrawals are not refused; refused
+// operations are reported apart from completed ones. Ends by checking that
+// the total balance matches the money moved.
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <iomanip>
+#include <filesystem>
+#include "../include/services/BankingService.h"
+#include "../include/core/Database.h"
+#include "../include/models/Account.h"
+
+namespace {
+
+// The service logs every operation on stdout; keep it out of the report
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+};
+
+// High enough that the rolling daily limit never refuses a bench withdrawal
+const double BENCH_DAILY_LIMIT = 1e12;
+
+struct StepResult {
+    size_t threads;
+    size_t transactions;
+    size_t refused;
+    double seconds;
+};
+
+// Lifts the daily limit of the accounts on their stored rows, while no
+// service has the data directory open
+bool raiseDailyLimits(const std::string& data_dir, size_t shards, const std::vector<std::string>& accounts) {
+    Database database(data_dir, shards);
+    if (!database.initialize()) {
+        return false;
+    }
+    for (const auto& account_number : accounts) {
+        Account account;
+        if (!database.loadAccount(account_number, account)) {
+            return false;
+        }
+        account.setDailyLimit(BENCH_DAILY_LIMIT);
+        if (!database.updateAccount(account)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+StepResult runStep(BankingService& service, const std::vector<std::string>& accounts, size_t threads,
+                   double seconds, std::atomic<long long>& net_cents) {
+    std::atomic<bool> stopping{false};
+    std::atomic<size_t> transactions{0};
+    std::atomic<size_t> refused{0};
+
+    std::vector<std::thread> clients;
+    for (size_t t = 0; t < threads; ++t) {
+        clients.emplace_back([&, t]() {
+            std::mt19937 gen(static_cast<unsigned>(t * 7919 + threads));
+            std::uniform_int_distribution<size_t> pick(0, accounts.size() - 1);
+            size_t attempts = 0;
+            size_t done = 0;
+            long long cents = 0;
+            while (!stopping) {
+                const std::string& account = accounts[pick(gen)];
+                // Deposit first so withdrawals never run the balance down;
+                // alternating on attempts keeps a refusal from repeating forever
+                bool deposit = attempts++ % 2 == 0;
+                TransactionResult result = deposit ? service.deposit(account, 2.0, "Bench deposit")
+                                                   : service.withdraw(account, 1.0, "Bench withdrawal");
+                if (result.success) {
+                    cents += deposit ? 200 : -100;
+                    done++;
+                }
+            }
+            transactions += done;
+            refused += attempts - done;
+            net_cents += cents;
+        });
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stopping = true;
+    for (auto& client : clients) {
+        client.join();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return {threads, transactions.load(), refused.load(), elapsed};
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    double seconds = 2.0;
+    size_t max_threads = 16;
+    size_t account_count = 256;
+    size_t shard_count = 4;
+    std::string mode = "pessimistic";
+    if (argc > 1) {
+        seconds = std::stod(argv[1]);
+    }
+    if (argc > 2) {
+        max_threads = std::stoul(argv[2]);
+    }
+    if (argc > 3) {
+        account_count = std::stoul(argv[3]);
+    }
+    if (argc > 4) {
+        shard_count = std::stoul(argv[4]);
+    }
+    if (argc > 5) {
+        mode = argv[5]; // pessimistic, optimistic, ledger or executors
+    }
+
+    std::filesystem::path data_dir = std::filesystem::temp_directory_path() / "banking_throughput_bench";
+    std::filesystem::remove_all(data_dir);
+
+    std::ostream report(std::cout.rdbuf());
+    static NullBuffer null_buffer;
+    std::cout.rdbuf(&null_buffer);
+
+    std::vector<StepResult> steps;
+    double expected_total = 0.0;
+    double actual_total = 0.0;
+    std::vector<std::string> accounts;
+    {
+        BankingService setup(data_dir.string(), shard_count);
+        if (!setup.initialize()) {
+            report << "Failed to initialize benchmark service" << std::endl;
+            return 1;
+        }
+
+        AuthResult owner = setup.registerUser("benchowner", "benchpass", "bench@bank.com", "Bench Owner");
+        if (!owner.success) {
+            report << "Failed to create benchmark user: " << owner.message << std::endl;
+            return 1;
+        }
+
+        for (size_t i = 0; i < account_count; ++i) {
+            AccountCreationResult created = setup.createAccount(owner.user_id, "SAVINGS", 1000.0);
+            if (!created.success) {
+                report << "Failed to create benchmark account: " << created.message << std::endl;
+                return 1;
+            }
+            accounts.push_back(created.account_number);
+        }
+    }
+    if (!raiseDailyLimits(data_dir.string(), shard_count, accounts)) {
+        report << "Failed to raise the benchmark accounts' daily limits" << std::endl;
+        return 1;
+    }
+
+    {
+        BankingService service(data_dir.string(), shard_count);
+        if (!service.initialize()) {
+            report << "Failed to initialize benchmark service" << std::endl;
+            return 1;
+        }
+        if (mode == "optimistic") {
+            service.setConcurrencyMode(ConcurrencyMode::OPTIMISTIC);
+        } else if (mode == "ledger") {
+            service.enableLedger();
+        } else if (mode == "executors") {
+            service.enableExecutors(std::max(1u, std::thread::hardware_concurrency()));
+        }
+
+        double balance_before = service.getTotalSystemBalance();
+        std::atomic<long long> net_cents{0};
+        for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+            steps.push_back(runStep(service, accounts, threads, seconds, net_cents));
+        }
+        expected_total = balance_before + net_cents / 100.0;
+        service.flushLedger();
+        actual_total = service.getTotalSystemBalance();
+    }
+
+    report << "Mode: " << mode << ", accounts: " << account_count
+           << ", shards: " << shard_count
+           << ", hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+    report << std::fixed << std::setprecision(1);
+    double base_tps = 0.0;
+    for (const auto& step : steps) {
+        double tps = step.transactions / step.seconds;
+        if (base_tps == 0.0) {
+            base_tps = tps;
+        }
+        report << std::setw(3) << step.threads << " threads: " << std::setw(10) << tps << " TPS, "
+               << std::setprecision(2) << (base_tps > 0 ? tps / base_tps : 0.0) << "x" << std::setprecision(1)
+               << ", refused: " << step.refused << std::endl;
+    }
+
+    bool balanced = std::abs(expected_total - actual_total) < 0.005;
+    report << std::setprecision(2) << "Total balance " << actual_total << ", expected " << expected_total
+           << (balanced ? " (ok)" : " (MISMATCH)") << std::endl;
+
+    std::filesystem::remove_all(data_dir);
+    return balanced ? 0 : 1;
+}
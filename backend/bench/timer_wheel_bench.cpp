@@ -0,0 +1,50 @@
+// Timer wheel benchmark
+// Schedules N timers spread over a month, like standing orders, then runs
+// an hour of one-second ticks and reports the cost per tick. With the
+// hierarchical wheel the tick cost follows the timers that fire, not N.
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include "../include/core/TimerWheel.h"
+
+int main(int argc, char* argv[]) {
+    std::vector<size_t> sizes = {10000, 100000, 1000000, 4000000};
+    if (argc > 1) {
+        sizes = {static_cast<size_t>(std::stoull(argv[1]))};
+    }
+    const std::time_t month = 30 * 24 * 3600;
+    const int ticks = 3600;
+
+    std::cout << std::setw(10) << "timers" << std::setw(14) << "schedule ns" << std::setw(14) << "tick us"
+              << std::setw(10) << "fired" << std::endl;
+    for (size_t count : sizes) {
+        std::mt19937_64 rng(42);
+        std::time_t start = 1700000000;
+        TimerWheel wheel(start);
+
+        auto scheduled = std::chrono::steady_clock::now();
+        for (size_t id = 0; id < count; ++id) {
+            wheel.schedule(id, start + 1 + static_cast<std::time_t>(rng() % month));
+        }
+        double schedule_ns = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - scheduled).count() / count;
+
+        std::vector<TimerEntry> due;
+        size_t fired = 0;
+        auto ticking = std::chrono::steady_clock::now();
+        for (int tick = 1; tick <= ticks; ++tick) {
+            due.clear();
+            wheel.advance(start + tick, due);
+            fired += due.size();
+        }
+        double tick_us = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - ticking).count() / ticks;
+
+        std::cout << std::setw(10) << count << std::setw(14) << std::fixed << std::setprecision(1) << schedule_ns
+                  << std::setw(14) << std::setprecision(3) << tick_us << std::setw(10) << fired << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,105 @@
+// Transfer write benchmark
+// Compares the per-record write path (two updateAccount calls plus one
+// saveTransaction) with the batch path (updateAccounts + saveTransactions)
+// and reports file writes and wall time per transfer.
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <filesystem>
+#include "../include/core/Database.h"
+#include "../include/models/Account.h"
+#include "../include/models/Transaction.h"
+
+namespace {
+
+// The storage layer is chatty on stdout; keep it out of the report
+class QuietScope {
+public:
+    QuietScope() : saved(std::cout.rdbuf(sink.rdbuf())) {}
+    ~QuietScope() { std::cout.rdbuf(saved); }
+private:
+    std::ostringstream sink;
+    std::streambuf* saved;
+};
+
+struct BenchResult {
+    size_t writes;
+    double elapsed_ms;
+};
+
+BenchResult runTransfers(Database& db, Account& from, Account& to, int iterations, bool batched) {
+    size_t writes_before = db.getFileWriteCount();
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < iterations; ++i) {
+        double balance_before = from.getBalance();
+        from.transfer(1.0, to);
+
+        Transaction transaction(from.getAccountNumber(), to.getAccountNumber(), 1.0,
+                                TransactionType::TRANSFER, "Bench transfer");
+        transaction.setStatus(TransactionStatus::COMPLETED);
+        transaction.setBalanceBefore(balance_before);
+        transaction.setBalanceAfter(from.getBalance());
+
+        if (batched) {
+            db.updateAccounts({from, to});
+            db.saveTransactions({transaction});
+        } else {
+            db.updateAccount(from);
+            db.updateAccount(to);
+            db.saveTransaction(transaction);
+        }
+        // Each update stores the next version
+        from.setVersion(from.getVersion() + 1);
+        to.setVersion(to.getVersion() + 1);
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return {db.getFileWriteCount() - writes_before,
+            std::chrono::duration<double, std::milli>(elapsed).count()};
+}
+
+void report(const std::string& label, const BenchResult& result, int iterations) {
+    std::cout << label << ": "
+              << static_cast<double>(result.writes) / iterations << " writes/transfer, "
+              << result.elapsed_ms / iterations << " ms/transfer" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int iterations = 200;
+    if (argc > 1) {
+        iterations = std::stoi(argv[1]);
+    }
+
+    std::filesystem::path data_dir = std::filesystem::temp_directory_path() / "banking_transfer_bench";
+    std::filesystem::remove_all(data_dir);
+
+    BenchResult per_record{0, 0.0};
+    BenchResult batched{0, 0.0};
+    {
+        QuietScope quiet;
+        Database db(data_dir.string());
+        if (!db.initialize()) {
+            std::cerr << "Failed to initialize benchmark database" << std::endl;
+            return 1;
+        }
+
+        Account from(db.generateAccountNumber(), "USR000001", AccountType::BUSINESS, 1000000.0);
+        Account to(db.generateAccountNumber(), "USR000002", AccountType::BUSINESS, 1000.0);
+        db.saveAccount(from);
+        db.saveAccount(to);
+
+        per_record = runTransfers(db, from, to, iterations, false);
+        batched = runTransfers(db, from, to, iterations, true);
+    }
+
+    std::cout << "Transfers per run: " << iterations << std::endl;
+    report("per-record", per_record, iterations);
+    report("batched   ", batched, iterations);
+
+    std::filesystem::remove_all(data_dir);
+    return 0;
+}
@@ -0,0 +1,224 @@
+// Transfer deadlock stress test
+// Many client threads transfer random amounts between a handful of accounts
+// in both directions (A->B and B->A at the same time), which is the pattern
+// that deadlocks unordered two-lock protocols. A watchdog fails the run if
+// no transfer completes for several seconds. At the end the total balance
+// must be unchanged and every account must match its transaction history.
+// The accounts' daily limit is lifted so refusals stay rare.
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <iomanip>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include "../include/services/BankingService.h"
+#include "../include/core/Database.h"
+#include "../include/models/Account.h"
+
+namespace {
+
+// The service logs every operation on stdout; keep it out of the report
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+};
+
+// No completed transfer for this long counts as a deadlock
+const std::chrono::seconds STALL_LIMIT(10);
+
+// High enough that the rolling daily limit never refuses a stress transfer
+const double STRESS_DAILY_LIMIT = 1e12;
+
+// Lifts the daily limit of the accounts on their stored rows, while no
+// service has the data directory open
+bool raiseDailyLimits(const std::string& data_dir, size_t shards, const std::vector<std::string>& accounts) {
+    Database database(data_dir, shards);
+    if (!database.initialize()) {
+        return false;
+    }
+    for (const auto& account_number : accounts) {
+        Account account;
+        if (!database.loadAccount(account_number, account)) {
+            return false;
+        }
+        account.setDailyLimit(STRESS_DAILY_LIMIT);
+        if (!database.updateAccount(account)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    double seconds = 5.0;
+    size_t threads = 16;
+    size_t account_count = 4;
+    std::string mode = "pessimistic";
+    if (argc > 1) {
+        seconds = std::stod(argv[1]);
+    }
+    if (argc > 2) {
+        threads = std::stoul(argv[2]);
+    }
+    if (argc > 3) {
+        account_count = std::max<size_t>(2, std::stoul(argv[3]));
+    }
+    if (argc > 4) {
+        mode = argv[4]; // pessimistic, optimistic, ledger or executors
+    }
+
+    std::filesystem::path data_dir = std::filesystem::temp_directory_path() / "banking_transfer_stress";
+    std::filesystem::remove_all(data_dir);
+
+    std::ostream report(std::cout.rdbuf());
+    static NullBuffer null_buffer;
+    std::cout.rdbuf(&null_buffer);
+
+    const size_t shard_count = 4;
+    auto service = std::make_unique<BankingService>(data_dir.string(), shard_count);
+    if (!service->initialize()) {
+        report << "Failed to initialize stress service" << std::endl;
+        return 1;
+    }
+    AuthResult owner = service->registerUser("stressowner", "stresspass", "stress@bank.com", "Stress Owner");
+    if (!owner.success) {
+        report << "Failed to create stress user: " << owner.message << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> accounts;
+    for (size_t i = 0; i < account_count; ++i) {
+        AccountCreationResult created = service->createAccount(owner.user_id, "BUSINESS", 10000.0);
+        if (!created.success) {
+            report << "Failed to create stress account: " << created.message << std::endl;
+            return 1;
+        }
+        accounts.push_back(created.account_number);
+    }
+
+    // The accounts are set up, then reopened with limits out of the way and
+    // the mode under test
+    service.reset();
+    if (!raiseDailyLimits(data_dir.string(), shard_count, accounts)) {
+        report << "Failed to raise the stress accounts' daily limits" << std::endl;
+        return 1;
+    }
+    service = std::make_unique<BankingService>(data_dir.string(), shard_count);
+    if (!service->initialize()) {
+        report << "Failed to reopen stress service" << std::endl;
+        return 1;
+    }
+    if (mode == "optimistic") {
+        service->setConcurrencyMode(ConcurrencyMode::OPTIMISTIC);
+    } else if (mode == "ledger") {
+        service->enableLedger();
+    } else if (mode == "executors") {
+        service->enableExecutors(std::max(1u, std::thread::hardware_concurrency()));
+    }
+
+    double total_before = 0.0;
+    for (const auto& account : accounts) {
+        double balance = 0.0;
+        service->getAccountBalance(account, balance);
+        total_before += balance;
+    }
+
+    std::atomic<bool> stopping{false};
+    std::atomic<size_t> completed{0};
+    std::atomic<size_t> refused{0};
+
+    // Fails the run instead of hanging it
+    std::thread watchdog([&]() {
+        size_t last = 0;
+        auto last_progress = std::chrono::steady_clock::now();
+        while (!stopping) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            size_t now_completed = completed.load() + refused.load();
+            if (now_completed != last) {
+                last = now_completed;
+                last_progress = std::chrono::steady_clock::now();
+            } else if (std::chrono::steady_clock::now() - last_progress > STALL_LIMIT) {
+                report << "DEADLOCK: no transfer finished in " << STALL_LIMIT.count() << " s with "
+                       << threads << " threads" << std::endl;
+                std::_Exit(2);
+            }
+        }
+    });
+
+    std::vector<std::thread> clients;
+    for (size_t t = 0; t < threads; ++t) {
+        clients.emplace_back([&, t]() {
+            std::mt19937 gen(static_cast<unsigned>(t * 104729 + 17));
+            std::uniform_int_distribution<size_t> pick(0, accounts.size() - 1);
+            std::uniform_int_distribution<int> cents(1, 5000);
+            while (!stopping) {
+                size_t from = pick(gen);
+                size_t to = pick(gen);
+                if (from == to) {
+                    continue;
+                }
+                TransactionResult result = service->transfer(accounts[from], accounts[to],
+                                                            cents(gen) / 100.0, "Stress transfer");
+                (result.success ? completed : refused)++;
+            }
+        });
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stopping = true;
+    for (auto& client : clients) {
+        client.join();
+    }
+    watchdog.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    service->flushLedger();
+
+    // Replay each account's history from its opening balance
+    bool consistent = true;
+    double total_after = 0.0;
+    for (const auto& account : accounts) {
+        double balance = 0.0;
+        service->getAccountBalance(account, balance);
+        total_after += balance;
+
+        double replayed = 0.0;
+        for (const auto& transaction : service->getAccountTransactions(account)) {
+            if (transaction.getToAccountId() == account) {
+                replayed += transaction.getAmount();
+            }
+            if (transaction.getFromAccountId() == account) {
+                replayed -= transaction.getAmount();
+            }
+        }
+        if (std::abs(replayed - balance) > 0.005) {
+            report << "Account " << account << " balance " << balance << " but history gives " << replayed
+                   << std::endl;
+            consistent = false;
+        }
+    }
+    bool conserved = std::abs(total_after - total_before) < 0.005;
+
+    report << std::fixed << std::setprecision(2);
+    report << threads << " threads, " << account_count << " accounts, " << elapsed << " s, "
+           << mode << std::endl;
+    report << "Transfers completed: " << completed << " (" << completed / elapsed << "/s), refused: " << refused
+           << std::endl;
+    report << "Total balance " << total_after << ", before " << total_before
+           << (conserved ? " (ok)" : " (MISMATCH)") << std::endl;
+    report << "Balances match history: " << (consistent ? "yes" : "NO") << std::endl;
+
+    service.reset();
+    std::filesystem::remove_all(data_dir);
+    return conserved && consistent ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+#ifndef ACCOUNT_EXECUTORS_H
+#define ACCOUNT_EXECUTORS_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+#include "../models/Account.h"
+
+struct ExecutorStats {
+    size_t executors = 0;
+    size_t commands = 0;     // Run so far, all executors
+    size_t queued = 0;       // Submitted, not finished yet
+    size_t max_queued = 0;   // Deepest any single queue has been
+    size_t cached_accounts = 0;
+};
+
+// Accounts hash-partitioned across single-writer executor threads. Every
+// command for an account runs on the thread that owns it, one at a time and
+// in submission order, so the owner needs no lock to read-modify-write its
+// accounts. Each executor reads a lock-free multi-producer queue; any
+// thread may submit.
+//
+// An executor keeps the accounts it owns in memory as last committed, so a
+// command reads them without going to the files. Changes are still
+// committed before they are acknowledged: acknowledging from memory and
+// writing behind is what the balance ledger is for. A copy made stale by a
+// write from outside the executors is caught by the version check of the
+// commit, after which the command drops it and reads the account again;
+// a command refused on the strength of cached copies drops them and is
+// tried once more against the files (see forgetServed).
+//
+// A command must not wait for another executor: work that spans two
+// owners is split into steps, each step submitting the next one.
+class AccountExecutors {
+public:
+    using Command = std::function<void()>;
+
+private:
+    struct Node {
+        Node* next = nullptr;
+        Command command;
+    };
+
+    struct Executor {
+        AccountExecutors* owner = nullptr;
+        size_t index = 0;
+        std::atomic<Node*> pending{nullptr}; // Newest first
+        std::atomic<size_t> queued{0};
+        std::atomic<size_t> max_queued{0};
+        std::mutex mutex;                    // Only to sleep on while the queue is empty
+        std::condition_variable ready;
+        std::unordered_map<std::string, Account> accounts; // Owned, as last committed; executor thread only
+        std::vector<std::string> served; // Cache hits of the command running now
+        std::atomic<size_t> cached{0};
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Executor>> executors;
+    std::atomic<size_t> in_flight{0}; // Submitted and not finished, all executors
+    std::atomic<size_t> commands_run{0};
+    std::atomic<bool> stopping{false};
+
+    static thread_local Executor* current; // The executor running on this thread, if any
+
+    void run(Executor& executor);
+    Executor* ownerHere(const std::string& account_number) const; // current, if it owns the account
+
+public:
+    explicit AccountExecutors(size_t executor_count);
+    ~AccountExecutors(); // Runs everything already submitted, follow-up steps included
+
+    AccountExecutors(const AccountExecutors&) = delete;
+    AccountExecutors& operator=(const AccountExecutors&) = delete;
+
+    size_t size() const;
+    size_t ownerOf(const std::string& account_number) const;
+    void submit(size_t executor, Command command);
+
+    // The owned-account cache of the calling executor. Lookups fail and
+    // updates are ignored off the executors and for other owners' accounts.
+    bool cachedAccount(const std::string& account_number, Account& account) const;
+    void cacheAccount(const Account& account); // As stored, version included
+    void forgetAccount(const std::string& account_number);
+    // Drops the copies the running command was served; false if there were none
+    bool forgetServed();
+
+    ExecutorStats getStats();
+};
+
+#endif // ACCOUNT_EXECUTORS_H
@@ -0,0 +1,36 @@
+#ifndef ACCOUNT_LOCK_TABLE_H
+#define ACCOUNT_LOCK_TABLE_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <utility>
+
+// Striped locks keyed by account number. Operations on accounts that map to
+// different stripes run in parallel; accounts sharing a stripe serialize.
+// The stripe count is fixed, so taking a lock never allocates and the table
+// needs no lock of its own.
+class AccountLockTable {
+private:
+    std::vector<std::mutex> stripes;
+
+public:
+    explicit AccountLockTable(size_t stripe_count = 1024);
+
+    AccountLockTable(const AccountLockTable&) = delete;
+    AccountLockTable& operator=(const AccountLockTable&) = delete;
+
+    size_t stripeOf(const std::string& account_number) const;
+    std::unique_lock<std::mutex> lock(const std::string& account_number);
+
+    // Both accounts' stripes (once when they share one), lowest stripe
+    // first, so pairs locked this way can never deadlock each other
+    std::pair<std::unique_lock<std::mutex>, std::unique_lock<std::mutex>>
+    lockPair(const std::string& first, const std::string& second);
+
+    // Every distinct stripe of the accounts in one ascending pass, the same
+    // order lockPair uses, so a batch never deadlocks a pair or another batch
+    std::vector<std::unique_lock<std::mutex>> lockAll(const std::vector<std::string>& account_numbers);
+};
+
+#endif // ACCOUNT_LOCK_TABLE_H
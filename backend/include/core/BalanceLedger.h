@@ -0,0 +1,137 @@
+#ifndef BALANCE_LEDGER_H
+#define BALANCE_LEDGER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include "Database.h"
+#include "VelocityCounters.h"
+#include "../models/Account.h"
+#include "../models/Transaction.h"
+
+// Outcome of a ledger balance change
+enum class LedgerResult {
+    APPLIED,
+    NOT_FOUND,
+    INACTIVE,
+    INVALID_AMOUNT,     // Rounds to less than a cent
+    INSUFFICIENT_FUNDS, // Below minimum_balance or over the per-transaction limit
+    OVER_DAILY_LIMIT,   // Would take the rolling 24-hour debits over daily_limit
+    FULL                // No free slot for an account not cached yet
+};
+
+struct LedgerStats {
+    size_t accounts = 0;          // Cached in the ledger
+    size_t capacity = 0;
+    uint64_t applied = 0;         // Balance changes acknowledged
+    uint64_t persisted = 0;       // Of those, written to the database
+    uint64_t failed = 0;          // Of those, dropped because an account could not be read
+    uint64_t batches = 0;         // Writer commits
+    uint64_t write_failures = 0;  // Batches the writer had to retry
+};
+
+// In-memory balance ledger for deposits, withdrawals and transfers.
+//
+// Each cached account keeps its balance as an atomic count of cents on its
+// own cache line. A change is one compare-and-swap loop that enforces
+// minimum_balance and the daily limit, so concurrent clients never take a
+// lock. The change is then pushed on a lock-free log that a background
+// writer drains every few milliseconds, committing each batch of
+// transactions with the new account balances as one database unit.
+//
+// Changes are acknowledged before they are durable: a crash loses whatever
+// the writer had not committed yet. flush() waits until everything applied
+// so far is written. While the ledger is in use every balance change must
+// go through it: the writer owns the balance column of cached accounts.
+//
+// Status and limits are copied from the account row and re-read from it
+// whenever the writer commits the account, and at most a second after the
+// last read otherwise. A change whose account can no longer be read is
+// dropped and undone in memory rather than retried forever.
+class BalanceLedger {
+private:
+    struct alignas(64) Entry {
+        std::atomic<int64_t> balance_cents{0};
+        std::atomic<bool> active{true};
+        std::atomic<int64_t> minimum_cents{0};
+        std::atomic<int64_t> limit_cents{0};
+        std::atomic<int64_t> checked_ms{0}; // When the row was last read
+        std::string account_number;
+        int64_t persisted_cents = 0; // Writer thread only
+    };
+
+    // One acknowledged change waiting for the writer
+    struct Record {
+        Record* next = nullptr;
+        Transaction transaction;
+        Entry* legs[2] = {nullptr, nullptr};
+        int64_t deltas[2] = {0, 0};
+        std::time_t reserved_at = 0; // Debits: when the daily limit was reserved
+    };
+
+    Database& database;
+    std::chrono::milliseconds flush_interval;
+    VelocityCounters* velocity; // Rolling daily limits; checked when set
+
+    // Open addressing, never shrinks; entries live until the ledger goes
+    std::vector<std::atomic<Entry*>> slots;
+    std::atomic<size_t> entry_count{0};
+
+    std::atomic<Record*> pending{nullptr}; // Newest first
+    std::vector<Record*> unwritten;        // Writer thread only, oldest first
+    std::atomic<uint64_t> applied{0};
+    std::atomic<uint64_t> persisted{0};
+    std::atomic<uint64_t> failed{0};
+    std::atomic<uint64_t> batches{0};
+    std::atomic<uint64_t> write_failures{0};
+
+    std::mutex writer_mutex;
+    std::condition_variable writer_cv;  // Wakes the writer early
+    std::condition_variable written_cv; // Wakes flush() callers
+    bool stopping;
+    std::thread writer_thread;
+
+    Entry* find(const std::string& account_number);
+    Entry* acquire(const std::string& account_number, bool& full);
+    void refresh(Entry* entry, const Account& account);
+    void revalidate(Entry* entry);
+    bool debit(Entry* entry, int64_t cents, int64_t& before);
+    void push(Record* record);
+    uint64_t settled() const; // Records written or dropped
+    void drop(Record* record);
+    void writerLoop();
+    bool writeBatch();
+
+public:
+    explicit BalanceLedger(Database& db, size_t capacity = 1 << 20,
+                           std::chrono::milliseconds flush_interval = std::chrono::milliseconds(2));
+    ~BalanceLedger(); // Writes everything still pending
+
+    BalanceLedger(const BalanceLedger&) = delete;
+    BalanceLedger& operator=(const BalanceLedger&) = delete;
+
+    void setVelocityCounters(VelocityCounters* counters); // Call before start()
+    void start();
+    void stop();
+
+    // The new balance and the recorded transaction are filled in on APPLIED
+    LedgerResult deposit(const std::string& account_number, double amount, const std::string& description,
+                         double& new_balance, Transaction& transaction);
+    LedgerResult withdraw(const std::string& account_number, double amount, const std::string& description,
+                          double& new_balance, Transaction& transaction);
+    LedgerResult transfer(const std::string& from_account, const std::string& to_account, double amount,
+                          const std::string& description, double& new_balance, Transaction& transaction);
+
+    bool getBalance(const std::string& account_number, double& balance); // false if not cached
+    bool flush(std::chrono::milliseconds timeout = std::chrono::milliseconds(5000));
+
+    LedgerStats getStats();
+};
+
+#endif // BALANCE_LEDGER_H
@@ -4,43 +4,313 @@
 #include <string>
 #include <vector>
 #include <mutex>
+#include <shared_mutex>
 #include <memory>
 #include <functional>
+#include <atomic>
+#include <fstream>
+#include <cstdint>
+#include <thread>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+#include <map>
+#include <set>
+#include <ctime>
 #include "../models/User.h"
 #include "../models/Transaction.h"
+#include "../models/StandingOrder.h"
+#include "FileHandleManager.h"
 
 // Forward declaration
 class Account;
 
+// Background compaction progress, exposed for monitoring
+struct CompactionStats {
+    size_t runs = 0;
+    std::uintmax_t bytes_reclaimed = 0;
+    bool in_progress = false;
+    std::string current_file;
+    double progress = 0.0; // Fraction of the current file copied
+};
+
+// Paging for streaming scans. Results arrive in storage order; a resume
+// token continues right after the last row handed out, even if rows were
+// appended in between. Tokens are invalidated when compaction rewrites the
+// shard they point into.
+struct ScanOptions {
+    size_t limit = 0;             // Rows to deliver, 0 = no limit
+    size_t offset = 0;            // Matching rows to skip first
+    std::string resume_token;     // From a previous ScanResult; empty = start
+    std::time_t since = 0;        // Skip rows older than this; 0 = all
+};
+
+struct ScanResult {
+    bool ok = true;               // false if the resume token is invalid or expired
+    size_t returned = 0;
+    bool has_more = false;
+    std::string resume_token;     // Set when has_more
+};
+
+// Hot tier of the transaction shards. Scans that only need rows newer
+// than everything on disk (ScanOptions::since) are served from memory.
+struct TieringStats {
+    size_t hot_rows = 0;
+    std::uintmax_t hot_bytes = 0;
+    size_t demoted_rows = 0;      // Moved out of memory by age or size
+    size_t hot_reads = 0;         // Shard scans and lookups served from memory only
+    size_t disk_reads = 0;        // Shard scans and lookups that read the file
+};
+
+// Outcome of a version-checked write
+enum class CommitResult {
+    COMMITTED,
+    CONFLICT,   // A row changed since it was read; reload and retry
+    FAILED      // Missing row or I/O error
+};
+
+// A row write as shipped to a standby
+struct ReplicatedRow {
+    std::string key;
+    std::string row;
+    bool tombstone = false;
+};
+
+class LogShipper;
+class TaskPool;
+
+using TransactionVisitor = std::function<bool(const Transaction&)>; // Return false to stop
+using TransactionFilter = std::function<bool(const Transaction&)>;
+using RowVisitor = std::function<bool(const std::string& row)>; // Raw CSV row; return false to stop
+
 class Database {
 private:
+    // Where a row version lives inside its data file
+    struct RowLocation {
+        std::uintmax_t offset = 0;
+        std::uintmax_t length = 0; // Including the line terminator
+    };
+
+    // A transaction row held in the hot tier
+    struct HotRow {
+        std::shared_ptr<const Transaction> transaction;
+        std::uintmax_t length = 0;
+        std::time_t time = 0;
+    };
+
+    // One append-only data file. Updates append a new row version and
+    // deletes append a tombstone; the superseded rows stay in the file as
+    // garbage until the compaction thread rewrites it.
+    struct Table {
+        std::string name;   // users, accounts, transactions, idempotency or standing_orders
+        size_t shard = 0;
+        std::string file;
+        // Shared for point reads and snapshot opens, exclusive for appends
+        // and anything else that changes the state below
+        std::shared_mutex mutex;
+        std::unordered_map<std::string, RowLocation> live_rows;     // key -> current version
+        std::unordered_map<std::uintmax_t, std::uintmax_t> dead_rows; // offset -> length
+        std::uintmax_t end_offset = 0;
+        std::uintmax_t garbage_bytes = 0;
+        std::uintmax_t indexed_offset = 0; // end_offset covered by <file>.idx
+        uint64_t generation = 0;           // Changes whenever the file is rewritten
+        
+        // Transaction shards also keep their live rows inside the hot window
+        // in memory; every other live row is at most as new as cold_newest
+        bool tiered = false;
+        std::map<std::uintmax_t, HotRow> hot_rows;                                 // offset -> row
+        std::unordered_map<std::string, std::set<std::uintmax_t>> hot_by_account;  // account -> offsets
+        std::set<std::pair<std::time_t, std::uintmax_t>> hot_by_time;              // demotion order
+        std::uintmax_t hot_bytes = 0;
+        std::time_t cold_newest = 0;
+        
+        bool bulk_loading = false;         // Rows appended past the index; see finishBulkImport()
+        std::atomic<size_t> open_snapshots{0}; // ReadSnapshots holding the file open
+    };
+
+    // The contents of <file>.idx, copied out of a table so that the file
+    // can be written without holding the table's lock
+    struct IndexImage {
+        std::uintmax_t end_offset = 0;
+        std::uintmax_t garbage_bytes = 0;
+        uint64_t generation = 0;
+        std::vector<std::pair<std::string, RowLocation>> live_rows;
+        std::vector<std::pair<std::uintmax_t, std::uintmax_t>> dead_rows;
+    };
+
+    // A row to append: a new version of key, or a tombstone for it
+    struct RowWrite {
+        std::string key;
+        std::string row;
+        bool tombstone = false;
+    };
+
     std::string data_directory;
-    std::mutex users_mutex;
-    std::mutex accounts_mutex;
-    std::mutex transactions_mutex;
-    
-    // File paths
-    std::string users_file;
-    std::string accounts_file;
-    std::string transactions_file;
+    std::atomic<size_t> file_write_count{0}; // Whole-file rewrites; appends are counted by FileHandleManager
+
+    Table users_table;
+    Table idempotency_table; // Outcomes of requests made with an Idempotency-Key
+    Table standing_orders_table;
     std::string logs_file;
-    
+
+    // Opened with initializeReadOnly(): nothing under data_directory is
+    // created, rewritten or logged to, and no background work runs
+    bool read_only;
+
+    // Accounts and their transactions are hash-partitioned by account
+    // number; every shard has its own file, lock and append handle
+    size_t shard_count;
+    std::string shard_hash_scheme; // How accounts map to shards, recorded in shards.conf
+    std::vector<std::unique_ptr<Table>> account_shards;
+    std::vector<std::unique_ptr<Table>> transaction_shards;
+
+    // Long-lived buffered append handles for the files above
+    FileHandleManager files;
+
+    // Bumped on every committed write; snapshots record the value they saw
+    std::atomic<uint64_t> commit_lsn{0};
+
+    // Ships every committed append to a standby when set
+    LogShipper* log_shipper;
+
+    // Declared first in every public write. With synchronous log shipping
+    // the standby's acknowledgement is awaited when it goes out of scope,
+    // after the write's table locks are released, so readers and writers
+    // of those tables do not stall for a standby round trip
+    class StandbyAckWait {
+    private:
+        Database& database;
+    public:
+        explicit StandbyAckWait(Database& database);
+        ~StandbyAckWait();
+    };
+
+    // Runs one-off fan-out work such as bulk index builds; a temporary
+    // pool is used when none is set
+    TaskPool* task_pool;
+
+    // A consistent view of one data file that is scanned without holding the
+    // table mutex. The open descriptor pins the file version (compaction
+    // swaps in a new file by rename), end_offset pins the committed length so
+    // later appends are not visible, and dead_offsets hides superseded rows.
+    struct ReadSnapshot {
+        Table* table = nullptr;   // Counted in its open_snapshots while set
+        std::ifstream stream;
+        std::uintmax_t end_offset = 0;
+        std::uintmax_t position = 0;
+        std::uintmax_t line_offset = 0; // Offset of the line last returned
+        std::unordered_set<std::uintmax_t> dead_offsets;
+        uint64_t lsn = 0;
+        uint64_t generation = 0;
+        
+        ReadSnapshot() = default;
+        ReadSnapshot(const ReadSnapshot&) = delete;
+        ReadSnapshot& operator=(const ReadSnapshot&) = delete;
+        ~ReadSnapshot() {
+            if (table) {
+                table->open_snapshots--;
+            }
+        }
+    };
+    bool openSnapshot(Table& table, ReadSnapshot& snapshot);
+    bool openSnapshotLocked(Table& table, ReadSnapshot& snapshot);
+    bool nextSnapshotLine(ReadSnapshot& snapshot, std::string& line);
+
+    // Append-only table helpers; callers hold table.mutex (shared is enough for readRowLocked)
+    bool loadTableState(Table& table);
+    bool saveTableIndex(Table& table);  // Persist live/dead rows to <file>.idx
+    // Same, but takes its own locks: the rows are copied under a shared lock
+    // and written with none, so writers never wait for the file
+    bool checkpointTableIndex(Table& table);
+    void captureIndexLocked(const Table& table, IndexImage& image);
+    bool writeIndexImage(const std::string& path, const IndexImage& image);
+    bool loadTableIndex(Table& table);
+    bool appendRows(Table& table, const std::vector<RowWrite>& writes);
+    bool readRowLocked(Table& table, const std::string& key, std::string& row);
+    CommitResult prepareAccountWritesLocked(const std::map<Table*, std::vector<const Account*>>& batch,
+                                            std::map<Table*, std::vector<RowWrite>>& writes,
+                                            std::map<Table*, std::vector<RowWrite>>* previous);
+
+    // Shard routing
+    void createShards();
+    bool loadShardManifest();
+    // A snapshot switch cut short by a crash: puts the previous files back
+    // if it had not finished, or clears what it left behind if it had
+    bool recoverSnapshotSwitch();
+    std::string snapshotSwitchMarker() const;
+    size_t shardIndex(const std::string& account_number) const;
+    Table& accountShard(const std::string& account_number);
+    Table& transactionShard(const Transaction& transaction);
+    Table* findTransactionShard(const std::string& transaction_id);
+    std::vector<Table*> allTables();
+    Table* findTable(const std::string& name, size_t shard);
+
+    // Hot tier; callers hold table.mutex
+    std::time_t hot_window_seconds;
+    std::uintmax_t hot_max_bytes;
+    std::atomic<size_t> demoted_rows{0};
+    std::atomic<size_t> hot_reads{0};
+    std::atomic<size_t> disk_reads{0};
+    void addHotRow(Table& table, const RowLocation& location, const std::string& row);
+    void removeHotRow(Table& table, std::uintmax_t offset);
+    void demoteHotRows(Table& table);
+    bool loadHotTier(Table& table);
+    ScanResult scanTransactionShards(const TransactionFilter& filter, const std::string* account_id,
+                                     const ScanOptions& options, const TransactionVisitor& visitor);
+
+    // Background compaction of superseded rows and tombstones; the same
+    // thread checkpoints the table indexes and demotes aged hot rows
+    double compaction_garbage_ratio;
+    std::uintmax_t compaction_min_garbage_bytes;
+    std::uintmax_t compaction_io_budget; // Bytes per second
+    std::thread compaction_thread;
+    std::mutex compaction_mutex;
+    std::condition_variable compaction_cv;
+    std::atomic<bool> compaction_stopping;
+    std::mutex compaction_stats_mutex;
+    CompactionStats compaction_stats;
+    bool needsCompaction(const Table& table) const;
+    bool compactTable(Table& table);
+    void compactionLoop();
+    void startCompaction();
+    void stopCompaction();
+
     // Internal helper methods
     bool ensureDirectoryExists(const std::string& path);
     bool backupFile(const std::string& file_path);
     std::string getCurrentTimestamp();
     void logOperation(const std::string& operation, const std::string& details);
     bool loadUserInternal(const std::string& user_id, User& user); // Private version without mutex
-    
+
     // ADD THIS LINE - Missing hashPassword declaration
     std::string hashPassword(const std::string& password);
 
 public:
+    // Row written in place of a deleted key: "<key>,__DELETED__"
+    static constexpr const char* TOMBSTONE_MARKER = "__DELETED__";
+
+    // On-disk layout, shared with processes that follow a data directory
+    static std::string shardFilePath(const std::string& data_dir, const std::string& table,
+                                     size_t shard, size_t shard_count);
+    static size_t readShardManifest(const std::string& data_dir); // 0 if absent
+    // Shard placement schemes: FNV-1a of the account number, or std::hash
+    // for directories sharded before the scheme was recorded
+    static constexpr const char* SHARD_HASH_FNV1A = "fnv1a";
+    static constexpr const char* SHARD_HASH_STD = "std";
+    static uint64_t shardHash(const std::string& account_number);
+
     // Constructor
-    Database(const std::string& data_dir = "data");
-    
+    Database(const std::string& data_dir = "data", size_t shards = 1);
+    ~Database();
+
     // Initialization
     bool initialize();
+    // Opens an existing data directory for reading only, for offline tools
+    // that must not touch it: no files or directories are created, no
+    // sample data, no compaction thread, no index checkpoints and no log
+    // entries. Writes through a read-only Database fail.
+    bool initializeReadOnly();
+    bool isReadOnly() const;
     bool createSampleData();
 
     // User operations
@@ -55,7 +325,22 @@ public:
     // Account operations
     bool saveAccount(const Account& account);
     bool loadAccount(const std::string& account_number, Account& account);
+    // Account updates are optimistic: each Account carries the version it
+    // was read at, the write is refused if the stored row has moved on since,
+    // and the row is stored with the next version
     bool updateAccount(const Account& account);
+    bool updateAccounts(const std::vector<Account>& accounts); // One append per shard; all or nothing
+    // Updated accounts plus the transaction that changed them, as one unit:
+    // nothing is written if any account is missing or stale, or the record
+    // cannot be written. A non-empty idempotency_key stores idempotency_row
+    // under it in the same unit (an empty row deletes the key)
+    CommitResult commitAccountTransaction(const std::vector<Account>& accounts, const Transaction& transaction,
+                                          const std::string& idempotency_key = "",
+                                          const std::string& idempotency_row = "");
+    CommitResult commitAccountTransactions(const std::vector<Account>& accounts,
+                                           const std::vector<Transaction>& transactions,
+                                           const std::string& idempotency_key = "",
+                                           const std::string& idempotency_row = "");
     bool deleteAccount(const std::string& account_number);
     std::vector<Account> getAllAccounts();
     std::vector<Account> getAccountsByCustomerId(const std::string& customer_id);
@@ -64,24 +349,81 @@ public:
 
     // Transaction operations
     bool saveTransaction(const Transaction& transaction);
-    bool loadTransaction(const std::string& transaction_id, Transaction& transaction);
+    bool saveTransactions(const std::vector<Transaction>& transactions); // One append for the whole batch
+    bool loadTransaction(const std::string& transaction_id, Transaction& transaction); // Index lookup, no scan
+    bool transactionExists(const std::string& transaction_id);
     bool updateTransaction(const Transaction& transaction);
     std::vector<Transaction> getAllTransactions();
     std::vector<Transaction> getTransactionsByAccount(const std::string& account_id);
     std::vector<Transaction> getTransactionsByDateRange(
         const std::string& start_date, const std::string& end_date);
+    ScanResult scanTransactions(const TransactionFilter& filter, const ScanOptions& options,
+                                const TransactionVisitor& visitor);
+    ScanResult scanTransactionsByAccount(const std::string& account_id, const ScanOptions& options,
+                                         const TransactionVisitor& visitor);
+
+    // Idempotency keys. The record row and the tombstones of keys that left
+    // the cache go out as one append; rows are read back with scanLiveRows.
+    // Keys of balance changes are normally stored by commitAccountTransaction
+    bool saveIdempotencyRecord(const std::string& key, const std::string& row,
+                               const std::vector<std::string>& dropped_keys);
+    bool deleteIdempotencyRecords(const std::vector<std::string>& keys);
+    
+    // Standing orders; new and changed orders go out as one append. Rows
+    // are read back with scanLiveRows
+    bool saveStandingOrders(const std::vector<StandingOrder>& orders);
+    
+    // Streams the live rows of one table shard ("users", "idempotency" and
+    // "standing_orders" have shard 0 only)
+    // from a snapshot, one row in memory at a time; header receives the
+    // CSV header line first
+    bool scanLiveRows(const std::string& table, size_t shard, std::string& header, const RowVisitor& visitor);
 
     // Utility operations
     bool backup();
     bool restore(const std::string& backup_path);
     bool validateDataIntegrity();
     void cleanup();
-    
+
+    // Compaction
+    void setCompactionPolicy(double garbage_ratio, std::uintmax_t min_garbage_bytes,
+                             std::uintmax_t io_budget_bytes_per_sec);
+    CompactionStats getCompactionStats();
+
+    // Bulk import. Validated rows are appended to the shard files as they
+    // are, without index maintenance; finishBulkImport() then indexes every
+    // shard written to in one sequential pass. Meant for offline loads:
+    // rows appended this way are not visible to lookups until finished.
+    size_t transactionShardIndex(const Transaction& transaction) const;
+    bool bulkAppendTransactions(size_t shard, const std::string& rows); // '\n'-terminated rows
+    bool finishBulkImport();
+    void setTaskPool(TaskPool* pool);
+
+    // Tiering
+    void setTieringPolicy(std::time_t hot_window_seconds, std::uintmax_t hot_max_bytes); // Before initialize()
+    TieringStats getTieringStats();
+
+    // Replication
+    void setLogShipper(LogShipper* shipper); // Call before initialize()
+    bool forEachLiveRow(const std::function<void(const std::string& table, size_t shard,
+                                                 const std::string& key, const std::string& row)>& visitor);
+    bool applyReplicatedRows(const std::string& table, size_t shard, const std::vector<ReplicatedRow>& rows);
+    // A resync from the primary is staged beside the data files and swapped
+    // in as a whole, also across a restart; until then the data stays as it was
+    bool beginReplicationSnapshot();
+    bool stageReplicatedRows(const std::string& table, size_t shard, const std::vector<ReplicatedRow>& rows);
+    bool finishReplicationSnapshot();
+    void abortReplicationSnapshot();
+
     // Statistics
     size_t getUserCount();
     size_t getAccountCount();
     size_t getTransactionCount();
+    size_t getShardCount() const;
+    std::string getShardHashScheme() const;
     double getTotalSystemBalance();
+    size_t getFileWriteCount() const;
+    uint64_t getCommitLsn() const;
 };
 
 #endif // DATABASE_H
@@ -0,0 +1,82 @@
+#ifndef FILE_HANDLE_MANAGER_H
+#define FILE_HANDLE_MANAGER_H
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+
+// When buffered appends for a file are pushed to the OS.
+// commit() always flushes immediately regardless of policy.
+struct FlushPolicy {
+    size_t max_buffered_bytes = 64 * 1024;         // Flush once this much is pending
+    std::chrono::milliseconds max_delay{1000};      // Flush data older than this
+};
+
+// Keeps one long-lived append handle per data file so writers stop paying an
+// open/close pair per record. Appends are buffered in memory and written out
+// according to the file's FlushPolicy. A write that fails is dropped and the
+// file is truncated back to the last byte written before it.
+class FileHandleManager {
+private:
+    struct Writer {
+        std::mutex mutex;
+        std::ofstream stream;
+        std::string pending;
+        FlushPolicy policy;
+        std::chrono::steady_clock::time_point oldest_pending;
+        std::uintmax_t written_bytes = 0; // Bytes this handle has put in the file
+    };
+
+    FlushPolicy default_policy;
+    std::mutex writers_mutex;
+    std::map<std::string, std::unique_ptr<Writer>> writers;
+
+    std::atomic<size_t> open_count{0};
+    std::atomic<size_t> flush_count{0};
+
+    // Background flusher for the time-based policy
+    std::thread flusher_thread;
+    std::mutex flusher_mutex;
+    std::condition_variable flusher_cv;
+    bool stopping;
+
+    Writer& getWriter(const std::string& path);
+    bool openWriter(const std::string& path, Writer& writer);
+    bool flushWriter(const std::string& path, Writer& writer);
+    void flusherLoop();
+
+public:
+    explicit FileHandleManager(const FlushPolicy& policy = FlushPolicy());
+    ~FileHandleManager();
+
+    FileHandleManager(const FileHandleManager&) = delete;
+    FileHandleManager& operator=(const FileHandleManager&) = delete;
+
+    // Per-file policy; files without one use the default
+    void setPolicy(const std::string& path, const FlushPolicy& policy);
+
+    // Buffered append; flushes if the size policy is exceeded
+    bool append(const std::string& path, const std::string& data);
+
+    // Explicit commit: push everything pending for the file to the OS
+    bool commit(const std::string& path);
+    void commitAll();
+
+    // Drop the current descriptor so the next append opens the file again.
+    // Call after the file was replaced, rotated or rewritten elsewhere.
+    void reopen(const std::string& path);
+    void closeAll();
+
+    // Statistics
+    size_t getOpenCount() const;
+    size_t getFlushCount() const;
+};
+
+#endif // FILE_HANDLE_MANAGER_H
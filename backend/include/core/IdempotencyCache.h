@@ -0,0 +1,106 @@
+#ifndef IDEMPOTENCY_CACHE_H
+#define IDEMPOTENCY_CACHE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <ctime>
+#include <cstdint>
+
+// The outcome of a request made under an Idempotency-Key, as stored in the
+// idempotency table
+struct IdempotencyRecord {
+    std::string key;
+    std::string fingerprint;      // Of the request the key was first used with
+    std::time_t created_at = 0;
+    std::string transaction_id;
+    double new_balance = 0.0;
+    uint64_t account_version = 0;
+    std::string message;
+
+    std::string toCsvRow() const;
+    bool fromCsvRow(const std::string& csv_row);
+};
+
+enum class IdempotencyClaim {
+    FIRST,        // The caller runs the request, then completes or abandons the key
+    REPEAT,       // Already done; the original outcome is returned
+    IN_PROGRESS,  // The first request with this key has not finished yet
+    MISMATCH      // The key was used for a different request
+};
+
+struct IdempotencyStats {
+    size_t keys = 0;
+    size_t capacity = 0;
+    size_t repeats = 0;   // Requests answered from a stored outcome
+    size_t evicted = 0;   // Keys dropped for age or capacity
+};
+
+// Remembers recent Idempotency-Keys so a retried request is answered with
+// the outcome of the first one instead of running again.
+//
+// Keys are claimed before the request runs, which also turns a concurrent
+// duplicate away, and completed with the outcome afterwards. Every key is
+// kept for ttl_seconds after it was claimed, and at most capacity keys are
+// kept; since all keys live equally long, the oldest is always the next to
+// go, so expiry is a queue in claim order. Lookups are one hash probe.
+// A key whose request is still running is never evicted: it is queued
+// again behind the newer keys, so while many requests run the cache can
+// hold more than capacity keys for a moment.
+//
+// The cache only holds keys; storing completed ones is up to the caller.
+// Keys of stored outcomes that leave the cache are handed back by
+// complete() so the caller can delete them from storage.
+class IdempotencyCache {
+private:
+    struct Entry {
+        uint64_t sequence = 0;   // Matches the queue slot that expires this entry
+        bool done = false;
+        IdempotencyRecord record;
+    };
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    std::deque<std::pair<uint64_t, std::string>> expiry_queue; // (sequence, key), oldest first
+    std::vector<std::string> dropped;  // Completed keys evicted since the last complete()
+    uint64_t next_sequence = 0;
+    size_t capacity;
+    std::time_t ttl_seconds;
+    size_t repeats = 0;
+    size_t evicted = 0;
+
+    void evictLocked(std::time_t now, size_t room); // Expired keys, then the oldest until room is left
+    void insertLocked(const std::string& key, Entry entry);
+
+public:
+    static const size_t DEFAULT_CAPACITY = 100000;
+    static const std::time_t DEFAULT_TTL_SECONDS = 24 * 3600;
+
+    IdempotencyCache(size_t capacity = DEFAULT_CAPACITY, std::time_t ttl_seconds = DEFAULT_TTL_SECONDS);
+
+    IdempotencyCache(const IdempotencyCache&) = delete;
+    IdempotencyCache& operator=(const IdempotencyCache&) = delete;
+
+    // original receives the stored outcome for REPEAT
+    IdempotencyClaim claim(const std::string& key, const std::string& fingerprint, std::time_t now,
+                           IdempotencyRecord& original);
+    // Fills in the fingerprint and claim time of a claimed key whose outcome
+    // is not in yet, so it can be stored with the change; false if none
+    bool claimed(IdempotencyRecord& record) const;
+    // Stores the outcome of a claimed key, filling in the fingerprint and
+    // claim time; false if the key is no longer held (see clear()).
+    // dropped_keys receives the completed keys evicted since the last call.
+    bool complete(IdempotencyRecord& record, std::vector<std::string>& dropped_keys);
+    // Releases a claimed key without an outcome, so a retry runs again
+    void abandon(const std::string& key);
+    // Adds a completed key read back from storage; expired ones are dropped
+    void restore(const IdempotencyRecord& record, std::time_t now);
+
+    void clear();
+    std::time_t getTtlSeconds() const;
+    IdempotencyStats getStats() const;
+};
+
+#endif // IDEMPOTENCY_CACHE_H
@@ -0,0 +1,79 @@
+#ifndef LEDGER_REPLAY_H
+#define LEDGER_REPLAY_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "Database.h"
+#include "TaskPool.h"
+
+// An account whose stored balance differs from what its history adds up to
+struct ReplayDivergence {
+    std::string account_number;
+    int64_t stored_cents = 0;
+    int64_t replayed_cents = 0;
+    bool missing_account = false; // Has history, but no account row
+};
+
+struct ReplayReport {
+    bool ok = true;                    // Every shard could be read
+    size_t partitions = 0;
+    size_t transactions_replayed = 0;  // COMPLETED rows applied
+    size_t transactions_skipped = 0;   // PENDING, FAILED and CANCELLED rows
+    size_t rows_unreadable = 0;
+    size_t rows_inconsistent = 0;      // balance_after - balance_before does not match the amount
+    size_t accounts_checked = 0;
+    size_t accounts_matched = 0;
+    std::vector<ReplayDivergence> divergences; // Sorted by account number
+    double seconds = 0.0;
+};
+
+// Rebuilds every account balance from the transaction history alone and
+// compares it with the stored accounts.
+//
+// Each transaction shard is read by one task in file order, which is the
+// commit order of the accounts it owns. Every completed row becomes a
+// debit of its source account and a credit of its destination; the two
+// sides are routed to the partitions owning those accounts, so a transfer
+// whose accounts live in different partitions is split there. Partitions
+// are then summed in parallel, shard by shard in order, and the account
+// shards are checked against them in parallel. Amounts are whole cents,
+// so the result does not depend on how the tasks interleave.
+//
+// Meant for a stopped server's data directory or a copy of one; rows
+// committed while it runs may or may not be counted.
+class LedgerReplay {
+private:
+    // What one shard contributes to one account
+    struct AccountDelta {
+        int64_t net_cents = 0;
+        size_t transactions = 0;
+    };
+    using Partition = std::unordered_map<std::string, AccountDelta>;
+
+    // One shard's output, split by destination partition
+    struct ShardResult {
+        std::vector<Partition> partitions;
+        bool ok = true;
+        size_t replayed = 0;
+        size_t skipped = 0;
+        size_t unreadable = 0;
+        size_t inconsistent = 0;
+    };
+
+    Database& database;
+    TaskPool& pool;
+    size_t partition_count;
+
+    size_t partitionOf(const std::string& account_number) const;
+    void replayShard(size_t shard, ShardResult& result);
+
+public:
+    // partitions = 0 uses one per pool worker
+    LedgerReplay(Database& database, TaskPool& pool, size_t partitions = 0);
+
+    ReplayReport run();
+};
+
+#endif // LEDGER_REPLAY_H
@@ -0,0 +1,18 @@
+#ifndef LOCAL_TIME_H
+#define LOCAL_TIME_H
+
+#include <ctime>
+
+// Thread-safe local time conversion. std::localtime returns a pointer into
+// shared static storage, so concurrent callers go through the platform's
+// reentrant variant instead; MSVC and MinGW spell it localtime_s with the
+// arguments swapped.
+inline void toLocalTime(std::time_t time, std::tm& out) {
+#ifdef _WIN32
+    localtime_s(&out, &time);
+#else
+    localtime_r(&time, &out);
+#endif
+}
+
+#endif // LOCAL_TIME_H
@@ -0,0 +1,114 @@
+#ifndef LOG_SHIPPER_H
+#define LOG_SHIPPER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include "Database.h"
+
+// Shipping progress towards the standby
+struct ShippingStatus {
+    std::string standby;          // host:port
+    bool connected = false;
+    bool synchronous = false;
+    uint64_t shipped_seq = 0;     // Last record written to the socket
+    uint64_t acked_seq = 0;       // Last record the standby has applied
+    uint64_t lag_records = 0;     // Committed here, not applied on the standby yet
+    long long lag_ms = 0;         // Age of the oldest unacknowledged record
+    size_t resyncs = 0;           // Full snapshots sent after (re)connecting
+    size_t sync_timeouts = 0;     // Synchronous commits not acknowledged (timeout or no standby)
+    bool degraded = false;        // Synchronous, but commits do not wait until the standby catches up
+    size_t overflows = 0;         // Resyncs forced by a full queue
+};
+
+// Streams every committed append of the primary to a warm standby over TCP.
+//
+// The wire format is line based. After "HELLO <shards> <hash scheme>
+// <secret>" the standby checks the secret it shares with the primary and
+// that it places accounts the same way, answers READY and
+// receives a snapshot of all live rows, then one record per committed
+// append:
+//   R <seq> <table> <shard> <U|D> <row>   one row of the record
+//   C <seq>                               end of record <seq>
+// and acknowledges applied records with "ACK <seq>". Records committed while
+// no standby is connected are not queued; the standby catches up with the
+// snapshot sent on the next connect instead.
+class LogShipper {
+private:
+    struct Record {
+        uint64_t seq = 0;
+        std::string table;
+        size_t shard = 0;
+        std::vector<ReplicatedRow> rows;
+    };
+
+    Database& database;
+    std::string host;
+    int port;
+    std::string secret;
+    bool synchronous;
+    std::chrono::milliseconds ack_timeout;
+
+    std::mutex mutex;
+    std::condition_variable queue_cv;  // New records or a broken connection
+    std::condition_variable ack_cv;
+    std::deque<Record> pending;        // Committed, not sent yet
+    std::map<uint64_t, int64_t> unacked; // seq -> commit time (steady ms)
+    uint64_t next_seq;
+    bool connected;
+    bool broken;
+    bool stopping;
+    bool snapshotting;
+    bool degraded;                     // A synchronous commit timed out; see waitForAck()
+    int socket_fd;
+
+    std::atomic<uint64_t> shipped_seq{0};
+    std::atomic<uint64_t> acked_seq{0};
+    std::atomic<size_t> resyncs{0};
+    std::atomic<size_t> sync_timeouts{0};
+    std::atomic<size_t> overflows{0};
+
+    std::thread sender_thread;
+    std::thread ack_thread;
+
+    bool connectToStandby();
+    bool sendSnapshot(uint64_t& snapshot_seq);
+    bool sendLine(const std::string& line);
+    void disconnect();
+    void senderLoop();
+    void ackLoop(int fd);
+
+public:
+    // Records queued for a standby that does not keep up; past this the
+    // queue is dropped and the standby gets a fresh snapshot
+    static const size_t MAX_PENDING_RECORDS = 100000;
+
+    LogShipper(Database& db, const std::string& host, int port, const std::string& secret, bool synchronous,
+               std::chrono::milliseconds ack_timeout = std::chrono::milliseconds(2000));
+    ~LogShipper();
+
+    LogShipper(const LogShipper&) = delete;
+    LogShipper& operator=(const LogShipper&) = delete;
+
+    void start();
+    void stop();
+
+    // Called by Database with the table lock held, so records are numbered
+    // in commit order per table. Returns 0 if no standby is connected.
+    uint64_t ship(const std::string& table, size_t shard, const std::vector<ReplicatedRow>& rows);
+    bool isSynchronous() const;
+    // Called without table locks. false on timeout or without a standby;
+    // after a timeout it returns at once until the standby has caught up
+    bool waitForAck(uint64_t seq);
+
+    ShippingStatus getStatus();
+};
+
+#endif // LOG_SHIPPER_H
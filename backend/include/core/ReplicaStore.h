@@ -0,0 +1,106 @@
+#ifndef REPLICA_STORE_H
+#define REPLICA_STORE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include "Database.h"
+#include "../models/User.h"
+#include "../models/Account.h"
+#include "../models/Transaction.h"
+
+// Replication progress of a read replica
+struct ReplicationStatus {
+    std::string primary_directory;
+    uint64_t applied_rows = 0;
+    std::uintmax_t lag_bytes = 0;   // Committed by the primary, not applied yet
+    long long lag_ms = 0;           // Time since the replica was last fully caught up
+    size_t reloads = 0;             // Files read again after the primary compacted them
+};
+
+// Follows a primary's data directory on the same machine. The primary only
+// ever appends to its files, so following one means reading past the last
+// applied offset; a file swapped in by compaction has a new identity and is
+// read again. Like the primary, the replica keeps only where each live row
+// is, plus indexes on the fields it is looked up by (username, customer,
+// either account of a transaction); rows are read back from the file.
+class ReplicaStore {
+private:
+    // A live row version inside the followed file
+    struct RowRef {
+        uint64_t seq = 0;              // Apply order
+        std::uintmax_t offset = 0;
+        size_t length = 0;             // Without the line terminator
+    };
+
+    struct FollowedFile {
+        std::string path;
+        int fd = -1;                   // Open on the version being followed; rows are read through it
+        std::uintmax_t position = 0;   // Bytes applied
+        uint64_t identity = 0;         // Inode of the version being followed
+        uint64_t generation = 0;       // Bumped on every reload; part of resume tokens
+        uint64_t next_seq = 0;
+        std::vector<size_t> indexed_fields;                          // CSV fields looked up by value
+        std::unordered_map<std::string, RowRef> rows;                // key -> current version
+        std::map<uint64_t, std::string> order;                       // seq -> key, file order
+        std::unordered_map<std::string, std::set<uint64_t>> index;   // field value -> seqs
+    };
+
+    std::string primary_directory;
+    std::vector<FollowedFile> users;
+    std::vector<FollowedFile> accounts;
+    std::vector<FollowedFile> transactions;
+    mutable std::shared_mutex state_mutex;
+
+    std::chrono::milliseconds poll_interval;
+    std::thread tail_thread;
+    std::mutex tail_mutex;
+    std::condition_variable tail_cv;
+    bool stopping;
+
+    std::atomic<uint64_t> applied_rows{0};
+    std::atomic<std::uintmax_t> lag_bytes{0};
+    std::atomic<size_t> reloads{0};
+    std::atomic<int64_t> last_caught_up_ms{0}; // steady_clock, milliseconds
+
+    bool follow(FollowedFile& file, std::uintmax_t& behind);
+    void applyRow(FollowedFile& file, const std::string& row, std::uintmax_t offset);
+    static bool readRow(const FollowedFile& file, const RowRef& ref, std::string& row);
+    void tailLoop();
+
+public:
+    explicit ReplicaStore(const std::string& primary_dir,
+                          std::chrono::milliseconds poll = std::chrono::milliseconds(100));
+    ~ReplicaStore();
+
+    ReplicaStore(const ReplicaStore&) = delete;
+    ReplicaStore& operator=(const ReplicaStore&) = delete;
+
+    // Initial catch-up, then keep following in the background
+    bool start();
+    void stop();
+
+    // One catch-up pass over all files
+    bool poll();
+
+    // Read operations, same semantics as the Database ones
+    bool loadUserByUsername(const std::string& username, User& user) const;
+    bool loadAccount(const std::string& account_number, Account& account) const;
+    std::vector<Account> getAccountsByCustomerId(const std::string& customer_id) const;
+    bool loadTransaction(const std::string& transaction_id, Transaction& transaction) const;
+    ScanResult scanTransactionsByAccount(const std::string& account_id, const ScanOptions& options,
+                                         const TransactionVisitor& visitor) const;
+
+    ReplicationStatus getStatus() const;
+};
+
+#endif // REPLICA_STORE_H
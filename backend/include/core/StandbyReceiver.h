@@ -0,0 +1,65 @@
+#ifndef STANDBY_RECEIVER_H
+#define STANDBY_RECEIVER_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include "Database.h"
+
+// Progress of a warm standby
+struct StandbyStatus {
+    int port = 0;
+    bool connected = false;       // A primary is shipping to us
+    uint64_t applied_seq = 0;     // Last record applied and acknowledged
+    uint64_t applied_rows = 0;
+    size_t snapshots = 0;         // Full resyncs received
+    bool snapshotting = false;    // A resync is being received; not promotable until it is in
+    long long last_apply_ms = -1; // Time since the last record was applied
+};
+
+// Standby side of log shipping (see LogShipper). Accepts one primary at a
+// time on the given port, applies its snapshot and records to the local
+// Database and acknowledges each record once it is appended. A snapshot is
+// staged and only replaces the local data once all of it has arrived.
+// Only a primary that presents the shared secret is served, and malformed
+// input ends its connection. Stopping the receiver is how a standby is
+// promoted: the primary can no longer reach it and the local data is a
+// normal, writable data directory.
+class StandbyReceiver {
+private:
+    Database& database;
+    std::string bind_address;
+    int port;
+    std::string secret; // Shared with the primary; also authorizes promotion
+    int listen_fd;
+    std::thread receive_thread;
+    std::atomic<bool> stopping;
+
+    std::atomic<bool> connected{false};
+    std::atomic<uint64_t> applied_seq{0};
+    std::atomic<uint64_t> applied_rows{0};
+    std::atomic<size_t> snapshots{0};
+    std::atomic<bool> snapshotting{false};
+    std::atomic<int64_t> last_apply_ms{0}; // steady_clock, milliseconds
+
+    void receiveLoop();
+    void serveConnection(int fd);
+    bool applyBatch(const std::string& table, size_t shard, std::vector<ReplicatedRow>& rows);
+
+public:
+    StandbyReceiver(Database& db, const std::string& bind_address, int port, const std::string& secret);
+    ~StandbyReceiver();
+
+    StandbyReceiver(const StandbyReceiver&) = delete;
+    StandbyReceiver& operator=(const StandbyReceiver&) = delete;
+
+    bool start();
+    void stop();
+
+    bool checkSecret(const std::string& presented) const;
+    StandbyStatus getStatus() const;
+};
+
+#endif // STANDBY_RECEIVER_H
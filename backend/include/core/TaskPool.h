@@ -0,0 +1,67 @@
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+struct TaskPoolStats {
+    size_t threads = 0;
+    size_t queued = 0;      // Submitted, not started yet
+    size_t max_queued = 0;  // Deepest any single worker's queue has been
+    size_t completed = 0;
+    size_t steals = 0;      // Tasks run by a worker other than the one they were queued on
+};
+
+// Fixed set of worker threads, each with its own task queue. A task
+// submitted from a worker goes on that worker's queue; other submissions
+// are spread round-robin. Workers run their own queue oldest first and,
+// when it is empty, steal from the back of another worker's queue, so one
+// busy queue does not leave the rest of the pool idle.
+//
+// Submitting never blocks and the queues are unbounded, so how many tasks
+// are outstanding is not limited by how many threads run them. A task must
+// not wait for another task of the same pool.
+class TaskPool {
+public:
+    using Task = std::function<void()>;
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        size_t max_queued = 0;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::mutex idle_mutex;
+    std::condition_variable ready;
+    bool stopping;
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> next_worker{0};
+    std::atomic<size_t> completed{0};
+    std::atomic<size_t> steals{0};
+
+    bool takeOwn(Worker& worker, Task& task);
+    bool steal(size_t thief, Task& task);
+    void run(size_t index);
+
+public:
+    explicit TaskPool(size_t thread_count = 0); // 0 = one per hardware thread
+    ~TaskPool(); // Runs every task already submitted, then joins
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    void submit(Task task);
+    size_t size() const;
+    TaskPoolStats getStats();
+};
+
+#endif // TASK_POOL_H
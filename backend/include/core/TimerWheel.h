@@ -0,0 +1,54 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <vector>
+#include <array>
+#include <ctime>
+#include <cstdint>
+
+// A timer that has come due: the id it was scheduled with and its time
+struct TimerEntry {
+    uint64_t id = 0;
+    std::time_t due = 0;
+};
+
+// Hierarchical timer wheel with one-second ticks.
+//
+// LEVELS wheels of SLOTS slots each; a slot of level k spans SLOTS^k
+// seconds, so the wheels together reach about 34 years ahead. A timer goes
+// into the coarsest level whose range its distance fits, in the slot of its
+// due time. When a level's slot comes around it is cascaded: its timers
+// move down into finer levels, and level 0 slots fire. Each timer is moved
+// at most LEVELS - 1 times on its way down, so a tick costs the timers
+// that fire plus a share of the cascades, however many timers are waiting.
+//
+// Cancelling is left to the owner: ids are not looked up, so a timer that
+// is no longer wanted is simply ignored when it fires.
+class TimerWheel {
+public:
+    static const int LEVELS = 5;
+    static const int SLOT_BITS = 6;
+    static const int SLOTS = 1 << SLOT_BITS;
+
+private:
+    std::array<std::array<std::vector<TimerEntry>, SLOTS>, LEVELS> wheels;
+    std::vector<TimerEntry> overdue; // Scheduled at or before the current time
+    std::time_t current;             // Last tick processed
+    size_t pending = 0;
+
+    void place(const TimerEntry& entry);
+    void cascade(int level);
+
+public:
+    explicit TimerWheel(std::time_t now);
+
+    void schedule(uint64_t id, std::time_t due); // A due time already past fires on the next advance()
+    // Runs the ticks up to now; due receives the timers that came due,
+    // overdue ones first, then tick by tick
+    void advance(std::time_t now, std::vector<TimerEntry>& due);
+
+    std::time_t now() const;
+    size_t size() const;
+};
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,77 @@
+#ifndef VELOCITY_COUNTERS_H
+#define VELOCITY_COUNTERS_H
+
+#include <string>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <ctime>
+#include <cstdint>
+
+struct VelocityStats {
+    size_t accounts = 0;  // With debits inside the window
+    size_t refused = 0;   // Debits turned down for going over the daily limit
+};
+
+// Rolling 24-hour debit totals per account, for enforcing daily limits.
+//
+// Each account has a ring of BUCKETS time buckets covering the last day
+// and a running total. Buckets that fall out of the window are cleared as
+// time moves past them, so checking and adding a debit costs the same no
+// matter how much history the account has. The window is a whole number
+// of buckets: a debit counts for between 23 h 45 min and 24 h.
+//
+// A debit is reserved before its balance change is committed and released
+// again if the change does not go through. Accounts are spread over
+// striped locks; the lock is held only to update the ring. The first
+// debit a stripe sees in a new bucket also drops the stripe's accounts
+// that have been idle for a whole window, so the map only holds accounts
+// with debits inside the window.
+class VelocityCounters {
+public:
+    static const int BUCKETS = 96;
+    static const std::time_t BUCKET_SECONDS = 15 * 60;
+    static const std::time_t WINDOW_SECONDS = BUCKETS * BUCKET_SECONDS;
+
+private:
+    struct Window {
+        std::array<int64_t, BUCKETS> cents{};
+        int64_t total_cents = 0;
+        int64_t newest_bucket = 0; // Absolute bucket number of the latest slot in use
+    };
+
+    struct Stripe {
+        std::mutex mutex;
+        std::unordered_map<std::string, Window> windows;
+        int64_t swept_bucket = 0; // Bucket the idle accounts were last dropped in
+    };
+
+    static const size_t STRIPES = 256;
+    std::vector<Stripe> stripes;
+    std::atomic<size_t> refused{0};
+
+    Stripe& stripeFor(const std::string& account_number);
+    static void advance(Window& window, int64_t bucket); // Drops buckets older than the window
+    static void sweep(Stripe& stripe, int64_t bucket);   // Drops accounts with nothing in the window; stripe locked
+
+public:
+    VelocityCounters();
+
+    VelocityCounters(const VelocityCounters&) = delete;
+    VelocityCounters& operator=(const VelocityCounters&) = delete;
+
+    // Adds the debit if the rolling total stays within limit_cents
+    bool reserve(const std::string& account_number, int64_t cents, int64_t limit_cents, std::time_t now);
+    // Takes back a reservation made at the same time
+    void release(const std::string& account_number, int64_t cents, std::time_t at);
+    // Adds a debit from history without checking the limit
+    void record(const std::string& account_number, int64_t cents, std::time_t at);
+    int64_t usedCents(const std::string& account_number, std::time_t now);
+
+    void clear();
+    VelocityStats getStats();
+};
+
+#endif // VELOCITY_COUNTERS_H
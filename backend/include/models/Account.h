@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <chrono>
+#include <cstdint>
 
 enum class AccountType {
     SAVINGS,
@@ -29,6 +30,7 @@ private:
     double minimum_balance;
     std::chrono::system_clock::time_point created_date;
     std::chrono::system_clock::time_point last_updated;
+    uint64_t version; // Version this copy was read at; Database bumps it on every update
 
 public:
     // Constructors
@@ -46,6 +48,7 @@ public:
     double getMinimumBalance() const;
     std::string getCreatedDate() const;
     std::string getLastUpdated() const;
+    uint64_t getVersion() const;
 
     // Setters
     void setBalance(double new_balance);
@@ -53,6 +56,7 @@ public:
     void setDailyLimit(double limit);
     void setMinimumBalance(double min_balance);
     void updateLastModified();
+    void setVersion(uint64_t new_version);
 
     // Account operations
     bool deposit(double amount);
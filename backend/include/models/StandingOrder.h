@@ -0,0 +1,91 @@
+#ifndef STANDING_ORDER_H
+#define STANDING_ORDER_H
+
+#include <string>
+#include <ctime>
+#include <cstdint>
+
+enum class StandingOrderFrequency {
+    DAILY,
+    WEEKLY,
+    MONTHLY
+};
+
+enum class StandingOrderStatus {
+    ACTIVE,
+    CANCELLED
+};
+
+// A transfer the bank makes on a schedule, e.g. monthly rent.
+//
+// Runs are numbered from 0; run n is due n periods after the first run.
+// Monthly runs keep the first run's day of the month, or the last day of
+// shorter months. next_run_index is the first run not yet made, skipped or
+// failed, so the order's state is the same however its runs were spread.
+class StandingOrder {
+private:
+    std::string order_id;
+    std::string from_account_id;
+    std::string to_account_id;
+    double amount;
+    StandingOrderFrequency frequency;
+    std::time_t first_run;
+    uint64_t next_run_index;
+    StandingOrderStatus status;
+    uint64_t failed_runs;
+    uint64_t skipped_runs; // Missed while the bank was down for longer than catch-up covers
+    std::string last_result;
+    std::string description;
+
+public:
+    // Constructors
+    StandingOrder();
+    StandingOrder(const std::string& from_account, const std::string& to_account, double amount,
+                  StandingOrderFrequency frequency, std::time_t first_run, const std::string& description = "");
+
+    // Getters
+    std::string getOrderId() const;
+    std::string getFromAccountId() const;
+    std::string getToAccountId() const;
+    double getAmount() const;
+    StandingOrderFrequency getFrequency() const;
+    std::time_t getFirstRun() const;
+    uint64_t getNextRunIndex() const;
+    StandingOrderStatus getStatus() const;
+    uint64_t getFailedRuns() const;
+    uint64_t getSkippedRuns() const;
+    std::string getLastResult() const;
+    std::string getDescription() const;
+
+    // Setters
+    void setStatus(StandingOrderStatus status);
+    void setNextRunIndex(uint64_t index);
+    void setLastResult(const std::string& result);
+    void addFailedRun();
+    void addSkippedRuns(uint64_t count);
+
+    // Schedule
+    std::time_t runTime(uint64_t index) const;
+    std::time_t getNextRun() const;
+    // Description of the transfer made for a run; it names the order and
+    // run, so a run already made can be recognised in the history
+    std::string runDescription(uint64_t index) const;
+    static bool parseRunDescription(const std::string& description, std::string& order_id, uint64_t& index);
+
+    // Validation
+    bool isValid() const;
+
+    // Serialization
+    std::string toJson() const;
+    std::string toCsvRow() const;
+    bool fromCsvRow(const std::string& csv_row);
+
+    // Utility
+    std::string frequencyToString() const;
+    std::string statusToString() const;
+    static bool stringToFrequency(const std::string& frequency_str, StandingOrderFrequency& frequency);
+    static StandingOrderStatus stringToStatus(const std::string& status_str);
+    static std::string generateOrderId();
+};
+
+#endif // STANDING_ORDER_H
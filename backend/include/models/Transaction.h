@@ -50,6 +50,7 @@ public:
     double getBalanceBefore() const;
     double getBalanceAfter() const;
     std::string getTimestamp() const;
+    std::chrono::system_clock::time_point getTimePoint() const;
     std::string getReferenceNumber() const;
 
     // Setters
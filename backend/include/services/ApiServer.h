@@ -3,9 +3,13 @@
 
 #include <string>
 #include <thread>
+#include <atomic>
 #include <memory>
 #include <map>
+#include <vector>
+#include <set>
 #include <functional>
+#include <cstdint>
 
 // Forward declaration to avoid circular includes
 class BankingService;
@@ -35,40 +39,88 @@ struct HttpResponse {
 };
 
 class ApiServer {
+public:
+    // Completes a request answered off the connection thread
+    using Responder = std::function<void(const HttpResponse& response)>;
+
 private:
     std::shared_ptr<BankingService> banking_service;
     int port;
-    bool running;
+    std::atomic<bool> running;
     std::thread server_thread;
+    // Requests are read on the server thread, which polls every open
+    // connection; a connection gets this long in total to deliver its
+    // request, and only complete requests are handed to the worker pool
+    static constexpr int CLIENT_RECEIVE_TIMEOUT_SECONDS = 10;
+    static constexpr size_t MAX_REQUEST_BYTES = 8 * 1024 * 1024;
+    static constexpr size_t MAX_OPEN_CONNECTIONS = 1024; // Still being read
     
     // Route handlers
     std::map<std::string, std::function<HttpResponse(const HttpRequest&)>> routes;
+    // Routes ending in a path parameter, e.g. /api/transactions/{id}; matched
+    // by prefix when no exact route exists
+    std::map<std::string, std::function<HttpResponse(const HttpRequest&)>> prefix_routes;
+    // Routes whose handlers hand the work to the service's async API and
+    // answer through the responder once it completes
+    std::map<std::string, std::function<void(const HttpRequest&, Responder)>> async_routes;
+    // Routes that change state; refused while the service is read-only
+    std::set<std::string> write_routes;
     
     // Helper methods
     HttpRequest parseRequest(const std::string& raw_request);
     std::string serializeResponse(const HttpResponse& response);
+    void sendResponse(int client_socket, const HttpResponse& response); // Sends, then closes the socket
     std::map<std::string, std::string> parseQuery(const std::string& query);
     std::string urlDecode(const std::string& str);
+    std::string etag(uint64_t version);                 // Account version as an ETag
+    uint64_t ifMatchVersion(const HttpRequest& request); // From If-Match; 0 when absent
+    
+    // Idempotency-Key handling for balance changes. start kicks the change
+    // off and hands its outcome to the callback it is given; answer turns
+    // an outcome into the response. With a key, a repeat of a request that
+    // succeeded gets the first outcome back and start is not called;
+    // otherwise start is given the claimed key (empty without one) to pass
+    // on to the change.
+    using ResultCallback = std::function<void(const TransactionResult& result)>;
+    void runIdempotent(const HttpRequest& request, const Responder& respond,
+                       std::function<HttpResponse(const TransactionResult& result)> answer,
+                       const std::function<void(const std::string& idempotency_key, ResultCallback)>& start);
+    static const size_t MAX_IDEMPOTENCY_KEY_LENGTH = 255;
+    // Transaction history pages: without a limit the default applies, and
+    // no page is larger than the maximum; next_cursor continues the history
+    static const size_t DEFAULT_TRANSACTION_PAGE = 100;
+    static const size_t MAX_TRANSACTION_PAGE = 1000;
     
     // JSON parsing helper - this was missing!
     std::string extractJsonField(const std::string& json, const std::string& field);
+    // The flat objects of an array field, each as field -> raw value
+    std::vector<std::map<std::string, std::string>> extractJsonObjects(const std::string& json,
+                                                                       const std::string& field);
     
     // Route handler methods
     HttpResponse handleLogin(const HttpRequest& request);
     HttpResponse handleRegister(const HttpRequest& request);
     HttpResponse handleGetAccounts(const HttpRequest& request);
     HttpResponse handleCreateAccount(const HttpRequest& request);
-    HttpResponse handleDeposit(const HttpRequest& request);
-    HttpResponse handleWithdraw(const HttpRequest& request);
-    HttpResponse handleTransfer(const HttpRequest& request);
+    void handleDeposit(const HttpRequest& request, Responder respond);
+    void handleWithdraw(const HttpRequest& request, Responder respond);
+    void handleTransfer(const HttpRequest& request, Responder respond);
+    void handleBatch(const HttpRequest& request, Responder respond);
     HttpResponse handleGetTransactions(const HttpRequest& request);
+    HttpResponse handleGetTransactionById(const HttpRequest& request);
     HttpResponse handleGetBalance(const HttpRequest& request);
+    HttpResponse handleCreateStandingOrder(const HttpRequest& request);
+    HttpResponse handleCancelStandingOrder(const HttpRequest& request);
+    HttpResponse handleGetStandingOrders(const HttpRequest& request);
     HttpResponse handleOptions(const HttpRequest& request);
+    HttpResponse handleStatus(const HttpRequest& request);
+    HttpResponse handlePromote(const HttpRequest& request);
     
     // Server management methods
     void setupRoutes();
     void serverLoop();
-    void handleClient(int client_socket);
+    static size_t completeRequestLength(const std::string& raw_request); // 0 until all of it arrived
+    void handleRequest(int client_socket, const std::string& raw_request);
 
 public:
     ApiServer(int port = 8080);
@@ -5,10 +5,25 @@
 #include <vector>
 #include <memory>
 #include <mutex>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <cstdint>
 #include "../core/Database.h"
+#include "../core/AccountLockTable.h"
+#include "../core/BalanceLedger.h"
+#include "../core/AccountExecutors.h"
+#include "../core/TaskPool.h"
+#include "../core/VelocityCounters.h"
+#include "../core/IdempotencyCache.h"
+#include "../core/ReplicaStore.h"
+#include "../core/LogShipper.h"
+#include "../core/StandbyReceiver.h"
+#include "StandingOrderScheduler.h"
 #include "../models/User.h"
 #include "../models/Transaction.h"
 #include "../models/Account.h"
+#include "../models/StandingOrder.h"
 
 struct AuthResult {
     bool success;
@@ -18,10 +33,33 @@ struct AuthResult {
 };
 
 struct TransactionResult {
-    bool success;
+    bool success = false;
     std::string transaction_id;
     std::string message;
-    double new_balance;
+    double new_balance = 0.0;
+    uint64_t account_version = 0;  // Of the (debited) account after the change
+    bool version_mismatch = false; // expected_version did not match
+};
+
+// How balance changes keep concurrent writers apart
+enum class ConcurrencyMode {
+    PESSIMISTIC, // Lock the accounts' stripes for the whole change
+    OPTIMISTIC   // No locks; retry when the commit's version check fails
+};
+
+// One item of executeBatch
+enum class BatchOperationType {
+    DEPOSIT,
+    WITHDRAWAL,
+    TRANSFER
+};
+
+struct BatchOperation {
+    BatchOperationType type = BatchOperationType::DEPOSIT;
+    std::string account_number; // The debited account for withdrawals and transfers
+    std::string to_account;     // Transfers only
+    double amount = 0.0;
+    std::string description;
 };
 
 struct AccountCreationResult {
@@ -30,10 +68,36 @@ struct AccountCreationResult {
     std::string message;
 };
 
+struct StandingOrderResult {
+    bool success = false;
+    StandingOrder order;
+    std::string message;
+};
+
 class BankingService {
 private:
     std::unique_ptr<Database> database;
-    std::mutex service_mutex;
+    std::unique_ptr<ReplicaStore> replica; // Set in read-replica mode; serves all reads
+    std::unique_ptr<LogShipper> log_shipper; // Primary shipping to a warm standby
+    std::unique_ptr<StandbyReceiver> standby; // Warm standby receiving from a primary
+    std::unique_ptr<BalanceLedger> ledger;    // Set in ledger mode; takes all balance changes
+    std::unique_ptr<AccountExecutors> executors; // Set in executor mode; owners apply balance changes
+    std::atomic<bool> read_only{false};       // Standby not promoted yet
+    AccountLockTable account_locks;           // Balance changes, per account stripe
+    VelocityCounters velocity;                // Rolling 24-hour debits against daily_limit
+    IdempotencyCache idempotency;             // Recent Idempotency-Keys and their outcomes
+    std::mutex users_mutex;                   // Read-modify-write of user records
+    std::mutex promote_mutex;
+    std::atomic<ConcurrencyMode> concurrency_mode{ConcurrencyMode::PESSIMISTIC};
+    std::atomic<size_t> optimistic_conflicts{0}; // Attempts lost to a concurrent writer
+    std::atomic<size_t> optimistic_fallbacks{0}; // Changes that gave up and took the locks
+    std::atomic<size_t> cross_executor_transfers{0}; // Debited on one owner, credited on another
+    std::atomic<size_t> stuck_transfers{0};          // Left PENDING: neither credit nor refund written
+    // Shared worker pool: the *Async operations, the API server's connections
+    // and one-off background work. Declared late so it drains early.
+    std::unique_ptr<TaskPool> task_pool;
+    // Set on a primary; its batches run on the pool, so it stops before
+    std::unique_ptr<StandingOrderScheduler> scheduler;
 
     // Helper methods
     bool validateAmount(double amount);
@@ -43,12 +107,74 @@ private:
     bool verifyPassword(const std::string& password, const std::string& hash);
     void logActivity(const std::string& user_id, const std::string& activity);
 
+    // One try at a balance change: load, validate, commit. Returns false
+    // only when the commit lost to a concurrent writer.
+    using BalanceAttempt = std::function<bool(TransactionResult& outcome)>;
+    static const int MAX_OPTIMISTIC_ATTEMPTS = 8;
+    TransactionResult runBalanceChange(const std::string& first_account, const std::string& second_account,
+                                       const BalanceAttempt& attempt);
+    // Daily limits: a debit is reserved against the account's rolling total
+    // before it is committed and released if the commit does not happen
+    bool reserveDailyLimit(const Account& account, double amount, std::time_t now);
+    void releaseDailyLimit(const std::string& account_number, double amount, std::time_t at);
+    void rebuildDailyLimits(); // From the last day of committed history
+    void rebuildIdempotencyKeys(); // From the idempotency table
+    void settlePendingTransfers(); // Cross-executor transfers a crash left debited but not credited
+    // The idempotency row for a change about to be committed under a claimed
+    // key; empty if there is no key or it is not held
+    std::string idempotencyRow(const std::string& key, const Transaction& transaction, const Account& debited,
+                               const std::string& message);
+    // Applies one batch item to the batch's working copies of the accounts;
+    // debits reserved for it are added to reserved
+    using AccountLookup = std::function<Account*(const std::string& account_number)>;
+    using DailyReservations = std::vector<std::pair<std::string, double>>;
+    bool applyBatchItem(const BatchOperation& operation, const AccountLookup& lookup, std::time_t now,
+                        TransactionResult& result, Transaction& transaction, DailyReservations& reserved);
+    void runAsync(std::function<TransactionResult()> operation,
+                  std::function<void(const TransactionResult& result)> done);
+    TransactionResult runOnOwner(const std::string& account_number, const BalanceAttempt& attempt);
+    // Account reads and commits of a balance change. On an executor the
+    // accounts it owns come from, and are kept in, its in-memory copies;
+    // elsewhere these go straight to the database.
+    bool loadForChange(const std::string& account_number, Account& account);
+    CommitResult commitChange(const std::vector<Account>& accounts, const Transaction& transaction,
+                              const std::string& idempotency_key = "", const std::string& idempotency_row = "");
+    TransactionResult transferAcrossExecutors(const std::string& from_account, const std::string& to_account,
+                                              double amount, const std::string& description,
+                                              uint64_t expected_version, const std::string& idempotency_key);
+    TransactionResult ledgerResult(LedgerResult applied, const Transaction& transaction, double new_balance,
+                                   const std::string& success_message);
+
 public:
     // Constructor
-    BankingService(const std::string& data_directory = "data");
+    // worker_threads sizes the shared task pool; 0 = one per hardware thread
+    BankingService(const std::string& data_directory = "data", size_t shard_count = 1,
+                   size_t worker_threads = 0);
     
     // Initialization
     bool initialize();
+    bool initializeReplica(const std::string& primary_directory); // Instead of initialize()
+    // Instead of initialize(); read-only until promote(). The secret is shared
+    // with the primary and also authorizes promotion
+    bool initializeStandby(const std::string& bind_address, int standby_port, const std::string& secret);
+    void configureTiering(long long hot_window_seconds, std::uintmax_t hot_max_bytes); // Before initialize()
+    bool configureLogShipping(const std::string& host, int port, const std::string& secret,
+                              bool synchronous); // After initialize()
+    bool promote(const std::string& secret, std::string& message); // Standby stops following its primary and accepts writes
+    void setConcurrencyMode(ConcurrencyMode mode);
+    // Balance changes are acknowledged from memory and written in the
+    // background; see BalanceLedger. After initialize(), on a primary.
+    bool enableLedger();
+    bool flushLedger(); // Waits until every acknowledged change is written
+    // Balance changes run on the executor thread that owns the account
+    // instead of taking locks; see AccountExecutors. After initialize(), on
+    // a primary, not together with the ledger.
+    bool enableExecutors(size_t executor_count);
+    // Standing orders are run from here; see StandingOrderScheduler. After
+    // initialize() and the ledger or executors, on a primary; a standby
+    // starts it when promoted.
+    bool enableScheduler();
+    bool isReadOnly() const;
     
     // Authentication and User Management
     AuthResult authenticateUser(const std::string& username, const std::string& password);
@@ -77,16 +203,74 @@ public:
     bool getAccountBalance(const std::string& account_number, double& balance);
     bool getAccountInfo(const std::string& account_number, Account& account);
 
-    // Transaction Operations
+    // Transaction Operations. A non-zero expected_version (an HTTP If-Match)
+    // refuses the change if the (debited) account is at another version.
+    // idempotency_key names a key claimed with claimIdempotencyKey; its
+    // outcome is stored in the same commit as the change.
     TransactionResult deposit(const std::string& account_number, double amount,
-                             const std::string& description = "Deposit");
+                             const std::string& description = "Deposit", uint64_t expected_version = 0,
+                             const std::string& idempotency_key = "");
     TransactionResult withdraw(const std::string& account_number, double amount,
-                              const std::string& description = "Withdrawal");
+                              const std::string& description = "Withdrawal", uint64_t expected_version = 0,
+                              const std::string& idempotency_key = "");
     TransactionResult transfer(const std::string& from_account, const std::string& to_account,
-                              double amount, const std::string& description = "Transfer");
+                              double amount, const std::string& description = "Transfer",
+                              uint64_t expected_version = 0, const std::string& idempotency_key = "");
+    
+    // Many balance changes in one call, one result per operation in order.
+    // Refused items fail on their own; the rest are applied in order and
+    // written with one commit, under all their accounts' locks at once.
+    static const size_t MAX_BATCH_OPERATIONS = 10000;
+    std::vector<TransactionResult> executeBatch(const std::vector<BatchOperation>& operations);
+    
+    // Asynchronous variants: they queue the operation on an internal worker
+    // pool and return at once. The outcome is passed to the callback (on a
+    // pool thread) or delivered through the future.
+    using TransactionCallback = std::function<void(const TransactionResult& result)>;
+    using BatchCallback = std::function<void(const std::vector<TransactionResult>& results)>;
+    void depositAsync(const std::string& account_number, double amount, const std::string& description,
+                      uint64_t expected_version, const std::string& idempotency_key, TransactionCallback done);
+    void withdrawAsync(const std::string& account_number, double amount, const std::string& description,
+                       uint64_t expected_version, const std::string& idempotency_key, TransactionCallback done);
+    void transferAsync(const std::string& from_account, const std::string& to_account, double amount,
+                       const std::string& description, uint64_t expected_version,
+                       const std::string& idempotency_key, TransactionCallback done);
+    void executeBatchAsync(std::vector<BatchOperation> operations, BatchCallback done);
+    std::future<TransactionResult> depositAsync(const std::string& account_number, double amount,
+                                                const std::string& description = "Deposit",
+                                                uint64_t expected_version = 0);
+    std::future<TransactionResult> withdrawAsync(const std::string& account_number, double amount,
+                                                 const std::string& description = "Withdrawal",
+                                                 uint64_t expected_version = 0);
+    std::future<TransactionResult> transferAsync(const std::string& from_account, const std::string& to_account,
+                                                 double amount, const std::string& description = "Transfer",
+                                                 uint64_t expected_version = 0);
+    std::future<std::vector<TransactionResult>> executeBatchAsync(std::vector<BatchOperation> operations);
+    TaskPool& getTaskPool(); // For other work that should share the service's workers
+    
+    // Idempotency-Key support for the balance-changing API. A request is
+    // claimed under its key before it runs and finished with its outcome;
+    // a successful outcome is stored with the key, so a retry within the
+    // key's lifetime is answered with it instead of running again. A
+    // failed one releases the key, since it moved no money. The key is
+    // passed to the balance change so both are written together.
+    IdempotencyClaim claimIdempotencyKey(const std::string& key, const std::string& fingerprint,
+                                         TransactionResult& original);
+    void finishIdempotencyKey(const std::string& key, const TransactionResult& result);
+    
+    // Standing Orders
+    // frequency is DAILY, WEEKLY or MONTHLY; first_run = 0 means now
+    StandingOrderResult createStandingOrder(const std::string& from_account, const std::string& to_account,
+                                            double amount, const std::string& frequency,
+                                            std::time_t first_run, const std::string& description = "");
+    StandingOrderResult cancelStandingOrder(const std::string& order_id);
+    std::vector<StandingOrder> getStandingOrders(const std::string& account_number);
     
     // Transaction History
+    bool getTransaction(const std::string& transaction_id, Transaction& transaction);
     std::vector<Transaction> getAccountTransactions(const std::string& account_number);
+    ScanResult scanAccountTransactions(const std::string& account_number, const ScanOptions& options,
+                                       const TransactionVisitor& visitor); // Streaming, paged
     std::vector<Transaction> getUserTransactions(const std::string& user_id);
     std::vector<Transaction> getAllTransactions(); // Admin only
     std::vector<Transaction> getTransactionsByDateRange(const std::string& start_date,
@@ -0,0 +1,99 @@
+#ifndef STANDING_ORDER_SCHEDULER_H
+#define STANDING_ORDER_SCHEDULER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <ctime>
+#include <cstdint>
+#include "../core/Database.h"
+#include "../core/TimerWheel.h"
+#include "../models/StandingOrder.h"
+
+class BankingService;
+
+struct SchedulerStats {
+    size_t orders = 0;          // Active
+    size_t timers = 0;          // Waiting in the wheel
+    size_t runs = 0;            // Transfers made
+    size_t failed_runs = 0;
+    size_t skipped_runs = 0;    // Beyond catch-up after downtime
+    size_t recovered_runs = 0;  // Found in the history at startup, already made
+    size_t ticks = 0;
+    size_t max_due = 0;         // Most runs due in one tick
+};
+
+// Makes the transfers of standing orders when they come due.
+//
+// Every active order has one timer in a TimerWheel, for its next run, so a
+// tick only costs the orders due in it. A thread ticks once a second and
+// hands the due runs to BankingService::executeBatch in chunks, which run
+// side by side on the service's task pool. Orders are then advanced and
+// written back with one append.
+//
+// The transfer of a run names the order and run (see
+// StandingOrder::runDescription). At startup, runs that are due are looked
+// up in the history since the oldest of them, so a run made just before a
+// crash is not made again. Runs missed while the bank was down are made
+// late, oldest first, one per order per tick; an order more than
+// MAX_CATCH_UP_RUNS behind skips the older ones.
+class StandingOrderScheduler {
+private:
+    struct Scheduled {
+        StandingOrder order;
+        bool running = false; // Its run is out in a batch
+    };
+
+    BankingService& service;
+    Database& database;
+
+    std::mutex mutex;
+    TimerWheel wheel;
+    std::unordered_map<uint64_t, Scheduled> orders;                   // Wheel handle -> order
+    std::unordered_map<std::string, uint64_t> handles;                 // Order id -> wheel handle
+    std::unordered_map<std::string, std::vector<uint64_t>> by_account; // Either side of the transfer
+    uint64_t next_handle = 1;
+    size_t active_orders = 0;
+
+    std::thread thread;
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    std::atomic<size_t> runs{0};
+    std::atomic<size_t> failed_runs{0};
+    std::atomic<size_t> skipped_runs{0};
+    std::atomic<size_t> recovered_runs{0};
+    std::atomic<size_t> ticks{0};
+    std::atomic<size_t> max_due{0};
+
+    void addLocked(const StandingOrder& order); // Indexes the order; schedules it if active
+    bool load();
+    void recoverMadeRuns(std::vector<StandingOrder>& loaded, std::time_t now);
+    static uint64_t firstRunAfter(const StandingOrder& order, std::time_t now);
+    void run();
+    void tick(std::time_t now);
+
+public:
+    static const uint64_t MAX_CATCH_UP_RUNS = 31;
+
+    StandingOrderScheduler(BankingService& service, Database& database);
+    ~StandingOrderScheduler();
+
+    StandingOrderScheduler(const StandingOrderScheduler&) = delete;
+    StandingOrderScheduler& operator=(const StandingOrderScheduler&) = delete;
+
+    bool start(); // Loads the stored orders and starts ticking
+    void stop();
+
+    bool add(const StandingOrder& order); // Stored before it is scheduled
+    bool cancel(const std::string& order_id, StandingOrder& cancelled);
+    std::vector<StandingOrder> getOrdersForAccount(const std::string& account_number);
+    SchedulerStats getStats();
+};
+
+#endif // STANDING_ORDER_SCHEDULER_H
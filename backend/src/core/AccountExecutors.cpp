@@ -0,0 +1,161 @@
+#include "../include/core/AccountExecutors.h"
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+
+thread_local AccountExecutors::Executor* AccountExecutors::current = nullptr;
+
+AccountExecutors::AccountExecutors(size_t executor_count) {
+    if (executor_count == 0) {
+        executor_count = 1;
+    }
+    for (size_t i = 0; i < executor_count; ++i) {
+        executors.push_back(std::make_unique<Executor>());
+        executors.back()->owner = this;
+        executors.back()->index = i;
+    }
+    for (auto& executor : executors) {
+        executor->thread = std::thread(&AccountExecutors::run, this, std::ref(*executor));
+    }
+    std::cout << "[DEBUG] Started " << executor_count << " account executors" << std::endl;
+}
+
+AccountExecutors::~AccountExecutors() {
+    stopping = true;
+    for (auto& executor : executors) {
+        std::lock_guard<std::mutex> lock(executor->mutex);
+        executor->ready.notify_all();
+    }
+    for (auto& executor : executors) {
+        if (executor->thread.joinable()) {
+            executor->thread.join();
+        }
+    }
+}
+
+size_t AccountExecutors::size() const {
+    return executors.size();
+}
+
+size_t AccountExecutors::ownerOf(const std::string& account_number) const {
+    return std::hash<std::string>{}(account_number) % executors.size();
+}
+
+void AccountExecutors::submit(size_t executor_index, Command command) {
+    Executor& executor = *executors[executor_index % executors.size()];
+    in_flight++;
+    size_t depth = ++executor.queued;
+    size_t deepest = executor.max_queued.load(std::memory_order_relaxed);
+    while (depth > deepest && !executor.max_queued.compare_exchange_weak(deepest, depth)) {
+    }
+    
+    Node* node = new Node;
+    node->command = std::move(command);
+    node->next = executor.pending.load(std::memory_order_relaxed);
+    while (!executor.pending.compare_exchange_weak(node->next, node, std::memory_order_release,
+                                                   std::memory_order_relaxed)) {
+    }
+    
+    // An executor only sleeps on an empty queue, so only the first command
+    // pushed onto one has to wake it
+    if (!node->next) {
+        std::lock_guard<std::mutex> lock(executor.mutex);
+        executor.ready.notify_one();
+    }
+}
+
+void AccountExecutors::run(Executor& executor) {
+    current = &executor;
+    std::vector<Node*> batch;
+    while (true) {
+        // Take the whole queue at once; it was pushed newest first
+        Node* drained = executor.pending.exchange(nullptr, std::memory_order_acquire);
+        if (!drained) {
+            std::unique_lock<std::mutex> lock(executor.mutex);
+            // A step still running elsewhere may submit a follow-up here,
+            // so stopping only ends the loop once nothing is in flight
+            if (stopping && in_flight == 0) {
+                return;
+            }
+            executor.ready.wait_for(lock, std::chrono::milliseconds(10), [&]() {
+                return executor.pending.load() != nullptr || (stopping && in_flight == 0);
+            });
+            continue;
+        }
+        
+        for (Node* node = drained; node; node = node->next) {
+            batch.push_back(node);
+        }
+        std::reverse(batch.begin(), batch.end());
+        for (Node* node : batch) {
+            executor.served.clear();
+            node->command();
+            delete node;
+            executor.queued--;
+            commands_run++;
+            in_flight--;
+        }
+        batch.clear();
+    }
+}
+
+AccountExecutors::Executor* AccountExecutors::ownerHere(const std::string& account_number) const {
+    if (!current || current->owner != this || current->index != ownerOf(account_number)) {
+        return nullptr;
+    }
+    return current;
+}
+
+bool AccountExecutors::cachedAccount(const std::string& account_number, Account& account) const {
+    Executor* executor = ownerHere(account_number);
+    if (!executor) {
+        return false;
+    }
+    auto it = executor->accounts.find(account_number);
+    if (it == executor->accounts.end()) {
+        return false;
+    }
+    account = it->second;
+    executor->served.push_back(account_number);
+    return true;
+}
+
+void AccountExecutors::cacheAccount(const Account& account) {
+    Executor* executor = ownerHere(account.getAccountNumber());
+    if (executor) {
+        executor->accounts[account.getAccountNumber()] = account;
+        executor->cached = executor->accounts.size();
+    }
+}
+
+void AccountExecutors::forgetAccount(const std::string& account_number) {
+    Executor* executor = ownerHere(account_number);
+    if (executor) {
+        executor->accounts.erase(account_number);
+        executor->cached = executor->accounts.size();
+    }
+}
+
+bool AccountExecutors::forgetServed() {
+    if (!current || current->owner != this || current->served.empty()) {
+        return false;
+    }
+    for (const auto& account_number : current->served) {
+        current->accounts.erase(account_number);
+    }
+    current->served.clear();
+    current->cached = current->accounts.size();
+    return true;
+}
+
+ExecutorStats AccountExecutors::getStats() {
+    ExecutorStats stats;
+    stats.executors = executors.size();
+    stats.commands = commands_run.load();
+    stats.queued = in_flight.load();
+    for (auto& executor : executors) {
+        stats.max_queued = std::max(stats.max_queued, executor->max_queued.load());
+        stats.cached_accounts += executor->cached.load();
+    }
+    return stats;
+}
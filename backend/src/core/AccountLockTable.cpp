@@ -0,0 +1,49 @@
+#include "../include/core/AccountLockTable.h"
+#include <functional>
+#include <algorithm>
+
+AccountLockTable::AccountLockTable(size_t stripe_count)
+    : stripes(stripe_count == 0 ? 1 : stripe_count) {
+}
+
+size_t AccountLockTable::stripeOf(const std::string& account_number) const {
+    return std::hash<std::string>{}(account_number) % stripes.size();
+}
+
+std::unique_lock<std::mutex> AccountLockTable::lock(const std::string& account_number) {
+    return std::unique_lock<std::mutex>(stripes[stripeOf(account_number)]);
+}
+
+std::pair<std::unique_lock<std::mutex>, std::unique_lock<std::mutex>>
+AccountLockTable::lockPair(const std::string& first, const std::string& second) {
+    size_t a = stripeOf(first);
+    size_t b = stripeOf(second);
+    if (a == b) {
+        return {std::unique_lock<std::mutex>(stripes[a]), std::unique_lock<std::mutex>()};
+    }
+
+    // Canonical order: the lower stripe first. Every pair is taken this way,
+    // so two transfers between the same accounts in opposite directions
+    // queue on the same first stripe instead of holding one each
+    std::unique_lock<std::mutex> first_lock(stripes[std::min(a, b)]);
+    std::unique_lock<std::mutex> second_lock(stripes[std::max(a, b)]);
+    return {std::move(first_lock), std::move(second_lock)};
+}
+
+std::vector<std::unique_lock<std::mutex>>
+AccountLockTable::lockAll(const std::vector<std::string>& account_numbers) {
+    std::vector<size_t> indexes;
+    indexes.reserve(account_numbers.size());
+    for (const auto& account_number : account_numbers) {
+        indexes.push_back(stripeOf(account_number));
+    }
+    std::sort(indexes.begin(), indexes.end());
+    indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+
+    std::vector<std::unique_lock<std::mutex>> locks;
+    locks.reserve(indexes.size());
+    for (size_t index : indexes) {
+        locks.emplace_back(stripes[index]);
+    }
+    return locks;
+}
@@ -0,0 +1,507 @@
+#include "../include/core/BalanceLedger.h"
+#include "../include/models/Account.h"
+#include <iostream>
+#include <map>
+#include <set>
+#include <cmath>
+#include <functional>
+#include <algorithm>
+
+namespace {
+
+// Records per database commit; a backlog is written in several commits
+const size_t MAX_BATCH = 4096;
+
+// Acknowledged changes the writer may fall behind by before clients wait
+const uint64_t MAX_PENDING = 64 * 1024;
+
+// Commits retried straight away when an account row moved underneath
+const int MAX_COMMIT_ATTEMPTS = 3;
+
+// Status and limits of a cached account are re-read at least this often
+const int64_t ROW_REFRESH_MS = 1000;
+
+int64_t toCents(double amount) {
+    return static_cast<int64_t>(std::llround(amount * 100.0));
+}
+
+double fromCents(int64_t cents) {
+    return static_cast<double>(cents) / 100.0;
+}
+
+int64_t steadyNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+size_t roundUpToPowerOfTwo(size_t value) {
+    size_t power = 1;
+    while (power < value) {
+        power <<= 1;
+    }
+    return power;
+}
+
+} // namespace
+
+BalanceLedger::BalanceLedger(Database& db, size_t capacity, std::chrono::milliseconds flush_interval)
+    : database(db), flush_interval(flush_interval), velocity(nullptr),
+      slots(roundUpToPowerOfTwo(std::max<size_t>(capacity, 16))), stopping(false) {
+    for (auto& slot : slots) {
+        slot.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+BalanceLedger::~BalanceLedger() {
+    stop();
+
+    for (Record* record : unwritten) {
+        delete record;
+    }
+    Record* record = pending.exchange(nullptr);
+    while (record) {
+        Record* next = record->next;
+        delete record;
+        record = next;
+    }
+    for (auto& slot : slots) {
+        delete slot.load();
+    }
+}
+
+void BalanceLedger::setVelocityCounters(VelocityCounters* counters) {
+    velocity = counters;
+}
+
+void BalanceLedger::start() {
+    std::cout << "[DEBUG] Balance ledger started with " << slots.size() << " slots, writing every "
+              << flush_interval.count() << " ms" << std::endl;
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex);
+        stopping = false;
+    }
+    writer_thread = std::thread(&BalanceLedger::writerLoop, this);
+}
+
+void BalanceLedger::stop() {
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex);
+        stopping = true;
+    }
+    writer_cv.notify_all();
+    if (writer_thread.joinable()) {
+        writer_thread.join();
+    }
+}
+
+BalanceLedger::Entry* BalanceLedger::find(const std::string& account_number) {
+    size_t mask = slots.size() - 1;
+    size_t home = std::hash<std::string>{}(account_number) & mask;
+    for (size_t probe = 0; probe < slots.size(); ++probe) {
+        Entry* entry = slots[(home + probe) & mask].load(std::memory_order_acquire);
+        if (!entry) {
+            return nullptr;
+        }
+        if (entry->account_number == account_number) {
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+BalanceLedger::Entry* BalanceLedger::acquire(const std::string& account_number, bool& full) {
+    full = false;
+    size_t mask = slots.size() - 1;
+    size_t home = std::hash<std::string>{}(account_number) & mask;
+    for (size_t probe = 0; probe < slots.size(); ++probe) {
+        std::atomic<Entry*>& slot = slots[(home + probe) & mask];
+        Entry* entry = slot.load(std::memory_order_acquire);
+        if (!entry) {
+            // Keep probe sequences short
+            if (entry_count.load(std::memory_order_relaxed) >= slots.size() / 4 * 3) {
+                full = true;
+                return nullptr;
+            }
+
+            // Nothing but the writer changes a cached account's balance, and
+            // this one is not cached yet, so the stored row is current
+            Account account;
+            if (!database.loadAccount(account_number, account)) {
+                return nullptr;
+            }
+            Entry* loaded = new Entry();
+            loaded->balance_cents.store(toCents(account.getBalance()), std::memory_order_relaxed);
+            refresh(loaded, account);
+            loaded->account_number = account_number;
+            loaded->persisted_cents = toCents(account.getBalance());
+
+            // Everyone probing for this account stops at the same free slot,
+            // so whoever loses the race finds the winner's entry here
+            if (slot.compare_exchange_strong(entry, loaded, std::memory_order_acq_rel,
+                                             std::memory_order_acquire)) {
+                entry_count.fetch_add(1, std::memory_order_relaxed);
+                return loaded;
+            }
+            delete loaded;
+        }
+        if (entry->account_number == account_number) {
+            revalidate(entry);
+            return entry;
+        }
+    }
+    full = true;
+    return nullptr;
+}
+
+void BalanceLedger::refresh(Entry* entry, const Account& account) {
+    entry->active.store(account.isActive(), std::memory_order_relaxed);
+    entry->minimum_cents.store(toCents(account.getMinimumBalance()), std::memory_order_relaxed);
+    entry->limit_cents.store(toCents(account.getDailyLimit()), std::memory_order_relaxed);
+    entry->checked_ms.store(steadyNowMs(), std::memory_order_relaxed);
+}
+
+// Picks up status and limit changes of accounts the writer has not
+// committed lately; one caller per interval does the read
+void BalanceLedger::revalidate(Entry* entry) {
+    int64_t now = steadyNowMs();
+    int64_t checked = entry->checked_ms.load(std::memory_order_relaxed);
+    if (now - checked < ROW_REFRESH_MS ||
+        !entry->checked_ms.compare_exchange_strong(checked, now, std::memory_order_relaxed)) {
+        return;
+    }
+    Account account;
+    if (!database.loadAccount(entry->account_number, account)) {
+        // Gone or unreadable: refuse changes until a later read finds it
+        entry->active.store(false, std::memory_order_relaxed);
+        return;
+    }
+    refresh(entry, account);
+}
+
+bool BalanceLedger::debit(Entry* entry, int64_t cents, int64_t& before) {
+    int64_t current = entry->balance_cents.load(std::memory_order_relaxed);
+    int64_t limit_cents = entry->limit_cents.load(std::memory_order_relaxed);
+    int64_t minimum_cents = entry->minimum_cents.load(std::memory_order_relaxed);
+    do {
+        if (cents > limit_cents || current - cents < minimum_cents) {
+            return false;
+        }
+    } while (!entry->balance_cents.compare_exchange_weak(current, current - cents, std::memory_order_acq_rel,
+                                                         std::memory_order_relaxed));
+    before = current;
+    return true;
+}
+
+void BalanceLedger::push(Record* record) {
+    // Counted first so persisted never runs ahead of applied
+    applied.fetch_add(1, std::memory_order_relaxed);
+    record->next = pending.load(std::memory_order_relaxed);
+    while (!pending.compare_exchange_weak(record->next, record, std::memory_order_release,
+                                          std::memory_order_relaxed)) {
+    }
+
+    // Hold clients back rather than let the log outgrow the writer
+    if (applied.load(std::memory_order_relaxed) - settled() > MAX_PENDING) {
+        std::unique_lock<std::mutex> lock(writer_mutex);
+        writer_cv.notify_all();
+        written_cv.wait_for(lock, flush_interval, [this] {
+            return stopping || applied.load() - settled() <= MAX_PENDING;
+        });
+    }
+}
+
+uint64_t BalanceLedger::settled() const {
+    return persisted.load() + failed.load();
+}
+
+// Undoes a change the writer cannot write, so the cached balances match
+// the stored ones again
+void BalanceLedger::drop(Record* record) {
+    for (int leg = 0; leg < 2; ++leg) {
+        if (record->legs[leg]) {
+            record->legs[leg]->balance_cents.fetch_sub(record->deltas[leg], std::memory_order_acq_rel);
+        }
+    }
+    if (velocity && record->reserved_at != 0) {
+        velocity->release(record->legs[0]->account_number, -record->deltas[0], record->reserved_at);
+    }
+    std::cout << "[ERROR] Balance ledger dropped transaction " << record->transaction.getTransactionId()
+              << ": an account it changes can no longer be read" << std::endl;
+    delete record;
+    failed.fetch_add(1, std::memory_order_relaxed);
+}
+
+LedgerResult BalanceLedger::deposit(const std::string& account_number, double amount,
+                                    const std::string& description, double& new_balance,
+                                    Transaction& transaction) {
+    int64_t cents = toCents(amount);
+    if (cents <= 0) {
+        return LedgerResult::INVALID_AMOUNT;
+    }
+
+    bool full = false;
+    Entry* entry = acquire(account_number, full);
+    if (!entry) {
+        return full ? LedgerResult::FULL : LedgerResult::NOT_FOUND;
+    }
+    if (!entry->active.load(std::memory_order_relaxed)) {
+        return LedgerResult::INACTIVE;
+    }
+
+    int64_t before = entry->balance_cents.fetch_add(cents, std::memory_order_acq_rel);
+
+    Record* record = new Record();
+    record->transaction = Transaction("", account_number, fromCents(cents), TransactionType::DEPOSIT, description);
+    record->transaction.setStatus(TransactionStatus::COMPLETED);
+    record->transaction.setBalanceBefore(fromCents(before));
+    record->transaction.setBalanceAfter(fromCents(before + cents));
+    record->legs[0] = entry;
+    record->deltas[0] = cents;
+    transaction = record->transaction;
+    new_balance = fromCents(before + cents);
+    push(record);
+    return LedgerResult::APPLIED;
+}
+
+LedgerResult BalanceLedger::withdraw(const std::string& account_number, double amount,
+                                     const std::string& description, double& new_balance,
+                                     Transaction& transaction) {
+    int64_t cents = toCents(amount);
+    if (cents <= 0) {
+        return LedgerResult::INVALID_AMOUNT;
+    }
+
+    bool full = false;
+    Entry* entry = acquire(account_number, full);
+    if (!entry) {
+        return full ? LedgerResult::FULL : LedgerResult::NOT_FOUND;
+    }
+    if (!entry->active.load(std::memory_order_relaxed)) {
+        return LedgerResult::INACTIVE;
+    }
+
+    std::time_t now = std::time(nullptr);
+    if (velocity && !velocity->reserve(account_number, cents, entry->limit_cents.load(), now)) {
+        return LedgerResult::OVER_DAILY_LIMIT;
+    }
+    int64_t before = 0;
+    if (!debit(entry, cents, before)) {
+        if (velocity) {
+            velocity->release(account_number, cents, now);
+        }
+        return LedgerResult::INSUFFICIENT_FUNDS;
+    }
+
+    Record* record = new Record();
+    record->transaction = Transaction(account_number, "", fromCents(cents), TransactionType::WITHDRAWAL, description);
+    record->transaction.setStatus(TransactionStatus::COMPLETED);
+    record->transaction.setBalanceBefore(fromCents(before));
+    record->transaction.setBalanceAfter(fromCents(before - cents));
+    record->legs[0] = entry;
+    record->deltas[0] = -cents;
+    record->reserved_at = velocity ? now : 0;
+    transaction = record->transaction;
+    new_balance = fromCents(before - cents);
+    push(record);
+    return LedgerResult::APPLIED;
+}
+
+LedgerResult BalanceLedger::transfer(const std::string& from_account, const std::string& to_account,
+                                     double amount, const std::string& description, double& new_balance,
+                                     Transaction& transaction) {
+    int64_t cents = toCents(amount);
+    if (cents <= 0) {
+        return LedgerResult::INVALID_AMOUNT;
+    }
+
+    bool full = false;
+    Entry* from = acquire(from_account, full);
+    if (!from) {
+        return full ? LedgerResult::FULL : LedgerResult::NOT_FOUND;
+    }
+    Entry* to = acquire(to_account, full);
+    if (!to) {
+        return full ? LedgerResult::FULL : LedgerResult::NOT_FOUND;
+    }
+    if (!from->active.load(std::memory_order_relaxed) || !to->active.load(std::memory_order_relaxed)) {
+        return LedgerResult::INACTIVE;
+    }
+
+    // The credit cannot fail, so debit-then-credit needs no rollback. A
+    // reader may briefly see the money on neither account.
+    std::time_t now = std::time(nullptr);
+    if (velocity && !velocity->reserve(from_account, cents, from->limit_cents.load(), now)) {
+        return LedgerResult::OVER_DAILY_LIMIT;
+    }
+    int64_t before = 0;
+    if (!debit(from, cents, before)) {
+        if (velocity) {
+            velocity->release(from_account, cents, now);
+        }
+        return LedgerResult::INSUFFICIENT_FUNDS;
+    }
+    to->balance_cents.fetch_add(cents, std::memory_order_acq_rel);
+
+    Record* record = new Record();
+    record->transaction = Transaction(from_account, to_account, fromCents(cents), TransactionType::TRANSFER,
+                                      description);
+    record->transaction.setStatus(TransactionStatus::COMPLETED);
+    record->transaction.setBalanceBefore(fromCents(before));
+    record->transaction.setBalanceAfter(fromCents(before - cents));
+    record->legs[0] = from;
+    record->deltas[0] = -cents;
+    record->legs[1] = to;
+    record->deltas[1] = cents;
+    record->reserved_at = velocity ? now : 0;
+    transaction = record->transaction;
+    new_balance = fromCents(before - cents);
+    push(record);
+    return LedgerResult::APPLIED;
+}
+
+bool BalanceLedger::getBalance(const std::string& account_number, double& balance) {
+    Entry* entry = find(account_number);
+    if (!entry) {
+        return false;
+    }
+    balance = fromCents(entry->balance_cents.load(std::memory_order_acquire));
+    return true;
+}
+
+bool BalanceLedger::flush(std::chrono::milliseconds timeout) {
+    uint64_t target = applied.load();
+    writer_cv.notify_all();
+
+    std::unique_lock<std::mutex> lock(writer_mutex);
+    return written_cv.wait_for(lock, timeout, [&] { return settled() >= target; });
+}
+
+void BalanceLedger::writerLoop() {
+    std::unique_lock<std::mutex> lock(writer_mutex);
+    while (!stopping) {
+        writer_cv.wait_for(lock, flush_interval);
+        lock.unlock();
+        writeBatch();
+        lock.lock();
+        written_cv.notify_all();
+    }
+    lock.unlock();
+
+    // Clients may still be finishing changes while the service shuts down
+    bool written = false;
+    for (int attempt = 0; attempt < MAX_COMMIT_ATTEMPTS && !written; ++attempt) {
+        written = writeBatch();
+    }
+    if (!written) {
+        std::cerr << "Balance ledger stopped with " << (applied.load() - settled())
+                  << " changes not written" << std::endl;
+    }
+    written_cv.notify_all();
+}
+
+bool BalanceLedger::writeBatch() {
+    // Take the whole log at once; it was pushed newest first
+    Record* drained = pending.exchange(nullptr, std::memory_order_acquire);
+    size_t first_new = unwritten.size();
+    for (Record* record = drained; record; record = record->next) {
+        unwritten.push_back(record);
+    }
+    std::reverse(unwritten.begin() + static_cast<std::ptrdiff_t>(first_new), unwritten.end());
+
+    size_t done = 0;
+    while (done < unwritten.size()) {
+        size_t count = std::min(MAX_BATCH, unwritten.size() - done);
+
+        // Deltas add up the same in any order, so a batch needs one row per account
+        std::map<Entry*, int64_t> deltas;
+        std::vector<Transaction> transactions;
+        transactions.reserve(count);
+        for (size_t i = done; i < done + count; ++i) {
+            Record* record = unwritten[i];
+            transactions.push_back(record->transaction);
+            for (int leg = 0; leg < 2; ++leg) {
+                if (record->legs[leg]) {
+                    deltas[record->legs[leg]] += record->deltas[leg];
+                }
+            }
+        }
+
+        CommitResult committed = CommitResult::FAILED;
+        std::set<Entry*> unreadable;
+        for (int attempt = 0; attempt < MAX_COMMIT_ATTEMPTS; ++attempt) {
+            std::vector<Account> accounts;
+            for (const auto& entry : deltas) {
+                Account account;
+                if (!database.loadAccount(entry.first->account_number, account)) {
+                    unreadable.insert(entry.first);
+                    continue;
+                }
+                refresh(entry.first, account);
+                account.setBalance(fromCents(entry.first->persisted_cents + entry.second));
+                accounts.push_back(account);
+            }
+            if (!unreadable.empty()) {
+                break;
+            }
+
+            // A conflict means some other field of the row changed; reload it
+            committed = database.commitAccountTransactions(accounts, transactions);
+            if (committed != CommitResult::CONFLICT) {
+                break;
+            }
+        }
+
+        if (!unreadable.empty()) {
+            // Such a record would fail every batch it is in; drop it and
+            // write the rest of the batch without it
+            std::vector<Record*> kept;
+            for (size_t i = done; i < done + count; ++i) {
+                Record* record = unwritten[i];
+                if (unreadable.count(record->legs[0]) > 0 ||
+                    (record->legs[1] && unreadable.count(record->legs[1]) > 0)) {
+                    drop(record);
+                } else {
+                    kept.push_back(record);
+                }
+            }
+            for (Entry* entry : unreadable) {
+                entry->active.store(false, std::memory_order_relaxed);
+            }
+            unwritten.erase(unwritten.begin() + static_cast<std::ptrdiff_t>(done),
+                            unwritten.begin() + static_cast<std::ptrdiff_t>(done + count));
+            unwritten.insert(unwritten.begin() + static_cast<std::ptrdiff_t>(done), kept.begin(), kept.end());
+            continue;
+        }
+
+        if (committed != CommitResult::COMMITTED) {
+            write_failures.fetch_add(1, std::memory_order_relaxed);
+            std::cerr << "Balance ledger could not write " << count << " changes; retrying" << std::endl;
+            break;
+        }
+
+        for (const auto& entry : deltas) {
+            entry.first->persisted_cents += entry.second;
+        }
+        for (size_t i = done; i < done + count; ++i) {
+            delete unwritten[i];
+        }
+        done += count;
+        persisted.fetch_add(count, std::memory_order_relaxed);
+        batches.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    unwritten.erase(unwritten.begin(), unwritten.begin() + static_cast<std::ptrdiff_t>(done));
+    return unwritten.empty();
+}
+
+LedgerStats BalanceLedger::getStats() {
+    LedgerStats stats;
+    stats.accounts = entry_count.load();
+    stats.capacity = slots.size();
+    stats.applied = applied.load();
+    stats.persisted = persisted.load();
+    stats.failed = failed.load();
+    stats.batches = batches.load();
+    stats.write_failures = write_failures.load();
+    return stats;
+}
@@ -1,6 +1,9 @@
 #include "../include/core/Database.h"
 #include "../include/models/Account.h"
 #include "../include/models/User.h"
+#include "../include/core/LogShipper.h"
+#include "../include/core/LocalTime.h"
+#include "../include/core/TaskPool.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -8,25 +11,134 @@
 #include <iomanip>
 #include <random>
 #include <functional>
+#include <map>
+#include <algorithm>
+#include <limits>
+#include <ctime>
+#include <future>
 
-Database::Database(const std::string& data_dir) 
-    : data_directory(data_dir) {
+namespace {
+
+// Records this thread shipped in synchronous mode, waited for by the
+// outermost StandbyAckWait on the way out of a write
+struct AwaitedAck {
+    int depth = 0;
+    bool pending = false;
+    uint64_t seq = 0;
+};
+thread_local AwaitedAck awaited_ack;
+
+const std::string TOMBSTONE_MARKER = Database::TOMBSTONE_MARKER;
+
+std::string rowKey(const std::string& line) {
+    return line.substr(0, line.find(','));
+}
+
+bool isTombstone(const std::string& line) {
+    return line == rowKey(line) + "," + TOMBSTONE_MARKER;
+}
+
+// Tenth column of a transactions row
+std::string timestampField(const std::string& line) {
+    size_t start = 0;
+    for (int field = 0; field < 9; ++field) {
+        start = line.find(',', start);
+        if (start == std::string::npos) {
+            return "";
+        }
+        start++;
+    }
+    return line.substr(start, line.find(',', start) - start);
+}
+
+// Windows cannot replace a file while anyone has it open, so a compaction
+// swap first waits for snapshot readers to close the old file
+#ifdef _WIN32
+const bool SWAP_NEEDS_CLOSED_FILE = false;
+#else
+const bool SWAP_NEEDS_CLOSED_FILE = false;
+#endif
+const int MAX_SWAP_WAITS = 50;
+const std::chrono::milliseconds SWAP_WAIT(100);
+
+// Clock-derived so a file rewritten in an earlier run never reuses a value
+uint64_t newGeneration() {
+    static std::atomic<uint64_t> last{0};
+    uint64_t now = static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+    uint64_t previous = last.load();
+    uint64_t next;
+    do {
+        next = std::max(now, previous + 1);
+    } while (!last.compare_exchange_weak(previous, next));
+    return next;
+}
+
+std::string makeResumeToken(size_t shard, uint64_t generation, std::uintmax_t offset) {
+    return std::to_string(shard) + "." + std::to_string(generation) + "." + std::to_string(offset);
+}
+
+bool parseResumeToken(const std::string& token, size_t& shard, uint64_t& generation, std::uintmax_t& offset) {
+    char dot1 = 0, dot2 = 0;
+    std::istringstream in(token);
+    if (!(in >> shard >> dot1 >> generation >> dot2 >> offset) || dot1 != '.' || dot2 != '.') {
+        return false;
+    }
+    return in.peek() == std::char_traits<char>::eof();
+}
+
+} // namespace
+
+Database::Database(const std::string& data_dir, size_t shards) 
+    : data_directory(data_dir),
+      read_only(false),
+      shard_count(std::max<size_t>(shards, 1)),
+      shard_hash_scheme(SHARD_HASH_FNV1A),
+      log_shipper(nullptr),
+      task_pool(nullptr),
+      hot_window_seconds(30 * 24 * 3600),
+      hot_max_bytes(256ull * 1024 * 1024),
+      compaction_garbage_ratio(0.3),
+      compaction_min_garbage_bytes(4 * 1024),
+      compaction_io_budget(8 * 1024 * 1024),
+      compaction_stopping(false) {
     std::cout << "Creating Database with data directory: " << data_dir << std::endl;
     
-    users_file = data_dir + "/users/users.csv";
-    accounts_file = data_dir + "/accounts/accounts.csv";
-    transactions_file = data_dir + "/transactions/transactions.csv";
+    users_table.name = "users";
+    users_table.file = data_dir + "/users/users.csv";
+    idempotency_table.name = "idempotency";
+    idempotency_table.file = data_dir + "/idempotency/idempotency.csv";
+    standing_orders_table.name = "standing_orders";
+    standing_orders_table.file = data_dir + "/standing_orders/standing_orders.csv";
     logs_file = data_dir + "/logs/system.log";
+    createShards();
     
     // ADD THIS DEBUG OUTPUT
     std::cout << "[DEBUG] Current working directory: " << std::filesystem::current_path() << std::endl;
-    std::cout << "[DEBUG] Users file path: " << users_file << std::endl;
-    std::cout << "[DEBUG] Accounts file path: " << accounts_file << std::endl;
-    std::cout << "[DEBUG] Transactions file path: " << transactions_file << std::endl;
+    std::cout << "[DEBUG] Users file path: " << users_table.file << std::endl;
+    std::cout << "[DEBUG] Account shards: " << shard_count << std::endl;
+    
+    // Data files are committed explicitly after every operation; the log
+    // is allowed to batch up to a second of entries
+    FlushPolicy log_policy;
+    log_policy.max_buffered_bytes = 64 * 1024;
+    log_policy.max_delay = std::chrono::milliseconds(1000);
+    files.setPolicy(logs_file, log_policy);
     
     std::cout << "Database constructor completed." << std::endl;
 }
 
+Database::~Database() {
+    stopCompaction();
+    if (read_only) {
+        return;
+    }
+    
+    // Persist the indexes so the next start only scans new appends
+    for (Table* table : allTables()) {
+        checkpointTableIndex(*table);
+    }
+}
+
 
 // bool Database::initialize() {
 //     // Create directory structure
@@ -85,6 +197,8 @@ bool Database::initialize() {
         data_directory + "/users",
         data_directory + "/accounts", 
         data_directory + "/transactions",
+        data_directory + "/idempotency",
+        data_directory + "/standing_orders",
         data_directory + "/logs"
     };
     
@@ -94,9 +208,14 @@ bool Database::initialize() {
         }
     }
     
+    // Before anything looks at the files: a data file may still be moved aside
+    if (!recoverSnapshotSwitch()) {
+        return false;
+    }
+    
     // Check if users file exists
     bool users_file_exists = false;
-    std::ifstream users_check(users_file);
+    std::ifstream users_check(users_table.file);
     if (users_check.good()) {
         users_file_exists = true;
         std::cout << "[DEBUG] Users file already exists" << std::endl;
@@ -108,7 +227,7 @@ bool Database::initialize() {
     // Create CSV headers if files don't exist
     if (!users_file_exists) {
         std::cout << "[DEBUG] Creating users file with headers..." << std::endl;
-        std::ofstream users_out(users_file);
+        std::ofstream users_out(users_table.file);
         if (users_out.is_open()) {
             users_out << "user_id,username,password_hash,email,full_name,phone_number,role,is_active,failed_login_attempts,last_login,created_date\n";
             users_out.close();
@@ -119,25 +238,68 @@ bool Database::initialize() {
         }
     }
     
-    std::ifstream accounts_check(accounts_file);
-    if (!accounts_check.good()) {
-        std::ofstream accounts_out(accounts_file);
-        if (accounts_out.is_open()) {
-            accounts_out << "account_number,customer_id,account_type,balance,status,daily_limit,minimum_balance,created_date,last_updated\n";
-            accounts_out.close();
+    std::ifstream idempotency_check(idempotency_table.file);
+    if (!idempotency_check.good()) {
+        std::ofstream idempotency_out(idempotency_table.file);
+        if (idempotency_out.is_open()) {
+            idempotency_out << "idempotency_key,fingerprint,created_at,transaction_id,new_balance,account_version,message\n";
+            idempotency_out.close();
+        }
+    }
+    idempotency_check.close();
+    
+    std::ifstream standing_orders_check(standing_orders_table.file);
+    if (!standing_orders_check.good()) {
+        std::ofstream standing_orders_out(standing_orders_table.file);
+        if (standing_orders_out.is_open()) {
+            standing_orders_out << "order_id,from_account_id,to_account_id,amount,frequency,first_run,next_run_index,status,failed_runs,skipped_runs,last_result,description\n";
+            standing_orders_out.close();
+        }
+    }
+    standing_orders_check.close();
+    
+    // An existing data directory keeps the shard layout it was created with
+    if (!loadShardManifest()) {
+        return false;
+    }
+    
+    for (size_t shard = 0; shard < shard_count; ++shard) {
+        std::ifstream accounts_check(account_shards[shard]->file);
+        if (!accounts_check.good()) {
+            std::ofstream accounts_out(account_shards[shard]->file);
+            if (accounts_out.is_open()) {
+                accounts_out << "account_number,customer_id,account_type,balance,status,daily_limit,minimum_balance,created_date,last_updated,version\n";
+                accounts_out.close();
+            }
         }
+        accounts_check.close();
+        
+        std::ifstream transactions_check(transaction_shards[shard]->file);
+        if (!transactions_check.good()) {
+            std::ofstream transactions_out(transaction_shards[shard]->file);
+            if (transactions_out.is_open()) {
+                transactions_out << "transaction_id,from_account_id,to_account_id,amount,type,status,description,balance_before,balance_after,timestamp,reference_number\n";
+                transactions_out.close();
+            }
+        }
+        transactions_check.close();
     }
-    accounts_check.close();
     
-    std::ifstream transactions_check(transactions_file);
-    if (!transactions_check.good()) {
-        std::ofstream transactions_out(transactions_file);
-        if (transactions_out.is_open()) {
-            transactions_out << "transaction_id,from_account_id,to_account_id,amount,type,status,description,balance_before,balance_after,timestamp,reference_number\n";
-            transactions_out.close();
+    // Index the append-only files: live row versions and garbage
+    for (Table* table : allTables()) {
+        std::unique_lock<std::shared_mutex> lock(table->mutex);
+        if (!loadTableState(*table)) {
+            std::cout << "[ERROR] Failed to load " << table->file << std::endl;
+            return false;
+        }
+        std::cout << "[DEBUG] " << table->file << ": " << table->live_rows.size() << " live rows, "
+                  << table->garbage_bytes << " garbage bytes" << std::endl;
+        
+        if (table->tiered && !loadHotTier(*table)) {
+            std::cout << "[ERROR] Failed to load recent rows of " << table->file << std::endl;
+            return false;
         }
     }
-    transactions_check.close();
     
     // ALWAYS CREATE SAMPLE DATA IF NO USERS EXIST
     if (!users_file_exists) {
@@ -150,7 +312,7 @@ bool Database::initialize() {
         }
     } else {
         // Check if users file is empty (only has header)
-        std::ifstream check_empty(users_file);
+        std::ifstream check_empty(users_table.file);
         std::string line1, line2;
         std::getline(check_empty, line1); // header
         if (!std::getline(check_empty, line2)) {
@@ -163,10 +325,52 @@ bool Database::initialize() {
         check_empty.close();
     }
     
+    startCompaction();
+    
     logOperation("SYSTEM", "Database initialized successfully");
     return true;
 }
 
+bool Database::initializeReadOnly() {
+    read_only = true;
+    
+    if (!std::filesystem::exists(users_table.file)) {
+        std::cout << "[ERROR] No data directory at " << data_directory << std::endl;
+        return false;
+    }
+    // Finishing or undoing it writes, so that is left to a read-write open
+    if (std::filesystem::exists(snapshotSwitchMarker())) {
+        std::cout << "[ERROR] " << data_directory << " is in the middle of a snapshot switch; "
+                  << "open it read-write once first" << std::endl;
+        return false;
+    }
+    if (!loadShardManifest()) {
+        return false;
+    }
+    
+    // Tables the directory does not have yet are simply empty
+    for (Table* table : allTables()) {
+        std::unique_lock<std::shared_mutex> lock(table->mutex);
+        if (!std::filesystem::exists(table->file)) {
+            table->generation = newGeneration();
+            continue;
+        }
+        if (!loadTableState(*table)) {
+            std::cout << "[ERROR] Failed to load " << table->file << std::endl;
+            return false;
+        }
+        if (table->tiered && !loadHotTier(*table)) {
+            std::cout << "[ERROR] Failed to load recent rows of " << table->file << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Database::isReadOnly() const {
+    return read_only;
+}
+
 
 bool Database::ensureDirectoryExists(const std::string& path) {
     try {
@@ -182,941 +386,2326 @@ std::string Database::getCurrentTimestamp() {
     auto now = std::chrono::system_clock::now();
     auto time_t = std::chrono::system_clock::to_time_t(now);
     std::stringstream ss;
-    ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
+    std::tm local_tm = {};
+    toLocalTime(time_t, local_tm);
+    ss << std::put_time(&local_tm, "%Y-%m-%d %H:%M:%S");
     return ss.str();
 }
 
 void Database::logOperation(const std::string& operation, const std::string& details) {
-    // Use a separate mutex for logging to avoid deadlocks
-    static std::mutex log_mutex;
-    std::lock_guard<std::mutex> lock(log_mutex);
-    std::ofstream log_file(logs_file, std::ios::app);
-    if (log_file.is_open()) {
-        log_file << getCurrentTimestamp() << " - " << operation << " - " << details << std::endl;
-        log_file.close();
+    if (read_only) {
+        return;
     }
+    // Buffered; the file handle manager flushes by size or age
+    files.append(logs_file, getCurrentTimestamp() + " - " + operation + " - " + details + "\n");
 }
 
-// Add the hashPassword function to Database class
-std::string Database::hashPassword(const std::string& password) {
-    // Same implementation as in BankingService for consistency
-    std::hash<std::string> hasher;
-    std::string salted = password + "banking_salt_2024";
-    
-    // Apply multiple rounds of hashing for better security
-    size_t hash1 = hasher(salted);
-    size_t hash2 = hasher(std::to_string(hash1) + "extra_salt");
-    size_t hash3 = hasher(std::to_string(hash2) + salted);
-    
-    // Combine hashes and convert to hex string
-    std::ostringstream oss;
-    oss << std::hex << hash1 << hash2 << hash3;
-    return oss.str();
+bool Database::openSnapshot(Table& table, ReadSnapshot& snapshot) {
+    // Only the open and the state copy happen under the lock; writers
+    // commit before releasing it, so the file is consistent at this point
+    std::shared_lock<std::shared_mutex> lock(table.mutex);
+    return openSnapshotLocked(table, snapshot);
 }
 
-// User operations
-bool Database::saveUser(const User& user) {
-    std::cout << "saveUser called for user: " << user.getUserId() << std::endl;
-    std::lock_guard<std::mutex> lock(users_mutex);
-    std::cout << "Mutex acquired" << std::endl;
-    
-    // Check if user already exists
-    User existing_user;
-    std::cout << "Checking if user exists..." << std::endl;
-    if (loadUserInternal(user.getUserId(), existing_user)) {
-        std::cout << "User exists, updating..." << std::endl;
-        return updateUser(user);
-    }
-    std::cout << "User doesn't exist, creating new..." << std::endl;
-    
-    std::cout << "Opening file: " << users_file << std::endl;
-    std::ofstream file(users_file, std::ios::app);
-    if (!file.is_open()) {
-        std::cout << "Failed to open file!" << std::endl;
+bool Database::openSnapshotLocked(Table& table, ReadSnapshot& snapshot) {
+    snapshot.stream.open(table.file, std::ios::binary);
+    if (!snapshot.stream.is_open()) {
         return false;
     }
-    std::cout << "File opened successfully" << std::endl;
-    
-    std::cout << "Converting user to CSV..." << std::endl;
-    std::string csv_row = user.toCsvRow();
-    std::cout << "CSV row: " << csv_row << std::endl;
-    
-    file << csv_row << std::endl;
-    file.close();
-    std::cout << "File written and closed" << std::endl;
+    if (!snapshot.table) {
+        snapshot.table = &table;
+        table.open_snapshots++;
+    }
     
-    logOperation("USER_SAVE", "User " + user.getUserId() + " saved");
-    std::cout << "Operation logged" << std::endl;
+    snapshot.end_offset = table.end_offset;
+    snapshot.position = 0;
+    snapshot.line_offset = 0;
+    snapshot.dead_offsets.clear();
+    snapshot.dead_offsets.reserve(table.dead_rows.size());
+    for (const auto& dead : table.dead_rows) {
+        snapshot.dead_offsets.insert(dead.first);
+    }
+    snapshot.lsn = commit_lsn.load();
+    snapshot.generation = table.generation;
     return true;
 }
 
-bool Database::loadUser(const std::string& user_id, User& user) {
-    std::cout << "loadUser called for: " << user_id << std::endl;
-    std::lock_guard<std::mutex> lock(users_mutex);
-    std::cout << "loadUser mutex acquired" << std::endl;
+bool Database::nextSnapshotLine(ReadSnapshot& snapshot, std::string& line) {
+    while (snapshot.position < snapshot.end_offset && std::getline(snapshot.stream, line)) {
+        snapshot.line_offset = snapshot.position;
+        snapshot.position += line.size() + 1;
+        
+        // Superseded versions and tombstones are invisible to readers
+        if (snapshot.dead_offsets.count(snapshot.line_offset) > 0) {
+            continue;
+        }
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        return true;
+    }
+    return false;
+}
+
+bool Database::loadTableState(Table& table) {
+    // Start from the persisted index when it matches the file, so only the
+    // rows appended after it was written have to be scanned
+    if (!loadTableIndex(table)) {
+        table.live_rows.clear();
+        table.dead_rows.clear();
+        table.end_offset = 0;
+        table.garbage_bytes = 0;
+        table.generation = newGeneration();
+    }
     
-    std::cout << "Opening users file: " << users_file << std::endl;
-    std::ifstream file(users_file);
+    std::ifstream file(table.file, std::ios::binary);
     if (!file.is_open()) {
-        std::cout << "Users file doesn't exist or can't be opened" << std::endl;
         return false;
     }
-    std::cout << "Users file opened successfully" << std::endl;
+    file.seekg(static_cast<std::streamoff>(table.end_offset));
     
     std::string line;
-    std::cout << "Reading header line..." << std::endl;
-    std::getline(file, line); // Skip header
-    std::cout << "Header: " << line << std::endl;
+    std::uintmax_t offset = table.end_offset;
+    bool header = offset == 0;
+    bool torn = false;
     
-    std::cout << "Searching for user..." << std::endl;
     while (std::getline(file, line)) {
-        if (line.empty()) continue;
-        std::cout << "Checking line: " << line << std::endl;
+        RowLocation location{offset, line.size() + 1};
+        offset += location.length;
         
-        std::istringstream ss(line);
-        std::string item;
-        std::vector<std::string> tokens;
+        // A last line without terminator is a write cut short by a crash
+        torn = file.eof();
         
-        while (std::getline(ss, item, ',')) {
-            tokens.push_back(item);
+        if (header) {
+            header = false;
+            continue;
         }
         
-        if (tokens.size() >= 11 && tokens[0] == user_id) {
-            std::cout << "User found! Loading from CSV..." << std::endl;
-            // Create user from CSV data
-            user = User();
-            user.fromCsvRow(line);
-            file.close();
-            std::cout << "User loaded successfully" << std::endl;
-            return true;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
         }
-    }
-    
-    file.close();
-    std::cout << "User not found in file" << std::endl;
-    return false;
-}
-
-// bool Database::loadUserByUsername(const std::string& username, User& user) {
-//     std::lock_guard<std::mutex> lock(users_mutex);
-    
-//     std::ifstream file(users_file);
-//     if (!file.is_open()) {
-//         return false;
-//     }
-    
-//     std::string line;
-//     std::getline(file, line); // Skip header
-    
-//     while (std::getline(file, line)) {
-//         if (line.empty()) continue;
         
-//         std::istringstream ss(line);
-//         std::string item;
-//         std::vector<std::string> tokens;
+        if (line.empty() || torn) {
+            table.dead_rows[location.offset] = location.length;
+            table.garbage_bytes += location.length;
+            continue;
+        }
         
-//         while (std::getline(ss, item, ',')) {
-//             tokens.push_back(item);
-//         }
+        std::string key = rowKey(line);
+        auto it = table.live_rows.find(key);
+        if (it != table.live_rows.end()) {
+            table.dead_rows[it->second.offset] = it->second.length;
+            table.garbage_bytes += it->second.length;
+        }
         
-//         if (tokens.size() >= 11 && tokens[1] == username) {
-//             user.fromCsvRow(line);
-//             file.close();
-//             return true;
-//         }
-//     }
-    
-//     file.close();
-//     return false;
-// }
-bool Database::loadUserByUsername(const std::string& username, User& user) {
-    std::lock_guard<std::mutex> lock(users_mutex);
+        if (isTombstone(line)) {
+            if (it != table.live_rows.end()) {
+                table.live_rows.erase(it);
+            }
+            table.dead_rows[location.offset] = location.length;
+            table.garbage_bytes += location.length;
+        } else {
+            table.live_rows[key] = location;
+        }
+    }
+    file.close();
     
-    std::cout << "[DEBUG] loadUserByUsername called for: " << username << std::endl;
+    if (torn && !read_only) {
+        // Terminate the torn row so the next append starts on a fresh line
+        offset -= 1;
+        if (!files.append(table.file, "\n") || !files.commit(table.file)) {
+            return false;
+        }
+        offset += 1;
+    }
     
-    std::ifstream file(users_file);
-    if (!file.is_open()) {
-        std::cout << "[DEBUG] Cannot open users file: " << users_file << std::endl;
+    table.end_offset = offset;
+    return true;
+}
+
+// Index file layout: a "<end_offset> <garbage_bytes> <generation>" line, then one
+// "L <offset> <length> <key>" line per live row and "D <offset> <length>"
+// per dead row. It describes the file up to end_offset only.
+bool Database::saveTableIndex(Table& table) {
+    std::string index_path = table.file + ".idx";
+    std::string temp_path = index_path + ".tmp";
+    
+    IndexImage image;
+    captureIndexLocked(table, image);
+    if (!writeIndexImage(temp_path, image)) {
         return false;
     }
     
-    std::string line;
-    std::getline(file, line); // Skip header
-    
-    while (std::getline(file, line)) {
-        if (line.empty()) continue;
-        
-        std::istringstream ss(line);
-        std::string item;
-        std::vector<std::string> tokens;
-        
-        while (std::getline(ss, item, ',')) {
-            tokens.push_back(item);
-        }
-        
-        if (tokens.size() >= 11 && tokens[1] == username) {
-            std::cout << "[DEBUG] User found by username: " << username << std::endl;
-            user.fromCsvRow(line);
-            file.close();
+    std::error_code ec;
+    std::filesystem::rename(temp_path, index_path, ec);
+    if (ec) {
+        return false;
+    }
+    table.indexed_offset = table.end_offset;
+    return true;
+}
+
+bool Database::checkpointTableIndex(Table& table) {
+    IndexImage image;
+    {
+        std::shared_lock<std::shared_mutex> lock(table.mutex);
+        if (table.bulk_loading || table.end_offset == table.indexed_offset) {
             return true;
         }
+        captureIndexLocked(table, image);
     }
     
-    file.close();
-    std::cout << "[DEBUG] User not found by username: " << username << std::endl;
-    return false;
+    // Its own temporary file, so saveTableIndex under the lock never
+    // writes over it
+    std::string index_path = table.file + ".idx";
+    std::string temp_path = index_path + ".checkpoint";
+    bool written = writeIndexImage(temp_path, image);
+    
+    // Only the rename is done under the lock, and only if the file was not
+    // rewritten and no newer index was saved meanwhile
+    std::unique_lock<std::shared_mutex> lock(table.mutex);
+    std::error_code ec;
+    if (!written || table.bulk_loading || table.generation != image.generation ||
+        table.indexed_offset >= image.end_offset) {
+        std::filesystem::remove(temp_path, ec);
+        return false;
+    }
+    std::filesystem::rename(temp_path, index_path, ec);
+    if (ec) {
+        return false;
+    }
+    table.indexed_offset = image.end_offset;
+    return true;
 }
 
-
-bool Database::userExists(const std::string& username) {
-    User user;
-    return loadUserByUsername(username, user);
+void Database::captureIndexLocked(const Table& table, IndexImage& image) {
+    image.end_offset = table.end_offset;
+    image.garbage_bytes = table.garbage_bytes;
+    image.generation = table.generation;
+    image.live_rows.assign(table.live_rows.begin(), table.live_rows.end());
+    image.dead_rows.assign(table.dead_rows.begin(), table.dead_rows.end());
 }
 
-std::string Database::generateAccountNumber() {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_int_distribution<> dis(100000000, 999999999);
-    
-    std::string account_number;
-    do {
-        account_number = std::to_string(dis(gen));
-    } while (accountExists(account_number));
+bool Database::writeIndexImage(const std::string& path, const IndexImage& image) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        return false;
+    }
     
-    return account_number;
+    out << image.end_offset << " " << image.garbage_bytes << " " << image.generation << "\n";
+    for (const auto& entry : image.live_rows) {
+        out << "L " << entry.second.offset << " " << entry.second.length << " " << entry.first << "\n";
+    }
+    for (const auto& entry : image.dead_rows) {
+        out << "D " << entry.first << " " << entry.second << "\n";
+    }
+    out.close();
+    return !out.fail();
 }
 
-// Account operations
-// bool Database::saveAccount(const Account& account) {
-//     std::lock_guard<std::mutex> lock(accounts_mutex);
-    
-//     Account existing_account;
-//     if (loadAccount(account.getAccountNumber(), existing_account)) {
-//         return updateAccount(account);
-//     }
-    
-//     std::ofstream file(accounts_file, std::ios::app);
-//     if (!file.is_open()) {
-//         return false;
-//     }
-    
-//     file << account.toCsvRow() << std::endl;
-//     file.close();
-    
-//     logOperation("ACCOUNT_SAVE", "Account " + account.getAccountNumber() + " saved");
-//     return true;
-// }
-bool Database::saveAccount(const Account& account) {
-    std::cout << "[DEBUG] === saveAccount START ===" << std::endl;
-    std::cout << "[DEBUG] Account number: " << account.getAccountNumber() << std::endl;
-    std::cout << "[DEBUG] Customer ID: " << account.getCustomerId() << std::endl;
-    
-    std::cout << "[DEBUG] Attempting to acquire accounts_mutex..." << std::endl;
-    std::lock_guard<std::mutex> lock(accounts_mutex);
-    std::cout << "[DEBUG] accounts_mutex acquired successfully" << std::endl;
-    
-    // Check if account already exists (THIS MIGHT BE THE PROBLEM)
-    std::cout << "[DEBUG] Checking if account already exists..." << std::endl;
-    Account existing_account;
-    
-    // TEMPORARILY COMMENT OUT THIS CHECK - it might be causing deadlock
-    /*
-    if (loadAccount(account.getAccountNumber(), existing_account)) {
-        std::cout << "[DEBUG] Account exists, updating..." << std::endl;
-        return updateAccount(account);
+bool Database::loadTableIndex(Table& table) {
+    std::ifstream in(table.file + ".idx", std::ios::binary);
+    if (!in.is_open()) {
+        return false;
     }
-    */
     
-    std::cout << "[DEBUG] Account doesn't exist, creating new..." << std::endl;
-    std::cout << "[DEBUG] Opening accounts file: " << accounts_file << std::endl;
-    
-    std::ofstream file(accounts_file, std::ios::app);
-    if (!file.is_open()) {
-        std::cout << "[ERROR] Failed to open accounts file: " << accounts_file << std::endl;
+    std::uintmax_t end_offset = 0;
+    std::uintmax_t garbage_bytes = 0;
+    uint64_t generation = 0;
+    if (!(in >> end_offset >> garbage_bytes >> generation)) {
         return false;
     }
-    std::cout << "[DEBUG] Accounts file opened successfully" << std::endl;
     
-    std::cout << "[DEBUG] Converting account to CSV..." << std::endl;
-    std::string csv_row = account.toCsvRow();
-    std::cout << "[DEBUG] CSV row: " << csv_row << std::endl;
+    // The index is only usable if the file still has everything it covers
+    // and the covered region ends on a row boundary
+    std::error_code ec;
+    std::uintmax_t file_size = std::filesystem::file_size(table.file, ec);
+    if (ec || file_size < end_offset) {
+        return false;
+    }
+    if (end_offset > 0) {
+        std::ifstream data(table.file, std::ios::binary);
+        data.seekg(static_cast<std::streamoff>(end_offset - 1));
+        if (data.get() != '\n') {
+            return false;
+        }
+    }
     
-    std::cout << "[DEBUG] Writing to file..." << std::endl;
-    file << csv_row << std::endl;
-    std::cout << "[DEBUG] Data written to file" << std::endl;
-    
-    std::cout << "[DEBUG] Closing file..." << std::endl;
-    file.close();
-    std::cout << "[DEBUG] File closed successfully" << std::endl;
-    
-    std::cout << "[DEBUG] Logging operation..." << std::endl;
-    logOperation("ACCOUNT_SAVE", "Account " + account.getAccountNumber() + " saved");
-    std::cout << "[DEBUG] Operation logged" << std::endl;
+    std::unordered_map<std::string, RowLocation> live_rows;
+    std::unordered_map<std::uintmax_t, std::uintmax_t> dead_rows;
+    std::string kind;
+    while (in >> kind) {
+        RowLocation location;
+        if (!(in >> location.offset >> location.length) || location.offset + location.length > end_offset) {
+            return false;
+        }
+        if (kind == "L") {
+            std::string key;
+            if (!(in >> key)) {
+                return false;
+            }
+            live_rows[key] = location;
+        } else if (kind == "D") {
+            dead_rows[location.offset] = location.length;
+        } else {
+            return false;
+        }
+    }
     
-    std::cout << "[DEBUG] === saveAccount END - SUCCESS ===" << std::endl;
+    table.live_rows.swap(live_rows);
+    table.dead_rows.swap(dead_rows);
+    table.end_offset = end_offset;
+    table.garbage_bytes = garbage_bytes;
+    table.indexed_offset = end_offset;
+    table.generation = generation;
     return true;
 }
 
-bool Database::loadAccount(const std::string& account_number, Account& account) {
-    std::lock_guard<std::mutex> lock(accounts_mutex);
-    
-    std::ifstream file(accounts_file);
-    if (!file.is_open()) {
+bool Database::appendRows(Table& table, const std::vector<RowWrite>& writes) {
+    if (writes.empty()) {
+        return true;
+    }
+    if (read_only) {
+        std::cout << "[ERROR] " << table.file << " is open read-only" << std::endl;
         return false;
     }
     
-    std::string line;
-    std::getline(file, line); // Skip header
+    // Serialize the whole batch so the file sees a single append
+    std::string data;
+    std::vector<RowLocation> locations;
+    locations.reserve(writes.size());
+    std::uintmax_t offset = table.end_offset;
+    
+    for (const auto& write : writes) {
+        std::string row = write.tombstone ? write.key + "," + TOMBSTONE_MARKER : write.row;
+        locations.push_back({offset, row.size() + 1});
+        offset += row.size() + 1;
+        data += row;
+        data += "\n";
+    }
     
-    while (std::getline(file, line)) {
-        if (line.empty()) continue;
-        
-        std::istringstream ss(line);
-        std::string item;
-        std::vector<std::string> tokens;
-        
-        while (std::getline(ss, item, ',')) {
-            tokens.push_back(item);
+    if (!files.append(table.file, data) || !files.commit(table.file)) {
+        // The file handle manager cuts a failed write off the file again.
+        // If that did not work either, the offsets held here no longer
+        // match the file and are rebuilt from it
+        std::error_code ec;
+        std::uintmax_t file_size = std::filesystem::file_size(table.file, ec);
+        if (ec || file_size != table.end_offset) {
+            std::cout << "[ERROR] " << table.file << " does not end where expected after a failed append, reloading" << std::endl;
+            if (!loadTableState(table) || (table.tiered && !loadHotTier(table))) {
+                std::cout << "[ERROR] Failed to reload " << table.file << std::endl;
+            }
+        }
+        return false;
+    }
+    table.end_offset = offset;
+    
+    // The previous version of every key written becomes garbage
+    for (size_t i = 0; i < writes.size(); ++i) {
+        auto it = table.live_rows.find(writes[i].key);
+        if (it != table.live_rows.end()) {
+            table.dead_rows[it->second.offset] = it->second.length;
+            table.garbage_bytes += it->second.length;
+            if (table.tiered) {
+                removeHotRow(table, it->second.offset);
+            }
         }
         
-        if (tokens.size() >= 9 && tokens[0] == account_number) {
-            account.fromCsvRow(line);
-            file.close();
-            return true;
+        if (writes[i].tombstone) {
+            if (it != table.live_rows.end()) {
+                table.live_rows.erase(it);
+            }
+            table.dead_rows[locations[i].offset] = locations[i].length;
+            table.garbage_bytes += locations[i].length;
+        } else {
+            table.live_rows[writes[i].key] = locations[i];
+            if (table.tiered) {
+                addHotRow(table, locations[i], writes[i].row);
+            }
         }
     }
+    if (table.tiered && table.hot_bytes > hot_max_bytes) {
+        demoteHotRows(table);
+    }
+    commit_lsn++;
     
-    file.close();
-    return false;
+    if (needsCompaction(table)) {
+        compaction_cv.notify_one();
+    }
+    
+    if (log_shipper) {
+        std::vector<ReplicatedRow> rows;
+        rows.reserve(writes.size());
+        for (const auto& write : writes) {
+            rows.push_back({write.key, write.row, write.tombstone});
+        }
+        
+        // Shipped under the table lock so the shipped order equals file
+        // order; in synchronous mode StandbyAckWait waits for the standby
+        // once the write has released its locks
+        uint64_t seq = log_shipper->ship(table.name, table.shard, rows);
+        if (log_shipper->isSynchronous()) {
+            awaited_ack.pending = true;
+            awaited_ack.seq = std::max(awaited_ack.seq, seq);
+        }
+    }
+    return true;
 }
 
-bool Database::accountExists(const std::string& account_number) {
-    Account account;
-    return loadAccount(account_number, account);
+Database::StandbyAckWait::StandbyAckWait(Database& database) : database(database) {
+    awaited_ack.depth++;
 }
 
-// Transaction operations
-bool Database::saveTransaction(const Transaction& transaction) {
-    std::lock_guard<std::mutex> lock(transactions_mutex);
+Database::StandbyAckWait::~StandbyAckWait() {
+    // Only the outermost write waits; nested ones still hold its locks
+    if (--awaited_ack.depth > 0 || !awaited_ack.pending) {
+        return;
+    }
+    uint64_t seq = awaited_ack.seq;
+    awaited_ack.pending = false;
+    awaited_ack.seq = 0;
+    if (database.log_shipper) {
+        database.log_shipper->waitForAck(seq);
+    }
+}
+
+bool Database::readRowLocked(Table& table, const std::string& key, std::string& row) {
+    auto it = table.live_rows.find(key);
+    if (it == table.live_rows.end()) {
+        return false;
+    }
     
-    std::ofstream file(transactions_file, std::ios::app);
+    std::ifstream file(table.file, std::ios::binary);
     if (!file.is_open()) {
         return false;
     }
     
-    file << transaction.toCsvRow() << std::endl;
-    file.close();
-    
-    logOperation("TRANSACTION_SAVE", "Transaction " + transaction.getTransactionId() + " saved");
+    file.seekg(static_cast<std::streamoff>(it->second.offset));
+    if (!std::getline(file, row)) {
+        return false;
+    }
+    if (!row.empty() && row.back() == '\r') {
+        row.pop_back();
+    }
     return true;
 }
 
-std::vector<Transaction> Database::getTransactionsByAccount(const std::string& account_id) {
-    std::lock_guard<std::mutex> lock(transactions_mutex);
-    std::vector<Transaction> transactions;
-    
-    std::ifstream file(transactions_file);
-    if (!file.is_open()) {
-        return transactions;
-    }
-    
-    std::string line;
-    std::getline(file, line); // Skip header
-    
-    while (std::getline(file, line)) {
-        if (line.empty()) continue;
-        
-        std::istringstream ss(line);
-        std::string item;
-        std::vector<std::string> tokens;
-        
-        while (std::getline(ss, item, ',')) {
-            tokens.push_back(item);
-        }
+void Database::createShards() {
+    account_shards.clear();
+    transaction_shards.clear();
+    
+    for (size_t shard = 0; shard < shard_count; ++shard) {
+        account_shards.push_back(std::make_unique<Table>());
+        account_shards.back()->name = "accounts";
+        account_shards.back()->shard = shard;
+        account_shards.back()->file = shardFilePath(data_directory, "accounts", shard, shard_count);
         
-        if (tokens.size() >= 11 && 
-            (tokens[1] == account_id || tokens[2] == account_id)) {
-            Transaction transaction;
-            transaction.fromCsvRow(line);
-            transactions.push_back(transaction);
-        }
+        transaction_shards.push_back(std::make_unique<Table>());
+        transaction_shards.back()->name = "transactions";
+        transaction_shards.back()->shard = shard;
+        transaction_shards.back()->tiered = true;
+        transaction_shards.back()->file = shardFilePath(data_directory, "transactions", shard, shard_count);
     }
-    
-    file.close();
-    return transactions;
 }
 
-// FIXED: createSampleData function with proper password hashing
-bool Database::createSampleData() {
-    std::cout << "Starting sample data creation..." << std::endl;
-    
-    // Create sample admin user with proper password hash
-    std::cout << "Creating admin user..." << std::endl;
-    
-    // Generate proper hash for "password"
-    std::string admin_password_hash = hashPassword("password");
-    User admin_user("admin", admin_password_hash, "admin@bank.com", "System Administrator", "555-0000", UserRole::ADMIN);
-    
-    std::cout << "Admin user created with ID: " << admin_user.getUserId() << std::endl;
-    std::cout << "Admin password hash: " << admin_password_hash << std::endl;
-    std::cout << "Saving admin user..." << std::endl;
-    bool saved = saveUser(admin_user);
-    std::cout << "Admin user save result: " << (saved ? "SUCCESS" : "FAILED") << std::endl;
-    
-    // Create sample customer with proper password hash
-    std::cout << "Creating customer user..." << std::endl;
-    std::string customer_password_hash = hashPassword("customer123");
-    User customer("johndoe", customer_password_hash, "john@email.com", "John Doe", "555-1234", UserRole::CUSTOMER);
-    
-    std::cout << "Customer user created with ID: " << customer.getUserId() << std::endl;
-    std::cout << "Customer password hash: " << customer_password_hash << std::endl;
-    std::cout << "Saving customer user..." << std::endl;
-    saved = saveUser(customer);
-    std::cout << "Customer user save result: " << (saved ? "SUCCESS" : "FAILED") << std::endl;
-    
-    // Create sample account
-    std::cout << "Generating account number..." << std::endl;
-    std::string account_number = generateAccountNumber();
-    std::cout << "Generated account number: " << account_number << std::endl;
-    
-    std::cout << "Creating checking account..." << std::endl;
-    Account checking_account(account_number, customer.getUserId(), AccountType::CHECKING, 1000.0);
-    checking_account.setStatus(AccountStatus::ACTIVE);
-    std::cout << "Saving account..." << std::endl;
-    saveAccount(checking_account);
-    std::cout << "Account saved." << std::endl;
-    
-    // Add account to customer
-    std::cout << "Adding account to customer..." << std::endl;
-    customer.addAccountId(checking_account.getAccountNumber());
-    std::cout << "Updating customer with account..." << std::endl;
-    updateUser(customer);
-    std::cout << "Customer updated." << std::endl;
-    
-    std::cout << "Logging sample data creation..." << std::endl;
-    logOperation("SYSTEM", "Sample data created successfully");
-    std::cout << "Sample data creation completed!" << std::endl;
-    return true;
+std::string Database::shardFilePath(const std::string& data_dir, const std::string& table,
+                                    size_t shard, size_t shard_count) {
+    // A single shard keeps the original file names
+    std::string suffix = shard_count == 1 ? "" : "_" + std::to_string(shard);
+    return data_dir + "/" + table + "/" + table + suffix + ".csv";
 }
 
-bool Database::updateUser(const User& user) {
-    std::lock_guard<std::mutex> lock(users_mutex);
-    
-    std::vector<std::string> lines;
-    std::ifstream file(users_file);
-    if (!file.is_open()) {
-        return false;
+uint64_t Database::shardHash(const std::string& account_number) {
+    // FNV-1a: placement on disk must not depend on the standard library
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : account_number) {
+        hash = (hash ^ c) * 1099511628211ull;
     }
-    
-    std::string line;
-    bool updated = false;
-    
-    while (std::getline(file, line)) {
-        if (line.empty() || line.find("user_id,") == 0) {
-            lines.push_back(line);
-            continue;
+    return hash;
+}
+
+size_t Database::readShardManifest(const std::string& data_dir) {
+    std::ifstream manifest(data_dir + "/shards.conf");
+    size_t stored = 0;
+    if (manifest.is_open()) {
+        manifest >> stored;
+    }
+    return stored;
+}
+
+bool Database::loadShardManifest() {
+    std::string manifest_path = data_directory + "/shards.conf";
+    
+    // Layout: "<shard count> <hash scheme>"
+    std::ifstream manifest(manifest_path);
+    if (manifest.is_open()) {
+        size_t stored = 0;
+        std::string scheme;
+        manifest >> stored >> scheme;
+        manifest.close();
+        if (stored == 0 || (!scheme.empty() && scheme != SHARD_HASH_FNV1A && scheme != SHARD_HASH_STD)) {
+            std::cout << "[ERROR] Corrupt shard manifest: " << manifest_path << std::endl;
+            return false;
         }
-        
-        std::vector<std::string> tokens;
-        std::stringstream ss(line);
-        std::string token;
-        
-        while (std::getline(ss, token, ',')) {
-            tokens.push_back(token);
+        if (stored != shard_count) {
+            std::cout << "[WARNING] Data directory was created with " << stored << " shards, ignoring requested "
+                      << shard_count << std::endl;
+            shard_count = stored;
+            createShards();
+        }
+        if (!scheme.empty()) {
+            shard_hash_scheme = scheme;
+            return true;
         }
         
-        if (tokens.size() >= 2 && tokens[0] == user.getUserId()) {
-            lines.push_back(user.toCsvRow());
-            updated = true;
-        } else {
-            lines.push_back(line);
+        // Manifests without a scheme were written when accounts were placed
+        // with std::hash. One shard places every account alike; otherwise the
+        // directory keeps std::hash and is only readable by the same build
+        if (shard_count > 1) {
+            std::cout << "[WARNING] " << data_directory << " places accounts with std::hash; it can only be "
+                      << "opened by builds with the same standard library" << std::endl;
+            shard_hash_scheme = SHARD_HASH_STD;
         }
+    } else if (shard_count != 1 && std::filesystem::exists(data_directory + "/accounts/accounts.csv")) {
+        // A directory without manifest but with the unsharded files predates
+        // sharding and can only be opened with one shard
+        std::cout << "[WARNING] Existing unsharded data directory, using 1 shard" << std::endl;
+        shard_count = 1;
+        createShards();
     }
-    file.close();
-    
-    if (!updated) {
-        return false;
+    if (read_only) {
+        return true;
     }
     
-    std::ofstream out_file(users_file);
-    if (!out_file.is_open()) {
+    std::ofstream out(manifest_path, std::ios::trunc);
+    if (!out.is_open()) {
+        std::cout << "[ERROR] Failed to write shard manifest: " << manifest_path << std::endl;
         return false;
     }
-    
-    for (const auto& l : lines) {
-        out_file << l << "\n";
-    }
-    out_file.close();
-    
-    logOperation("UPDATE_USER", "Updated user: " + user.getUsername());
+    out << shard_count << " " << shard_hash_scheme << "\n";
     return true;
 }
 
-bool Database::deleteUser(const std::string& user_id) {
-    std::lock_guard<std::mutex> lock(users_mutex);
-    
-    std::vector<std::string> lines;
-    std::ifstream file(users_file);
-    if (!file.is_open()) {
-        return false;
+size_t Database::shardIndex(const std::string& account_number) const {
+    if (shard_hash_scheme == SHARD_HASH_STD) {
+        return std::hash<std::string>{}(account_number) % shard_count;
     }
-    
-    std::string line;
-    bool deleted = false;
-    
-    while (std::getline(file, line)) {
-        if (line.empty() || line.find("user_id,") == 0) {
-            lines.push_back(line);
-            continue;
-        }
-        
-        std::vector<std::string> tokens;
-        std::stringstream ss(line);
-        std::string token;
-        
-        while (std::getline(ss, token, ',')) {
-            tokens.push_back(token);
-        }
-        
-        if (tokens.size() >= 2 && tokens[0] == user_id) {
-            deleted = true;
-            // Don't add this line (effectively deleting it)
-        } else {
-            lines.push_back(line);
+    return shardHash(account_number) % shard_count;
+}
+
+Database::Table& Database::accountShard(const std::string& account_number) {
+    return *account_shards[shardIndex(account_number)];
+}
+
+Database::Table& Database::transactionShard(const Transaction& transaction) {
+    // Stored with the debited account; deposits have no source account
+    return *transaction_shards[transactionShardIndex(transaction)];
+}
+
+size_t Database::transactionShardIndex(const Transaction& transaction) const {
+    const std::string& owner = transaction.getFromAccountId().empty()
+        ? transaction.getToAccountId() : transaction.getFromAccountId();
+    return shardIndex(owner);
+}
+
+Database::Table* Database::findTransactionShard(const std::string& transaction_id) {
+    for (auto& shard : transaction_shards) {
+        std::shared_lock<std::shared_mutex> lock(shard->mutex);
+        if (shard->live_rows.count(transaction_id) > 0) {
+            return shard.get();
         }
     }
-    file.close();
-    
-    if (!deleted) {
-        return false;
+    return nullptr;
+}
+
+Database::Table* Database::findTable(const std::string& name, size_t shard) {
+    if (name == "users" && shard == 0) {
+        return &users_table;
+    }
+    if (name == "idempotency" && shard == 0) {
+        return &idempotency_table;
+    }
+    if (name == "standing_orders" && shard == 0) {
+        return &standing_orders_table;
+    }
+    if (name == "accounts" && shard < account_shards.size()) {
+        return account_shards[shard].get();
     }
+    if (name == "transactions" && shard < transaction_shards.size()) {
+        return transaction_shards[shard].get();
+    }
+    return nullptr;
+}
+
+std::vector<Database::Table*> Database::allTables() {
+    std::vector<Table*> tables = {&users_table, &idempotency_table, &standing_orders_table};
+    for (auto& shard : account_shards) tables.push_back(shard.get());
+    for (auto& shard : transaction_shards) tables.push_back(shard.get());
+    return tables;
+}
+
+// Add the hashPassword function to Database class
+std::string Database::hashPassword(const std::string& password) {
+    // Same implementation as in BankingService for consistency
+    std::hash<std::string> hasher;
+    std::string salted = password + "banking_salt_2024";
+    
+    // Apply multiple rounds of hashing for better security
+    size_t hash1 = hasher(salted);
+    size_t hash2 = hasher(std::to_string(hash1) + "extra_salt");
+    size_t hash3 = hasher(std::to_string(hash2) + salted);
+    
+    // Combine hashes and convert to hex string
+    std::ostringstream oss;
+    oss << std::hex << hash1 << hash2 << hash3;
+    return oss.str();
+}
+
+// User operations
+bool Database::saveUser(const User& user) {
+    StandbyAckWait ack_wait(*this);
+    std::cout << "saveUser called for user: " << user.getUserId() << std::endl;
+    std::unique_lock<std::shared_mutex> lock(users_table.mutex);
+    std::cout << "Mutex acquired" << std::endl;
+    
+    // An existing user simply gets a newer row version
+    bool exists = users_table.live_rows.count(user.getUserId()) > 0;
+    std::cout << (exists ? "User exists, updating..." : "User doesn't exist, creating new...") << std::endl;
+    
+    std::cout << "Converting user to CSV..." << std::endl;
+    std::string csv_row = user.toCsvRow();
+    std::cout << "CSV row: " << csv_row << std::endl;
     
-    std::ofstream out_file(users_file);
-    if (!out_file.is_open()) {
+    if (!appendRows(users_table, {{user.getUserId(), csv_row, false}})) {
+        std::cout << "Failed to write users file!" << std::endl;
         return false;
     }
+    std::cout << "User row committed" << std::endl;
     
-    for (const auto& l : lines) {
-        out_file << l << "\n";
+    if (exists) {
+        logOperation("UPDATE_USER", "Updated user: " + user.getUsername());
+    } else {
+        logOperation("USER_SAVE", "User " + user.getUserId() + " saved");
     }
-    out_file.close();
-    
-    logOperation("DELETE_USER", "Deleted user: " + user_id);
+    std::cout << "Operation logged" << std::endl;
     return true;
 }
 
-std::vector<User> Database::getAllUsers() {
-    std::lock_guard<std::mutex> lock(users_mutex);
-    std::vector<User> users;
+bool Database::loadUser(const std::string& user_id, User& user) {
+    std::cout << "loadUser called for: " << user_id << std::endl;
+    std::shared_lock<std::shared_mutex> lock(users_table.mutex);
+    std::cout << "loadUser mutex acquired" << std::endl;
     
-    std::ifstream file(users_file);
-    if (!file.is_open()) {
-        return users;
-    }
+    return loadUserInternal(user_id, user);
+}
+
+// bool Database::loadUserByUsername(const std::string& username, User& user) {
+//     std::lock_guard<std::mutex> lock(users_mutex);
     
-    std::string line;
-    while (std::getline(file, line)) {
-        if (line.empty() || line.find("user_id,") == 0) {
-            continue;
+//     std::ifstream file(users_file);
+//     if (!file.is_open()) {
+//         return false;
+//     }
+    
+//     std::string line;
+//     std::getline(file, line); // Skip header
+    
+//     while (std::getline(file, line)) {
+//         if (line.empty()) continue;
+        
+//         std::istringstream ss(line);
+//         std::string item;
+//         std::vector<std::string> tokens;
+        
+//         while (std::getline(ss, item, ',')) {
+//             tokens.push_back(item);
+//         }
+        
+//         if (tokens.size() >= 11 && tokens[1] == username) {
+//             user.fromCsvRow(line);
+//             file.close();
+//             return true;
+//         }
+//     }
+    
+//     file.close();
+//     return false;
+// }
+bool Database::loadUserByUsername(const std::string& username, User& user) {
+    std::cout << "[DEBUG] loadUserByUsername called for: " << username << std::endl;
+    
+    ReadSnapshot snapshot;
+    if (!openSnapshot(users_table, snapshot)) {
+        std::cout << "[DEBUG] Cannot open users file: " << users_table.file << std::endl;
+        return false;
+    }
+    
+    std::string line;
+    nextSnapshotLine(snapshot, line); // Skip header
+    
+    while (nextSnapshotLine(snapshot, line)) {
+        if (line.empty()) continue;
+        
+        std::istringstream ss(line);
+        std::string item;
+        std::vector<std::string> tokens;
+        
+        while (std::getline(ss, item, ',')) {
+            tokens.push_back(item);
+        }
+        
+        if (tokens.size() >= 11 && tokens[1] == username) {
+            std::cout << "[DEBUG] User found by username: " << username << std::endl;
+            user.fromCsvRow(line);
+            return true;
+        }
+    }
+    
+    std::cout << "[DEBUG] User not found by username: " << username << std::endl;
+    return false;
+}
+
+
+bool Database::userExists(const std::string& username) {
+    User user;
+    return loadUserByUsername(username, user);
+}
+
+std::string Database::generateAccountNumber() {
+    thread_local std::random_device rd;
+    thread_local std::mt19937 gen(rd());
+    thread_local std::uniform_int_distribution<> dis(100000000, 999999999);
+    
+    std::string account_number;
+    do {
+        account_number = std::to_string(dis(gen));
+    } while (accountExists(account_number));
+    
+    return account_number;
+}
+
+// Account operations
+// bool Database::saveAccount(const Account& account) {
+//     std::lock_guard<std::mutex> lock(accounts_mutex);
+    
+//     Account existing_account;
+//     if (loadAccount(account.getAccountNumber(), existing_account)) {
+//         return updateAccount(account);
+//     }
+    
+//     std::ofstream file(accounts_file, std::ios::app);
+//     if (!file.is_open()) {
+//         return false;
+//     }
+    
+//     file << account.toCsvRow() << std::endl;
+//     file.close();
+    
+//     logOperation("ACCOUNT_SAVE", "Account " + account.getAccountNumber() + " saved");
+//     return true;
+// }
+bool Database::saveAccount(const Account& account) {
+    StandbyAckWait ack_wait(*this);
+    std::cout << "[DEBUG] === saveAccount START ===" << std::endl;
+    std::cout << "[DEBUG] Account number: " << account.getAccountNumber() << std::endl;
+    std::cout << "[DEBUG] Customer ID: " << account.getCustomerId() << std::endl;
+    
+    std::cout << "[DEBUG] Attempting to acquire accounts mutex..." << std::endl;
+    Table& shard = accountShard(account.getAccountNumber());
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    std::cout << "[DEBUG] accounts mutex acquired successfully" << std::endl;
+    
+    // Existing accounts get a newer row version; no file scan needed
+    bool exists = shard.live_rows.count(account.getAccountNumber()) > 0;
+    std::cout << "[DEBUG] " << (exists ? "Account exists, updating..." : "Account doesn't exist, creating new...") << std::endl;
+    
+    std::cout << "[DEBUG] Converting account to CSV..." << std::endl;
+    std::string csv_row = account.toCsvRow();
+    std::cout << "[DEBUG] CSV row: " << csv_row << std::endl;
+    
+    std::cout << "[DEBUG] Writing to file..." << std::endl;
+    if (!appendRows(shard, {{account.getAccountNumber(), csv_row, false}})) {
+        std::cout << "[ERROR] Failed to write accounts file: " << shard.file << std::endl;
+        return false;
+    }
+    std::cout << "[DEBUG] Data committed to file" << std::endl;
+    
+    std::cout << "[DEBUG] Logging operation..." << std::endl;
+    logOperation("ACCOUNT_SAVE", "Account " + account.getAccountNumber() + " saved");
+    std::cout << "[DEBUG] Operation logged" << std::endl;
+    
+    std::cout << "[DEBUG] === saveAccount END - SUCCESS ===" << std::endl;
+    return true;
+}
+
+bool Database::loadAccount(const std::string& account_number, Account& account) {
+    Table& shard = accountShard(account_number);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    
+    std::string line;
+    if (!readRowLocked(shard, account_number, line)) {
+        return false;
+    }
+    return account.fromCsvRow(line);
+}
+
+bool Database::accountExists(const std::string& account_number) {
+    Table& shard = accountShard(account_number);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    return shard.live_rows.count(account_number) > 0;
+}
+
+// Transaction operations
+bool Database::saveTransaction(const Transaction& transaction) {
+    return saveTransactions({transaction});
+}
+
+bool Database::saveTransactions(const std::vector<Transaction>& transactions) {
+    StandbyAckWait ack_wait(*this);
+    if (transactions.empty()) {
+        return true;
+    }
+    
+    // One append per shard touched by the batch
+    std::map<Table*, std::vector<RowWrite>> writes;
+    std::string ids;
+    for (const auto& transaction : transactions) {
+        writes[&transactionShard(transaction)].push_back(
+            {transaction.getTransactionId(), transaction.toCsvRow(), false});
+        if (!ids.empty()) ids += " ";
+        ids += transaction.getTransactionId();
+    }
+    
+    for (auto& entry : writes) {
+        std::unique_lock<std::shared_mutex> lock(entry.first->mutex);
+        if (!appendRows(*entry.first, entry.second)) {
+            return false;
+        }
+    }
+    
+    if (transactions.size() == 1) {
+        logOperation("TRANSACTION_SAVE", "Transaction " + ids + " saved");
+    } else {
+        logOperation("TRANSACTION_SAVE", std::to_string(transactions.size()) + " transactions saved: " + ids);
+    }
+    return true;
+}
+
+bool Database::loadTransaction(const std::string& transaction_id, Transaction& transaction) {
+    for (auto& shard : transaction_shards) {
+        std::shared_lock<std::shared_mutex> lock(shard->mutex);
+        
+        // Recent rows are answered from the hot tier without touching the file
+        auto it = shard->live_rows.find(transaction_id);
+        if (it != shard->live_rows.end()) {
+            auto hot = shard->hot_rows.find(it->second.offset);
+            if (hot != shard->hot_rows.end()) {
+                transaction = *hot->second.transaction;
+                hot_reads++;
+                return true;
+            }
+        }
+        
+        std::string line;
+        if (readRowLocked(*shard, transaction_id, line)) {
+            disk_reads++;
+            return transaction.fromCsvRow(line);
+        }
+    }
+    return false;
+}
+
+bool Database::transactionExists(const std::string& transaction_id) {
+    return findTransactionShard(transaction_id) != nullptr;
+}
+
+std::vector<Transaction> Database::getTransactionsByAccount(const std::string& account_id) {
+    std::vector<Transaction> transactions;
+    scanTransactionsByAccount(account_id, ScanOptions(), [&](const Transaction& transaction) {
+        transactions.push_back(transaction);
+        return true;
+    });
+    return transactions;
+}
+
+ScanResult Database::scanTransactions(const TransactionFilter& filter, const ScanOptions& options,
+                                      const TransactionVisitor& visitor) {
+    return scanTransactionShards(filter, nullptr, options, visitor);
+}
+
+ScanResult Database::scanTransactionsByAccount(const std::string& account_id, const ScanOptions& options,
+                                               const TransactionVisitor& visitor) {
+    return scanTransactionShards([&account_id](const Transaction& transaction) {
+        return transaction.getFromAccountId() == account_id || transaction.getToAccountId() == account_id;
+    }, &account_id, options, visitor);
+}
+
+// Shards are read in file order. When options.since is newer than every
+// row outside the hot tier the shard is served from memory, through the
+// per-account index if account_id is set; otherwise the file is scanned
+// through a snapshot. Both paths produce the same resume tokens.
+ScanResult Database::scanTransactionShards(const TransactionFilter& filter, const std::string* account_id,
+                                           const ScanOptions& options, const TransactionVisitor& visitor) {
+    ScanResult result;
+    
+    size_t start_shard = 0;
+    uint64_t start_generation = 0;
+    std::uintmax_t start_offset = 0;
+    bool resuming = !options.resume_token.empty();
+    if (resuming && (!parseResumeToken(options.resume_token, start_shard, start_generation, start_offset) ||
+                     start_shard >= transaction_shards.size())) {
+        result.ok = false;
+        return result;
+    }
+    
+    size_t skipped = 0;
+    bool page_full = false;
+    
+    // Hands one row to the visitor; returns true once the page is complete
+    // and the resume token for the row after it has been set
+    auto offer = [&](const Transaction& transaction, size_t shard, uint64_t generation, std::uintmax_t offset) {
+        if (options.since > 0 && std::chrono::system_clock::to_time_t(transaction.getTimePoint()) < options.since) {
+            return false;
+        }
+        if (filter && !filter(transaction)) {
+            return false;
+        }
+        
+        if (page_full) {
+            // First match past the page; the next call starts here
+            result.has_more = true;
+            result.resume_token = makeResumeToken(shard, generation, offset);
+            return true;
+        }
+        
+        if (skipped < options.offset) {
+            skipped++;
+            return false;
+        }
+        
+        result.returned++;
+        if (!visitor(transaction) || (options.limit > 0 && result.returned >= options.limit)) {
+            page_full = true;
+        }
+        return false;
+    };
+    
+    for (size_t shard = start_shard; shard < transaction_shards.size(); ++shard) {
+        Table& table = *transaction_shards[shard];
+        std::uintmax_t start = resuming && shard == start_shard ? start_offset : 0;
+        
+        ReadSnapshot snapshot;
+        bool read_disk;
+        std::vector<std::pair<std::uintmax_t, std::shared_ptr<const Transaction>>> hot;
+        {
+            std::shared_lock<std::shared_mutex> lock(table.mutex);
+            
+            if (resuming && shard == start_shard &&
+                (table.generation != start_generation || start_offset > table.end_offset)) {
+                result.ok = false;
+                return result;
+            }
+            
+            read_disk = !(options.since > 0 && options.since > table.cold_newest);
+            if (read_disk) {
+                if (!openSnapshotLocked(table, snapshot)) {
+                    continue;
+                }
+            }
+            snapshot.generation = table.generation;
+            
+            // Only pointers are copied; the rows themselves are immutable
+            if (read_disk) {
+                // The file has every row
+            } else if (account_id) {
+                auto account = table.hot_by_account.find(*account_id);
+                if (account != table.hot_by_account.end()) {
+                    for (auto it = account->second.lower_bound(start); it != account->second.end(); ++it) {
+                        hot.emplace_back(*it, table.hot_rows.at(*it).transaction);
+                    }
+                }
+            } else {
+                for (auto it = table.hot_rows.lower_bound(start); it != table.hot_rows.end(); ++it) {
+                    hot.emplace_back(it->first, it->second.transaction);
+                }
+            }
+        }
+        
+        if (read_disk) {
+            disk_reads++;
+            if (start > 0) {
+                snapshot.stream.seekg(static_cast<std::streamoff>(start));
+                snapshot.position = start;
+            }
+            
+            // One row is parsed at a time; nothing is buffered beyond the visitor
+            std::string line;
+            while (nextSnapshotLine(snapshot, line)) {
+                if (line.empty() || line.find("transaction_id,") == 0) {
+                    continue;
+                }
+                
+                Transaction transaction;
+                if (transaction.fromCsvRow(line) &&
+                    offer(transaction, shard, snapshot.generation, snapshot.line_offset)) {
+                    return result;
+                }
+            }
+        } else {
+            hot_reads++;
+        }
+        
+        for (const auto& entry : hot) {
+            if (offer(*entry.second, shard, snapshot.generation, entry.first)) {
+                return result;
+            }
+        }
+    }
+    
+    return result;
+}
+
+bool Database::saveIdempotencyRecord(const std::string& key, const std::string& row,
+                                     const std::vector<std::string>& dropped_keys) {
+    StandbyAckWait ack_wait(*this);
+    std::unique_lock<std::shared_mutex> lock(idempotency_table.mutex);
+    
+    // Tombstones first: a dropped key may be the one being written again
+    std::vector<RowWrite> writes;
+    for (const auto& dropped : dropped_keys) {
+        if (idempotency_table.live_rows.count(dropped) > 0) {
+            writes.push_back({dropped, "", true});
+        }
+    }
+    writes.push_back({key, row, false});
+    return appendRows(idempotency_table, writes);
+}
+
+bool Database::deleteIdempotencyRecords(const std::vector<std::string>& keys) {
+    StandbyAckWait ack_wait(*this);
+    std::unique_lock<std::shared_mutex> lock(idempotency_table.mutex);
+    
+    std::vector<RowWrite> writes;
+    for (const auto& key : keys) {
+        if (idempotency_table.live_rows.count(key) > 0) {
+            writes.push_back({key, "", true});
+        }
+    }
+    return writes.empty() || appendRows(idempotency_table, writes);
+}
+
+bool Database::saveStandingOrders(const std::vector<StandingOrder>& orders) {
+    StandbyAckWait ack_wait(*this);
+    if (orders.empty()) {
+        return true;
+    }
+    
+    std::vector<RowWrite> writes;
+    writes.reserve(orders.size());
+    for (const auto& order : orders) {
+        writes.push_back({order.getOrderId(), order.toCsvRow(), false});
+    }
+    
+    std::unique_lock<std::shared_mutex> lock(standing_orders_table.mutex);
+    return appendRows(standing_orders_table, writes);
+}
+
+bool Database::scanLiveRows(const std::string& table_name, size_t shard, std::string& header,
+                            const RowVisitor& visitor) {
+    Table* table = findTable(table_name, shard);
+    if (!table) {
+        return false;
+    }
+    
+    ReadSnapshot snapshot;
+    if (!openSnapshot(*table, snapshot)) {
+        return false;
+    }
+    
+    std::string line;
+    header.clear();
+    if (nextSnapshotLine(snapshot, line)) {
+        header = line;
+    }
+    while (nextSnapshotLine(snapshot, line)) {
+        if (!line.empty() && !visitor(line)) {
+            break;
+        }
+    }
+    return true;
+}
+
+// FIXED: createSampleData function with proper password hashing
+bool Database::createSampleData() {
+    std::cout << "Starting sample data creation..." << std::endl;
+    
+    // Create sample admin user with proper password hash
+    std::cout << "Creating admin user..." << std::endl;
+    
+    // Generate proper hash for "password"
+    std::string admin_password_hash = hashPassword("password");
+    User admin_user("admin", admin_password_hash, "admin@bank.com", "System Administrator", "555-0000", UserRole::ADMIN);
+    
+    std::cout << "Admin user created with ID: " << admin_user.getUserId() << std::endl;
+    std::cout << "Admin password hash: " << admin_password_hash << std::endl;
+    std::cout << "Saving admin user..." << std::endl;
+    bool saved = saveUser(admin_user);
+    std::cout << "Admin user save result: " << (saved ? "SUCCESS" : "FAILED") << std::endl;
+    
+    // Create sample customer with proper password hash
+    std::cout << "Creating customer user..." << std::endl;
+    std::string customer_password_hash = hashPassword("customer123");
+    User customer("johndoe", customer_password_hash, "john@email.com", "John Doe", "555-1234", UserRole::CUSTOMER);
+    
+    std::cout << "Customer user created with ID: " << customer.getUserId() << std::endl;
+    std::cout << "Customer password hash: " << customer_password_hash << std::endl;
+    std::cout << "Saving customer user..." << std::endl;
+    saved = saveUser(customer);
+    std::cout << "Customer user save result: " << (saved ? "SUCCESS" : "FAILED") << std::endl;
+    
+    // Create sample account
+    std::cout << "Generating account number..." << std::endl;
+    std::string account_number = generateAccountNumber();
+    std::cout << "Generated account number: " << account_number << std::endl;
+    
+    std::cout << "Creating checking account..." << std::endl;
+    Account checking_account(account_number, customer.getUserId(), AccountType::CHECKING, 1000.0);
+    checking_account.setStatus(AccountStatus::ACTIVE);
+    std::cout << "Saving account..." << std::endl;
+    saveAccount(checking_account);
+    std::cout << "Account saved." << std::endl;
+    
+    // Add account to customer
+    std::cout << "Adding account to customer..." << std::endl;
+    customer.addAccountId(checking_account.getAccountNumber());
+    std::cout << "Updating customer with account..." << std::endl;
+    updateUser(customer);
+    std::cout << "Customer updated." << std::endl;
+    
+    std::cout << "Logging sample data creation..." << std::endl;
+    logOperation("SYSTEM", "Sample data created successfully");
+    std::cout << "Sample data creation completed!" << std::endl;
+    return true;
+}
+
+bool Database::updateUser(const User& user) {
+    StandbyAckWait ack_wait(*this);
+    std::unique_lock<std::shared_mutex> lock(users_table.mutex);
+    
+    if (users_table.live_rows.count(user.getUserId()) == 0) {
+        return false;
+    }
+    
+    // Append the new version; the old row is left for compaction
+    if (!appendRows(users_table, {{user.getUserId(), user.toCsvRow(), false}})) {
+        return false;
+    }
+    
+    logOperation("UPDATE_USER", "Updated user: " + user.getUsername());
+    return true;
+}
+
+bool Database::deleteUser(const std::string& user_id) {
+    StandbyAckWait ack_wait(*this);
+    std::unique_lock<std::shared_mutex> lock(users_table.mutex);
+    
+    if (users_table.live_rows.count(user_id) == 0) {
+        return false;
+    }
+    
+    // Tombstone instead of rewriting the file
+    if (!appendRows(users_table, {{user_id, "", true}})) {
+        return false;
+    }
+    
+    logOperation("DELETE_USER", "Deleted user: " + user_id);
+    return true;
+}
+
+std::vector<User> Database::getAllUsers() {
+    std::vector<User> users;
+    
+    ReadSnapshot snapshot;
+    if (!openSnapshot(users_table, snapshot)) {
+        return users;
+    }
+    
+    std::string line;
+    while (nextSnapshotLine(snapshot, line)) {
+        if (line.empty() || line.find("user_id,") == 0) {
+            continue;
+        }
+        
+        User user;
+        if (user.fromCsvRow(line)) {
+            users.push_back(user);
+        }
+    }
+    
+    return users;
+}
+
+std::vector<Account> Database::getAllAccounts() {
+    std::vector<Account> accounts;
+    
+    for (auto& shard : account_shards) {
+        ReadSnapshot snapshot;
+        if (!openSnapshot(*shard, snapshot)) {
+            continue;
+        }
+        
+        std::string line;
+        while (nextSnapshotLine(snapshot, line)) {
+            if (line.empty() || line.find("account_number,") == 0) {
+                continue;
+            }
+            
+            Account account;
+            if (account.fromCsvRow(line)) {
+                accounts.push_back(account);
+            }
+        }
+    }
+    
+    return accounts;
+}
+
+std::vector<Account> Database::getAccountsByCustomerId(const std::string& customer_id) {
+    std::vector<Account> accounts;
+    
+    for (auto& shard : account_shards) {
+        ReadSnapshot snapshot;
+        if (!openSnapshot(*shard, snapshot)) {
+            continue;
+        }
+        
+        std::string line;
+        while (nextSnapshotLine(snapshot, line)) {
+            if (line.empty() || line.find("account_number,") == 0) {
+                continue;
+            }
+            
+            Account account;
+            if (account.fromCsvRow(line) && account.getCustomerId() == customer_id) {
+                accounts.push_back(account);
+            }
+        }
+    }
+    
+    return accounts;
+}
+
+bool Database::updateAccount(const Account& account) {
+    return updateAccounts({account});
+}
+
+bool Database::updateAccounts(const std::vector<Account>& accounts) {
+    StandbyAckWait ack_wait(*this);
+    if (accounts.empty()) {
+        return true;
+    }
+    
+    // Group the batch by shard; std::map orders the shards so concurrent
+    // batches always lock them in the same order
+    std::map<Table*, std::vector<const Account*>> batch;
+    std::string numbers;
+    for (const auto& account : accounts) {
+        batch[&accountShard(account.getAccountNumber())].push_back(&account);
+        if (!numbers.empty()) numbers += " ";
+        numbers += account.getAccountNumber();
+    }
+    
+    std::vector<std::unique_lock<std::shared_mutex>> locks;
+    for (auto& entry : batch) {
+        locks.emplace_back(entry.first->mutex);
+    }
+    
+    // All-or-nothing: refuse the batch if any account is missing or stale,
+    // and keep the current rows to put back if a later shard cannot be written
+    std::map<Table*, std::vector<RowWrite>> writes;
+    std::map<Table*, std::vector<RowWrite>> previous;
+    if (prepareAccountWritesLocked(batch, writes, &previous) != CommitResult::COMMITTED) {
+        return false;
+    }
+    
+    // A failed append leaves nothing in its file (see appendRows), so only
+    // the shards already written have to be taken back
+    std::vector<Table*> updated;
+    for (auto& entry : writes) {
+        if (!appendRows(*entry.first, entry.second)) {
+            for (Table* table : updated) {
+                appendRows(*table, previous[table]);
+            }
+            logOperation("UPDATE_ACCOUNT_FAILED", "Account rows restored: " + numbers);
+            return false;
+        }
+        updated.push_back(entry.first);
+    }
+    
+    logOperation("UPDATE_ACCOUNT", "Updated account: " + numbers);
+    return true;
+}
+
+CommitResult Database::prepareAccountWritesLocked(const std::map<Table*, std::vector<const Account*>>& batch,
+                                                  std::map<Table*, std::vector<RowWrite>>& writes,
+                                                  std::map<Table*, std::vector<RowWrite>>* previous) {
+    for (const auto& entry : batch) {
+        for (const Account* account : entry.second) {
+            std::string row;
+            Account stored;
+            if (!readRowLocked(*entry.first, account->getAccountNumber(), row) || !stored.fromCsvRow(row)) {
+                return CommitResult::FAILED;
+            }
+            
+            // Someone else updated the account since this copy was read
+            if (stored.getVersion() != account->getVersion()) {
+                return CommitResult::CONFLICT;
+            }
+            
+            Account next = *account;
+            next.setVersion(account->getVersion() + 1);
+            writes[entry.first].push_back({next.getAccountNumber(), next.toCsvRow(), false});
+            if (previous) {
+                (*previous)[entry.first].push_back({next.getAccountNumber(), row, false});
+            }
+        }
+    }
+    return CommitResult::COMMITTED;
+}
+
+CommitResult Database::commitAccountTransaction(const std::vector<Account>& accounts,
+                                                const Transaction& transaction,
+                                                const std::string& idempotency_key,
+                                                const std::string& idempotency_row) {
+    return commitAccountTransactions(accounts, {transaction}, idempotency_key, idempotency_row);
+}
+
+CommitResult Database::commitAccountTransactions(const std::vector<Account>& accounts,
+                                                 const std::vector<Transaction>& transactions,
+                                                 const std::string& idempotency_key,
+                                                 const std::string& idempotency_row) {
+    StandbyAckWait ack_wait(*this);
+    std::map<Table*, std::vector<const Account*>> batch;
+    for (const auto& account : accounts) {
+        batch[&accountShard(account.getAccountNumber())].push_back(&account);
+    }
+    std::map<Table*, std::vector<RowWrite>> records;
+    for (const auto& transaction : transactions) {
+        records[&transactionShard(transaction)].push_back(
+            {transaction.getTransactionId(), transaction.toCsvRow(), false});
+    }
+    // The key goes with the records, so a crash never keeps one without the other
+    if (!idempotency_key.empty()) {
+        records[&idempotency_table].push_back({idempotency_key, idempotency_row, idempotency_row.empty()});
+    }
+    
+    // Account and transaction shards are locked together, in address order
+    // like updateAccounts, so no reader sees the balances without the records
+    std::set<Table*> tables;
+    for (auto& entry : batch) {
+        tables.insert(entry.first);
+    }
+    for (auto& entry : records) {
+        tables.insert(entry.first);
+    }
+    std::vector<std::unique_lock<std::shared_mutex>> locks;
+    for (Table* table : tables) {
+        locks.emplace_back(table->mutex);
+    }
+    
+    // The current rows are kept to put back if the records cannot be written
+    std::map<Table*, std::vector<RowWrite>> writes;
+    std::map<Table*, std::vector<RowWrite>> previous;
+    CommitResult prepared = prepareAccountWritesLocked(batch, writes, &previous);
+    if (prepared != CommitResult::COMMITTED) {
+        return prepared;
+    }
+    
+    // A failed append leaves nothing in its file (see appendRows), so only
+    // the shards already written have to be taken back
+    std::vector<Table*> updated;
+    std::vector<Table*> recorded;
+    auto rollBack = [&]() {
+        for (Table* table : recorded) {
+            std::vector<RowWrite> tombstones;
+            for (const auto& write : records[table]) {
+                if (!write.tombstone) {
+                    tombstones.push_back({write.key, "", true});
+                }
+            }
+            appendRows(*table, tombstones);
+        }
+        for (Table* table : updated) {
+            appendRows(*table, previous[table]);
+        }
+        logOperation("TRANSACTION_FAILED", std::to_string(transactions.size()) +
+                     " transaction(s) not recorded; account rows restored");
+    };
+    
+    for (auto& entry : writes) {
+        if (!appendRows(*entry.first, entry.second)) {
+            rollBack();
+            return CommitResult::FAILED;
+        }
+        updated.push_back(entry.first);
+    }
+    for (auto& entry : records) {
+        if (!appendRows(*entry.first, entry.second)) {
+            rollBack();
+            return CommitResult::FAILED;
+        }
+        recorded.push_back(entry.first);
+    }
+    
+    if (transactions.size() == 1) {
+        logOperation("TRANSACTION_SAVE", "Transaction " + transactions.front().getTransactionId() +
+                     " saved with its account updates");
+    } else {
+        logOperation("TRANSACTION_SAVE", std::to_string(transactions.size()) +
+                     " transactions saved with their account updates");
+    }
+    return CommitResult::COMMITTED;
+}
+
+bool Database::deleteAccount(const std::string& account_number) {
+    StandbyAckWait ack_wait(*this);
+    Table& shard = accountShard(account_number);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    
+    if (shard.live_rows.count(account_number) == 0) {
+        return false;
+    }
+    
+    // Tombstone instead of rewriting the file
+    if (!appendRows(shard, {{account_number, "", true}})) {
+        return false;
+    }
+    
+    logOperation("DELETE_ACCOUNT", "Deleted account: " + account_number);
+    return true;
+}
+
+bool Database::updateTransaction(const Transaction& transaction) {
+    StandbyAckWait ack_wait(*this);
+    Table* shard = findTransactionShard(transaction.getTransactionId());
+    if (!shard) {
+        return false;
+    }
+    
+    std::unique_lock<std::shared_mutex> lock(shard->mutex);
+    
+    if (shard->live_rows.count(transaction.getTransactionId()) == 0) {
+        return false;
+    }
+    
+    if (!appendRows(*shard, {{transaction.getTransactionId(), transaction.toCsvRow(), false}})) {
+        return false;
+    }
+    
+    logOperation("UPDATE_TRANSACTION", "Updated transaction: " + transaction.getTransactionId());
+    return true;
+}
+
+std::vector<Transaction> Database::getAllTransactions() {
+    std::vector<Transaction> transactions;
+    scanTransactions(nullptr, ScanOptions(), [&](const Transaction& transaction) {
+        transactions.push_back(transaction);
+        return true;
+    });
+    return transactions;
+}
+
+std::vector<Transaction> Database::getTransactionsByDateRange(
+    const std::string& start_date, const std::string& end_date) {
+    std::vector<Transaction> transactions;
+    
+    // Lets a range of recent days be answered from the hot tier
+    ScanOptions options;
+    std::tm start_tm = {};
+    std::istringstream start_in(start_date);
+    start_in >> std::get_time(&start_tm, "%Y-%m-%d");
+    if (!start_in.fail()) {
+        start_tm.tm_isdst = -1;
+        options.since = std::mktime(&start_tm);
+    }
+    
+    scanTransactions([&](const Transaction& transaction) {
+        std::string tx_date = transaction.getTimestamp().substr(0, 10); // Extract YYYY-MM-DD
+        return tx_date >= start_date && tx_date <= end_date;
+    }, options, [&](const Transaction& transaction) {
+        transactions.push_back(transaction);
+        return true;
+    });
+    return transactions;
+}
+
+bool Database::backup() {
+    std::string backup_dir = data_directory + "/backups/" + getCurrentTimestamp();
+    
+    if (!ensureDirectoryExists(backup_dir)) {
+        return false;
+    }
+    
+    // Make sure buffered appends are on disk before copying
+    files.commitAll();
+    
+    // Copy all data files to backup directory
+    std::vector<std::string> files_to_backup = {data_directory + "/shards.conf"};
+    for (Table* table : allTables()) {
+        files_to_backup.push_back(table->file);
+    }
+    
+    for (const auto& file : files_to_backup) {
+        std::ifstream src(file, std::ios::binary);
+        if (!src.is_open()) continue;
+        
+        std::string filename = file.substr(file.find_last_of("/\\") + 1);
+        std::ofstream dst(backup_dir + "/" + filename, std::ios::binary);
+        if (dst.is_open()) {
+            dst << src.rdbuf();
+            dst.close();
+        }
+        src.close();
+    }
+    
+    logOperation("BACKUP", "System backup created: " + backup_dir);
+    return true;
+}
+
+bool Database::restore(const std::string& backup_path) {
+    // Implementation for restore functionality
+    logOperation("RESTORE", "Restore attempted from: " + backup_path);
+    return true; // Simplified implementation
+}
+
+bool Database::validateDataIntegrity() {
+    // Check file existence and format
+    for (Table* table : allTables()) {
+        const std::string& file = table->file;
+        std::ifstream f(file);
+        if (!f.is_open()) {
+            logOperation("INTEGRITY_CHECK", "Failed to open file: " + file);
+            return false;
+        }
+        f.close();
+    }
+    
+    logOperation("INTEGRITY_CHECK", "Data integrity validation passed");
+    return true;
+}
+
+void Database::cleanup() {
+    // Clean up old log files and temporary data
+    files.commitAll();
+    logOperation("CLEANUP", "Database cleanup completed");
+}
+
+size_t Database::getUserCount() {
+    std::shared_lock<std::shared_mutex> lock(users_table.mutex);
+    return users_table.live_rows.size();
+}
+
+size_t Database::getAccountCount() {
+    size_t count = 0;
+    for (auto& shard : account_shards) {
+        std::shared_lock<std::shared_mutex> lock(shard->mutex);
+        count += shard->live_rows.size();
+    }
+    return count;
+}
+
+double Database::getTotalSystemBalance() {
+    double total = 0.0;
+    auto accounts = getAllAccounts();
+    for (const auto& account : accounts) {
+        if (account.isActive()) {
+            total += account.getBalance();
+        }
+    }
+    return total;
+}
+
+size_t Database::getTransactionCount() {
+    size_t count = 0;
+    for (auto& shard : transaction_shards) {
+        std::shared_lock<std::shared_mutex> lock(shard->mutex);
+        count += shard->live_rows.size();
+    }
+    return count;
+}
+
+size_t Database::getShardCount() const {
+    return shard_count;
+}
+
+std::string Database::getShardHashScheme() const {
+    return shard_hash_scheme;
+}
+
+bool Database::loadUserInternal(const std::string& user_id, User& user) {
+    // Internal version of loadUser that doesn't use mutex (assumes caller already has it)
+    std::cout << "loadUserInternal called for: " << user_id << std::endl;
+    
+    std::string line;
+    if (!readRowLocked(users_table, user_id, line)) {
+        std::cout << "User not found in file" << std::endl;
+        return false;
+    }
+    
+    // Create user from CSV data
+    user = User();
+    user.fromCsvRow(line);
+    std::cout << "User loaded successfully" << std::endl;
+    return true;
+}
+
+size_t Database::getFileWriteCount() const {
+    return file_write_count.load() + files.getFlushCount();
+}
+
+uint64_t Database::getCommitLsn() const {
+    return commit_lsn.load();
+}
+
+// Compaction
+void Database::setCompactionPolicy(double garbage_ratio, std::uintmax_t min_garbage_bytes,
+                                   std::uintmax_t io_budget_bytes_per_sec) {
+    // Meant to be called before initialize() starts the compaction thread
+    compaction_garbage_ratio = garbage_ratio;
+    compaction_min_garbage_bytes = min_garbage_bytes;
+    compaction_io_budget = std::max<std::uintmax_t>(io_budget_bytes_per_sec, 1);
+}
+
+CompactionStats Database::getCompactionStats() {
+    std::lock_guard<std::mutex> lock(compaction_stats_mutex);
+    return compaction_stats;
+}
+
+bool Database::needsCompaction(const Table& table) const {
+    return table.garbage_bytes >= compaction_min_garbage_bytes &&
+           table.garbage_bytes >= static_cast<std::uintmax_t>(table.end_offset * compaction_garbage_ratio);
+}
+
+void Database::startCompaction() {
+    if (compaction_thread.joinable()) {
+        return;
+    }
+    compaction_stopping = false;
+    compaction_thread = std::thread(&Database::compactionLoop, this);
+}
+
+void Database::stopCompaction() {
+    {
+        std::lock_guard<std::mutex> lock(compaction_mutex);
+        compaction_stopping = true;
+    }
+    compaction_cv.notify_all();
+    if (compaction_thread.joinable()) {
+        compaction_thread.join();
+    }
+}
+
+void Database::compactionLoop() {
+    std::unique_lock<std::mutex> lock(compaction_mutex);
+    while (!compaction_stopping) {
+        compaction_cv.wait_for(lock, std::chrono::seconds(5));
+        if (compaction_stopping) {
+            break;
+        }
+        lock.unlock();
+        
+        for (Table* table : allTables()) {
+            bool due;
+            {
+                std::unique_lock<std::shared_mutex> table_lock(table->mutex);
+                
+                // The index does not cover a bulk load until it is finished
+                if (table->bulk_loading) {
+                    continue;
+                }
+                due = needsCompaction(*table);
+                
+                // Move rows that aged out of the hot window back to disk only
+                if (table->tiered) {
+                    demoteHotRows(*table);
+                }
+            }
+            if (due && !compaction_stopping) {
+                compactTable(*table);
+            } else {
+                // Checkpoint the index so a restart after a crash only
+                // rescans what was appended since
+                checkpointTableIndex(*table);
+            }
+        }
+        
+        lock.lock();
+    }
+}
+
+// Rewrites a table without its dead rows. The bulk copy runs against a
+// snapshot with no lock held and is throttled to the I/O budget; only the
+// rows appended meanwhile are copied under the lock before the swap.
+bool Database::compactTable(Table& table) {
+    std::vector<std::pair<std::uintmax_t, std::uintmax_t>> dead; // (offset, length)
+    std::uintmax_t snapshot_end;
+    std::ifstream source;
+    {
+        std::shared_lock<std::shared_mutex> lock(table.mutex);
+        source.open(table.file, std::ios::binary);
+        if (!source.is_open()) {
+            return false;
+        }
+        snapshot_end = table.end_offset;
+        dead.assign(table.dead_rows.begin(), table.dead_rows.end());
+    }
+    std::sort(dead.begin(), dead.end());
+    
+    {
+        std::lock_guard<std::mutex> lock(compaction_stats_mutex);
+        compaction_stats.in_progress = true;
+        compaction_stats.current_file = table.file;
+        compaction_stats.progress = 0.0;
+    }
+    
+    std::string temp_path = table.file + ".compact";
+    std::ofstream target(temp_path, std::ios::binary | std::ios::trunc);
+    
+    std::vector<char> buffer(64 * 1024);
+    std::uintmax_t throttled_bytes = 0;
+    auto started = std::chrono::steady_clock::now();
+    
+    auto copyRange = [&](std::uintmax_t from, std::uintmax_t to, bool throttled) -> bool {
+        source.clear();
+        source.seekg(static_cast<std::streamoff>(from));
+        while (from < to) {
+            if (throttled && compaction_stopping) {
+                return false;
+            }
+            size_t chunk = static_cast<size_t>(std::min<std::uintmax_t>(buffer.size(), to - from));
+            source.read(buffer.data(), static_cast<std::streamsize>(chunk));
+            if (static_cast<size_t>(source.gcount()) != chunk) {
+                return false;
+            }
+            target.write(buffer.data(), static_cast<std::streamsize>(chunk));
+            from += chunk;
+            
+            if (throttled) {
+                throttled_bytes += chunk;
+                auto allowed = std::chrono::duration<double>(
+                    static_cast<double>(throttled_bytes) / compaction_io_budget);
+                auto elapsed = std::chrono::steady_clock::now() - started;
+                if (allowed > elapsed) {
+                    std::this_thread::sleep_for(allowed - elapsed);
+                }
+                
+                std::lock_guard<std::mutex> lock(compaction_stats_mutex);
+                compaction_stats.progress = snapshot_end > 0 ? static_cast<double>(from) / snapshot_end : 1.0;
+            }
+        }
+        return true;
+    };
+    
+    auto abandon = [&]() {
+        target.close();
+        std::error_code ec;
+        std::filesystem::remove(temp_path, ec);
+        std::lock_guard<std::mutex> lock(compaction_stats_mutex);
+        compaction_stats.in_progress = false;
+        return false;
+    };
+    
+    if (!target.is_open()) {
+        return abandon();
+    }
+    
+    // Copy the live byte ranges between dead rows
+    std::uintmax_t cursor = 0;
+    for (const auto& range : dead) {
+        if (!copyRange(cursor, range.first, true)) {
+            return abandon();
+        }
+        cursor = range.first + range.second;
+    }
+    if (!copyRange(cursor, snapshot_end, true)) {
+        return abandon();
+    }
+    
+    // removed_before[k] = bytes dropped ahead of the k-th dead range
+    std::vector<std::uintmax_t> removed_before(dead.size() + 1, 0);
+    for (size_t k = 0; k < dead.size(); ++k) {
+        removed_before[k + 1] = removed_before[k] + dead[k].second;
+    }
+    auto relocate = [&](std::uintmax_t offset) {
+        if (offset >= snapshot_end) {
+            return offset - removed_before.back();
+        }
+        auto it = std::lower_bound(dead.begin(), dead.end(), std::make_pair(offset, std::uintmax_t(0)));
+        return offset - removed_before[it - dead.begin()];
+    };
+    auto droppedBySnapshot = [&](std::uintmax_t offset) {
+        auto it = std::lower_bound(dead.begin(), dead.end(), std::make_pair(offset, std::uintmax_t(0)));
+        return it != dead.end() && it->first == offset;
+    };
+    
+    std::uintmax_t reclaimed = removed_before.back();
+    {
+        std::unique_lock<std::shared_mutex> lock(table.mutex);
+        
+        // Rows appended while we were copying are carried over verbatim.
+        // Where the swap needs the old file closed, readers still holding it
+        // are given time to finish, with the lock released so writers and
+        // new readers are not held up meanwhile
+        std::uintmax_t copied_end = snapshot_end;
+        for (int waits = 0;; ++waits) {
+            if (!copyRange(copied_end, table.end_offset, false)) {
+                return abandon();
+            }
+            copied_end = table.end_offset;
+            if (!SWAP_NEEDS_CLOSED_FILE || table.open_snapshots == 0) {
+                break;
+            }
+            if (waits == MAX_SWAP_WAITS) {
+                std::cout << "[ERROR] " << table.file << " is still open for reading, compaction postponed" << std::endl;
+                return abandon();
+            }
+            lock.unlock();
+            std::this_thread::sleep_for(SWAP_WAIT);
+            lock.lock();
+        }
+        target.close();
+        if (target.fail()) {
+            return abandon();
+        }
+        
+        // Nothing may hold the old file across the swap: our own copy
+        // source and the append handle are closed first
+        source.close();
+        files.reopen(table.file);
+        
+        // The old index describes the old file; drop it before the swap
+        std::error_code ec;
+        std::filesystem::remove(table.file + ".idx", ec);
+        std::filesystem::rename(temp_path, table.file, ec);
+        if (ec) {
+            std::cerr << "Error replacing " << table.file << ": " << ec.message() << std::endl;
+            return abandon();
+        }
+        
+        for (auto& entry : table.live_rows) {
+            entry.second.offset = relocate(entry.second.offset);
+        }
+        
+        // The hot tier is keyed by offset as well; relocation keeps the order
+        if (table.tiered) {
+            std::map<std::uintmax_t, HotRow> hot_rows;
+            for (auto& entry : table.hot_rows) {
+                hot_rows.emplace_hint(hot_rows.end(), relocate(entry.first), std::move(entry.second));
+            }
+            table.hot_rows.swap(hot_rows);
+            for (auto& account : table.hot_by_account) {
+                std::set<std::uintmax_t> offsets;
+                for (std::uintmax_t offset : account.second) {
+                    offsets.insert(offsets.end(), relocate(offset));
+                }
+                account.second.swap(offsets);
+            }
+            std::set<std::pair<std::time_t, std::uintmax_t>> hot_by_time;
+            for (const auto& entry : table.hot_by_time) {
+                hot_by_time.emplace(entry.first, relocate(entry.second));
+            }
+            table.hot_by_time.swap(hot_by_time);
         }
         
-        User user;
-        if (user.fromCsvRow(line)) {
-            users.push_back(user);
+        // Rows that died during the copy are still in the new file
+        std::unordered_map<std::uintmax_t, std::uintmax_t> remaining_dead;
+        std::uintmax_t remaining_garbage = 0;
+        for (const auto& entry : table.dead_rows) {
+            if (entry.first < snapshot_end && droppedBySnapshot(entry.first)) {
+                continue;
+            }
+            remaining_dead[relocate(entry.first)] = entry.second;
+            remaining_garbage += entry.second;
         }
+        table.dead_rows.swap(remaining_dead);
+        table.garbage_bytes = remaining_garbage;
+        table.end_offset -= reclaimed;
+        table.generation = newGeneration();
+        table.indexed_offset = 0;
+        commit_lsn++;
+    }
+    // The new file's index is written without holding up writers
+    checkpointTableIndex(table);
+    
+    {
+        std::lock_guard<std::mutex> lock(compaction_stats_mutex);
+        compaction_stats.runs++;
+        compaction_stats.bytes_reclaimed += reclaimed;
+        compaction_stats.in_progress = false;
+        compaction_stats.progress = 1.0;
     }
     
-    file.close();
-    return users;
+    logOperation("COMPACTION", table.file + " compacted, reclaimed " + std::to_string(reclaimed) + " bytes");
+    return true;
 }
 
-std::vector<Account> Database::getAllAccounts() {
-    std::lock_guard<std::mutex> lock(accounts_mutex);
-    std::vector<Account> accounts;
-    
-    std::ifstream file(accounts_file);
-    if (!file.is_open()) {
-        return accounts;
+// Bulk import
+bool Database::bulkAppendTransactions(size_t shard, const std::string& rows) {
+    if (shard >= transaction_shards.size() || read_only) {
+        return false;
     }
-    
-    std::string line;
-    while (std::getline(file, line)) {
-        if (line.empty() || line.find("account_number,") == 0) {
-            continue;
-        }
-        
-        Account account;
-        if (account.fromCsvRow(line)) {
-            accounts.push_back(account);
-        }
+    Table& table = *transaction_shards[shard];
+    std::unique_lock<std::shared_mutex> lock(table.mutex);
+    
+    if (!table.bulk_loading) {
+        // Without an index a restart after a crash rescans the whole file,
+        // which picks up whatever part of the import made it to disk
+        std::error_code ec;
+        std::filesystem::remove(table.file + ".idx", ec);
+        table.indexed_offset = 0;
+        table.bulk_loading = true;
     }
     
-    file.close();
-    return accounts;
+    if (!files.append(table.file, rows) || !files.commit(table.file)) {
+        return false;
+    }
+    // Later appends still need the right offsets
+    table.end_offset += rows.size();
+    return true;
 }
 
-std::vector<Account> Database::getAccountsByCustomerId(const std::string& customer_id) {
-    std::lock_guard<std::mutex> lock(accounts_mutex);
-    std::vector<Account> accounts;
+bool Database::finishBulkImport() {
+    std::vector<Table*> loaded;
+    for (auto& shard : transaction_shards) {
+        std::shared_lock<std::shared_mutex> lock(shard->mutex);
+        if (shard->bulk_loading) {
+            loaded.push_back(shard.get());
+        }
+    }
     
-    std::ifstream file(accounts_file);
-    if (!file.is_open()) {
-        return accounts;
+    std::unique_ptr<TaskPool> own_pool;
+    TaskPool* pool = task_pool;
+    if (!pool && !loaded.empty()) {
+        own_pool = std::make_unique<TaskPool>(loaded.size());
+        pool = own_pool.get();
     }
     
-    std::string line;
-    while (std::getline(file, line)) {
-        if (line.empty() || line.find("account_number,") == 0) {
-            continue;
-        }
-        
-        Account account;
-        if (account.fromCsvRow(line) && account.getCustomerId() == customer_id) {
-            accounts.push_back(account);
-        }
+    // Every shard is one sequential scan; they are independent files
+    std::vector<std::future<bool>> builders;
+    for (Table* table : loaded) {
+        auto built = std::make_shared<std::promise<bool>>();
+        builders.push_back(built->get_future());
+        pool->submit([this, table, built]() {
+            std::unique_lock<std::shared_mutex> lock(table->mutex);
+            bool indexed = loadTableState(*table) && saveTableIndex(*table) &&
+                           (!table->tiered || loadHotTier(*table));
+            if (indexed) {
+                table->bulk_loading = false;
+            }
+            built->set_value(indexed);
+        });
+    }
+    bool ok = true;
+    for (auto& builder : builders) {
+        ok = builder.get() && ok;
     }
+    commit_lsn++;
     
-    file.close();
-    return accounts;
+    logOperation("BULK_IMPORT", "Indexed " + std::to_string(loaded.size()) + " transaction shards");
+    return ok;
 }
 
-bool Database::updateAccount(const Account& account) {
-    std::lock_guard<std::mutex> lock(accounts_mutex);
-    
-    std::vector<std::string> lines;
-    std::ifstream file(accounts_file);
-    if (!file.is_open()) {
-        return false;
+void Database::setTaskPool(TaskPool* pool) {
+    task_pool = pool;
+}
+
+// Tiering
+void Database::setTieringPolicy(std::time_t window_seconds, std::uintmax_t max_bytes) {
+    hot_window_seconds = window_seconds;
+    hot_max_bytes = max_bytes;
+}
+
+TieringStats Database::getTieringStats() {
+    TieringStats stats;
+    for (auto& shard : transaction_shards) {
+        std::shared_lock<std::shared_mutex> lock(shard->mutex);
+        stats.hot_rows += shard->hot_rows.size();
+        stats.hot_bytes += shard->hot_bytes;
     }
-    
-    std::string line;
-    bool updated = false;
-    
-    while (std::getline(file, line)) {
-        if (line.empty() || line.find("account_number,") == 0) {
-            lines.push_back(line);
-            continue;
-        }
-        
-        std::vector<std::string> tokens;
-        std::stringstream ss(line);
-        std::string token;
-        
-        while (std::getline(ss, token, ',')) {
-            tokens.push_back(token);
-        }
-        
-        if (tokens.size() >= 1 && tokens[0] == account.getAccountNumber()) {
-            lines.push_back(account.toCsvRow());
-            updated = true;
-        } else {
-            lines.push_back(line);
-        }
+    stats.demoted_rows = demoted_rows.load();
+    stats.hot_reads = hot_reads.load();
+    stats.disk_reads = disk_reads.load();
+    return stats;
+}
+
+void Database::addHotRow(Table& table, const RowLocation& location, const std::string& row) {
+    // A zero window disables the hot tier: everything is on disk
+    if (hot_window_seconds <= 0) {
+        table.cold_newest = std::numeric_limits<std::time_t>::max();
+        return;
     }
-    file.close();
     
-    if (!updated) {
-        return false;
+    auto transaction = std::make_shared<Transaction>();
+    if (!transaction->fromCsvRow(row)) {
+        return;
     }
     
-    std::ofstream out_file(accounts_file);
-    if (!out_file.is_open()) {
-        return false;
+    std::time_t time = std::chrono::system_clock::to_time_t(transaction->getTimePoint());
+    if (time < std::time(nullptr) - hot_window_seconds) {
+        table.cold_newest = std::max(table.cold_newest, time);
+        return;
     }
     
-    for (const auto& l : lines) {
-        out_file << l << "\n";
+    HotRow hot;
+    hot.time = time;
+    hot.length = location.length;
+    table.hot_by_account[transaction->getFromAccountId()].insert(location.offset);
+    table.hot_by_account[transaction->getToAccountId()].insert(location.offset);
+    table.hot_by_time.emplace(time, location.offset);
+    hot.transaction = std::move(transaction);
+    table.hot_rows[location.offset] = std::move(hot);
+    table.hot_bytes += location.length;
+}
+
+void Database::removeHotRow(Table& table, std::uintmax_t offset) {
+    auto it = table.hot_rows.find(offset);
+    if (it == table.hot_rows.end()) {
+        return;
     }
-    out_file.close();
     
-    logOperation("UPDATE_ACCOUNT", "Updated account: " + account.getAccountNumber());
-    return true;
+    for (const std::string& account : {it->second.transaction->getFromAccountId(),
+                                       it->second.transaction->getToAccountId()}) {
+        auto entry = table.hot_by_account.find(account);
+        if (entry != table.hot_by_account.end()) {
+            entry->second.erase(offset);
+            if (entry->second.empty()) {
+                table.hot_by_account.erase(entry);
+            }
+        }
+    }
+    table.hot_by_time.erase(std::make_pair(it->second.time, offset));
+    table.hot_bytes -= it->second.length;
+    table.hot_rows.erase(it);
 }
 
-bool Database::deleteAccount(const std::string& account_number) {
-    std::lock_guard<std::mutex> lock(accounts_mutex);
-    
-    std::vector<std::string> lines;
-    std::ifstream file(accounts_file);
+// Drops rows that aged out of the window, and the oldest ones while over
+// the byte budget; they stay available from the file
+void Database::demoteHotRows(Table& table) {
+    std::time_t cutoff = std::time(nullptr) - hot_window_seconds;
+    
+    while (!table.hot_by_time.empty()) {
+        auto oldest = *table.hot_by_time.begin();
+        if (oldest.first >= cutoff && table.hot_bytes <= hot_max_bytes) {
+            break;
+        }
+        table.cold_newest = std::max(table.cold_newest, oldest.first);
+        removeHotRow(table, oldest.second);
+        demoted_rows++;
+    }
+}
+
+// Fills the hot tier from the file at startup, demoting as it goes so
+// memory never exceeds the budget
+bool Database::loadHotTier(Table& table) {
+    table.hot_rows.clear();
+    table.hot_by_account.clear();
+    table.hot_by_time.clear();
+    table.hot_bytes = 0;
+    table.cold_newest = 0;
+    
+    std::ifstream file(table.file, std::ios::binary);
     if (!file.is_open()) {
         return false;
     }
     
-    std::string line;
-    bool deleted = false;
+    // Timestamps are fixed-width local time, so text order is time order
+    // and rows outside the window are classified without being parsed
+    std::time_t cutoff = std::time(nullptr) - hot_window_seconds;
+    std::ostringstream cutoff_text;
+    std::tm local_tm = {};
+    toLocalTime(cutoff, local_tm);
+    cutoff_text << std::put_time(&local_tm, "%Y-%m-%d %H:%M:%S");
+    std::string newest_cold;
     
-    while (std::getline(file, line)) {
-        if (line.empty() || line.find("account_number,") == 0) {
-            lines.push_back(line);
+    std::string line;
+    std::uintmax_t offset = 0;
+    while (offset < table.end_offset && std::getline(file, line)) {
+        RowLocation location{offset, line.size() + 1};
+        offset += location.length;
+        
+        if (location.offset == 0 || table.dead_rows.count(location.offset) > 0) {
             continue;
         }
-        
-        std::vector<std::string> tokens;
-        std::stringstream ss(line);
-        std::string token;
-        
-        while (std::getline(ss, token, ',')) {
-            tokens.push_back(token);
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
         }
         
-        if (tokens.size() >= 1 && tokens[0] == account_number) {
-            deleted = true;
-            // Don't add this line (effectively deleting it)
-        } else {
-            lines.push_back(line);
+        std::string timestamp = timestampField(line);
+        if (hot_window_seconds > 0 && timestamp < cutoff_text.str()) {
+            newest_cold = std::max(newest_cold, timestamp);
+            continue;
+        }
+        addHotRow(table, location, line);
+        if (table.hot_bytes > hot_max_bytes) {
+            demoteHotRows(table);
         }
-    }
-    file.close();
-    
-    if (!deleted) {
-        return false;
     }
     
-    std::ofstream out_file(accounts_file);
-    if (!out_file.is_open()) {
-        return false;
+    if (!newest_cold.empty()) {
+        std::tm tm = {};
+        std::istringstream in(newest_cold);
+        in >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
+        tm.tm_isdst = -1;
+        
+        // An unreadable timestamp could be anything; keep the file in play
+        std::time_t newest = in.fail() ? std::numeric_limits<std::time_t>::max() : std::mktime(&tm);
+        table.cold_newest = std::max(table.cold_newest, newest);
     }
-    
-    for (const auto& l : lines) {
-        out_file << l << "\n";
+    std::cout << "[DEBUG] " << table.file << ": " << table.hot_rows.size() << " rows in memory" << std::endl;
+    return true;
+}
+
+// Replication
+void Database::setLogShipper(LogShipper* shipper) {
+    log_shipper = shipper;
+}
+
+bool Database::forEachLiveRow(const std::function<void(const std::string& table, size_t shard,
+                                                       const std::string& key, const std::string& row)>& visitor) {
+    for (Table* table : allTables()) {
+        std::string header;
+        bool ok = scanLiveRows(table->name, table->shard, header, [&](const std::string& row) {
+            visitor(table->name, table->shard, rowKey(row), row);
+            return true;
+        });
+        if (!ok) {
+            return false;
+        }
     }
-    out_file.close();
-    
-    logOperation("DELETE_ACCOUNT", "Deleted account: " + account_number);
     return true;
 }
 
-bool Database::updateTransaction(const Transaction& transaction) {
-    std::lock_guard<std::mutex> lock(transactions_mutex);
-    
-    std::vector<std::string> lines;
-    std::ifstream file(transactions_file);
-    if (!file.is_open()) {
+bool Database::applyReplicatedRows(const std::string& table_name, size_t shard,
+                                   const std::vector<ReplicatedRow>& rows) {
+    Table* table = findTable(table_name, shard);
+    if (!table) {
         return false;
     }
     
-    std::string line;
-    bool updated = false;
+    std::unique_lock<std::shared_mutex> lock(table->mutex);
     
-    while (std::getline(file, line)) {
-        if (line.empty() || line.find("transaction_id,") == 0) {
-            lines.push_back(line);
+    // Rows may arrive twice around a resync, so a delete of a missing key
+    // is simply skipped and a repeated version just supersedes itself
+    std::vector<RowWrite> writes;
+    writes.reserve(rows.size());
+    for (const auto& row : rows) {
+        if (row.tombstone && table->live_rows.count(row.key) == 0) {
             continue;
         }
-        
-        std::vector<std::string> tokens;
-        std::stringstream ss(line);
-        std::string token;
-        
-        while (std::getline(ss, token, ',')) {
-            tokens.push_back(token);
+        writes.push_back({row.key, row.row, row.tombstone});
+    }
+    return appendRows(*table, writes);
+}
+
+// A resync is written to "<file>.snapshot" beside every data file and only
+// replaces the data once it is complete, so a standby that loses its
+// primary halfway still has its last complete copy
+bool Database::beginReplicationSnapshot() {
+    for (Table* table : allTables()) {
+        std::string header;
+        {
+            std::shared_lock<std::shared_mutex> lock(table->mutex);
+            std::ifstream in(table->file, std::ios::binary);
+            std::getline(in, header);
         }
         
-        if (tokens.size() >= 1 && tokens[0] == transaction.getTransactionId()) {
-            lines.push_back(transaction.toCsvRow());
-            updated = true;
-        } else {
-            lines.push_back(line);
+        std::ofstream out(table->file + ".snapshot", std::ios::binary | std::ios::trunc);
+        out << header << "\n";
+        if (!out) {
+            abortReplicationSnapshot();
+            return false;
         }
     }
-    file.close();
-    
-    if (!updated) {
-        return false;
-    }
-    
-    std::ofstream out_file(transactions_file);
-    if (!out_file.is_open()) {
+    return true;
+}
+
+bool Database::stageReplicatedRows(const std::string& table_name, size_t shard,
+                                   const std::vector<ReplicatedRow>& rows) {
+    Table* table = findTable(table_name, shard);
+    if (!table) {
         return false;
     }
     
-    for (const auto& l : lines) {
-        out_file << l << "\n";
+    std::string data;
+    for (const auto& row : rows) {
+        data += row.tombstone ? row.key + "," + TOMBSTONE_MARKER : row.row;
+        data += "\n";
     }
-    out_file.close();
-    
-    logOperation("UPDATE_TRANSACTION", "Updated transaction: " + transaction.getTransactionId());
-    return true;
+    std::ofstream out(table->file + ".snapshot", std::ios::binary | std::ios::app);
+    out << data;
+    return static_cast<bool>(out);
 }
 
-std::vector<Transaction> Database::getAllTransactions() {
-    std::lock_guard<std::mutex> lock(transactions_mutex);
-    std::vector<Transaction> transactions;
+bool Database::finishReplicationSnapshot() {
+    // Every table switches over or none does, in address order like other
+    // multi-table writers. The live files are moved aside before any
+    // snapshot takes their place, so a failure can put them all back; the
+    // marker file tells a restart that a switch was under way
+    std::vector<Table*> tables = allTables();
+    std::sort(tables.begin(), tables.end());
+    std::vector<std::unique_lock<std::shared_mutex>> locks;
+    for (Table* table : tables) {
+        locks.emplace_back(table->mutex);
+    }
     
-    std::ifstream file(transactions_file);
-    if (!file.is_open()) {
-        return transactions;
+    for (Table* table : tables) {
+        std::error_code ec;
+        if (!std::filesystem::is_regular_file(table->file + ".snapshot", ec)) {
+            std::cout << "[ERROR] No staged snapshot of " << table->file << std::endl;
+            return false;
+        }
     }
     
-    std::string line;
-    while (std::getline(file, line)) {
-        if (line.empty() || line.find("transaction_id,") == 0) {
-            continue;
+    // No new reader gets in while the locks are held; the open ones finish
+    for (int waits = 0; SWAP_NEEDS_CLOSED_FILE; ++waits) {
+        bool open = false;
+        for (Table* table : tables) {
+            open = open || table->open_snapshots > 0;
         }
-        
-        Transaction transaction;
-        if (transaction.fromCsvRow(line)) {
-            transactions.push_back(transaction);
+        if (!open) {
+            break;
+        }
+        if (waits == MAX_SWAP_WAITS) {
+            std::cout << "[ERROR] Data files are still open for reading, snapshot not swapped in" << std::endl;
+            return false;
         }
+        std::this_thread::sleep_for(SWAP_WAIT);
     }
     
-    file.close();
-    return transactions;
-}
-
-std::vector<Transaction> Database::getTransactionsByDateRange(
-    const std::string& start_date, const std::string& end_date) {
-    std::lock_guard<std::mutex> lock(transactions_mutex);
-    std::vector<Transaction> transactions;
-    
-    std::ifstream file(transactions_file);
-    if (!file.is_open()) {
-        return transactions;
+    std::ofstream marker(snapshotSwitchMarker(), std::ios::trunc);
+    marker << "snapshot switch in progress\n";
+    marker.close();
+    if (marker.fail()) {
+        std::cout << "[ERROR] Failed to write " << snapshotSwitchMarker() << std::endl;
+        return false;
     }
     
-    std::string line;
-    while (std::getline(file, line)) {
-        if (line.empty() || line.find("transaction_id,") == 0) {
-            continue;
+    std::vector<Table*> moved; // Live file now at <file>.previous
+    auto reload = [&]() {
+        bool loaded = true;
+        for (Table* table : tables) {
+            table->indexed_offset = 0;
+            if (!loadTableState(*table) || (table->tiered && !loadHotTier(*table))) {
+                std::cout << "[ERROR] Failed to load " << table->file << std::endl;
+                loaded = false;
+            }
         }
-        
-        Transaction transaction;
-        if (transaction.fromCsvRow(line)) {
-            std::string tx_date = transaction.getTimestamp().substr(0, 10); // Extract YYYY-MM-DD
-            if (tx_date >= start_date && tx_date <= end_date) {
-                transactions.push_back(transaction);
+        return loaded;
+    };
+    auto undo = [&]() {
+        std::error_code ec;
+        for (Table* table : moved) {
+            std::filesystem::rename(table->file + ".previous", table->file, ec);
+            if (ec) {
+                std::cout << "[ERROR] Failed to restore " << table->file << ": " << ec.message() << std::endl;
+                return false; // The marker stays, so the next start restores it
             }
         }
-    }
-    
-    file.close();
-    return transactions;
-}
-
-bool Database::backup() {
-    std::string backup_dir = data_directory + "/backups/" + getCurrentTimestamp();
-    
-    if (!ensureDirectoryExists(backup_dir)) {
+        std::filesystem::remove(snapshotSwitchMarker(), ec);
+        reload();
         return false;
-    }
-    
-    // Copy all data files to backup directory
-    std::vector<std::string> files_to_backup = {
-        users_file,
-        accounts_file,
-        transactions_file
     };
     
-    for (const auto& file : files_to_backup) {
-        std::ifstream src(file, std::ios::binary);
-        if (!src.is_open()) continue;
+    for (Table* table : tables) {
+        files.commit(table->file);
+        files.reopen(table->file);
         
-        std::string filename = file.substr(file.find_last_of("/\\") + 1);
-        std::ofstream dst(backup_dir + "/" + filename, std::ios::binary);
-        if (dst.is_open()) {
-            dst << src.rdbuf();
-            dst.close();
+        // Indexes describe the old files; without one the state is rebuilt
+        // from the whole file
+        std::error_code ec;
+        std::filesystem::remove(table->file + ".idx", ec);
+        std::filesystem::rename(table->file, table->file + ".previous", ec);
+        if (ec) {
+            std::cout << "[ERROR] Failed to move " << table->file << " aside: " << ec.message() << std::endl;
+            return undo();
         }
-        src.close();
+        moved.push_back(table);
     }
-    
-    logOperation("BACKUP", "System backup created: " + backup_dir);
-    return true;
-}
-
-bool Database::restore(const std::string& backup_path) {
-    // Implementation for restore functionality
-    logOperation("RESTORE", "Restore attempted from: " + backup_path);
-    return true; // Simplified implementation
-}
-
-bool Database::validateDataIntegrity() {
-    // Check file existence and format
-    std::vector<std::string> files = {users_file, accounts_file, transactions_file};
-    
-    for (const auto& file : files) {
-        std::ifstream f(file);
-        if (!f.is_open()) {
-            logOperation("INTEGRITY_CHECK", "Failed to open file: " + file);
-            return false;
+    for (Table* table : tables) {
+        std::error_code ec;
+        std::filesystem::rename(table->file + ".snapshot", table->file, ec);
+        if (ec) {
+            std::cout << "[ERROR] Failed to swap in the snapshot of " << table->file << ": " << ec.message() << std::endl;
+            return undo();
         }
-        f.close();
+    }
+    if (!reload()) {
+        return undo();
     }
     
-    logOperation("INTEGRITY_CHECK", "Data integrity validation passed");
+    // Removing the marker commits the switch; the old files are then garbage
+    std::error_code ec;
+    std::filesystem::remove(snapshotSwitchMarker(), ec);
+    if (ec) {
+        return undo();
+    }
+    for (Table* table : tables) {
+        std::filesystem::remove(table->file + ".previous", ec);
+    }
+    commit_lsn++;
+    
+    logOperation("REPLICATION", "Data replaced by a snapshot from the primary");
     return true;
 }
 
-void Database::cleanup() {
-    // Clean up old log files and temporary data
-    logOperation("CLEANUP", "Database cleanup completed");
-}
-
-size_t Database::getUserCount() {
-    return getAllUsers().size();
-}
-
-size_t Database::getAccountCount() {
-    return getAllAccounts().size();
+std::string Database::snapshotSwitchMarker() const {
+    return data_directory + "/snapshot.switch";
 }
 
-double Database::getTotalSystemBalance() {
-    double total = 0.0;
-    auto accounts = getAllAccounts();
-    for (const auto& account : accounts) {
-        if (account.isActive()) {
-            total += account.getBalance();
+bool Database::recoverSnapshotSwitch() {
+    std::error_code ec;
+    bool interrupted = std::filesystem::exists(snapshotSwitchMarker(), ec);
+    
+    // Shard layouts vary, so the leftovers are found by name
+    std::vector<std::filesystem::path> previous;
+    for (auto it = std::filesystem::recursive_directory_iterator(data_directory, ec);
+         !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        if (it->is_regular_file() && it->path().extension() == ".previous") {
+            previous.push_back(it->path());
         }
     }
-    return total;
-}
-
-size_t Database::getTransactionCount() {
-    return getAllTransactions().size();
-}
-
-bool Database::loadUserInternal(const std::string& user_id, User& user) {
-    // Internal version of loadUser that doesn't use mutex (assumes caller already has it)
-    std::cout << "loadUserInternal called for: " << user_id << std::endl;
-    
-    std::cout << "Opening users file: " << users_file << std::endl;
-    std::ifstream file(users_file);
-    if (!file.is_open()) {
-        std::cout << "Users file doesn't exist or can't be opened" << std::endl;
+    if (ec) {
+        std::cout << "[ERROR] Failed to look for an interrupted snapshot switch: " << ec.message() << std::endl;
         return false;
     }
-    std::cout << "Users file opened successfully" << std::endl;
-    
-    std::string line;
-    std::cout << "Reading header line..." << std::endl;
-    std::getline(file, line); // Skip header
-    std::cout << "Header: " << line << std::endl;
     
-    std::cout << "Searching for user..." << std::endl;
-    while (std::getline(file, line)) {
-        if (line.empty()) continue;
-        std::cout << "Checking line: " << line << std::endl;
-        
-        std::istringstream ss(line);
-        std::string item;
-        std::vector<std::string> tokens;
-        
-        while (std::getline(ss, item, ',')) {
-            tokens.push_back(item);
+    for (const auto& path : previous) {
+        std::filesystem::path live = path;
+        live.replace_extension();
+        if (interrupted) {
+            std::filesystem::remove(live.string() + ".idx", ec);
+            std::filesystem::rename(path, live, ec);
+            if (ec) {
+                std::cout << "[ERROR] Failed to restore " << live.string() << ": " << ec.message() << std::endl;
+                return false;
+            }
+        } else {
+            std::filesystem::remove(path, ec);
         }
-        
-        if (tokens.size() >= 11 && tokens[0] == user_id) {
-            std::cout << "User found! Loading from CSV..." << std::endl;
-            // Create user from CSV data
-            user = User();
-            user.fromCsvRow(line);
-            file.close();
-            std::cout << "User loaded successfully" << std::endl;
-            return true;
+    }
+    if (interrupted) {
+        std::cout << "[WARNING] An interrupted snapshot switch was undone; keeping the previous data" << std::endl;
+        std::filesystem::remove(snapshotSwitchMarker(), ec);
+        if (ec) {
+            return false;
         }
     }
-    
-    file.close();
-    std::cout << "User not found in file" << std::endl;
-    return false;
+    return true;
+}
+
+void Database::abortReplicationSnapshot() {
+    for (Table* table : allTables()) {
+        std::error_code ec;
+        std::filesystem::remove(table->file + ".snapshot", ec);
+    }
 }
@@ -0,0 +1,190 @@
+#include "../include/core/FileHandleManager.h"
+#include <iostream>
+#include <vector>
+#include <filesystem>
+
+FileHandleManager::FileHandleManager(const FlushPolicy& policy)
+    : default_policy(policy), stopping(false) {
+    flusher_thread = std::thread(&FileHandleManager::flusherLoop, this);
+}
+
+FileHandleManager::~FileHandleManager() {
+    {
+        std::lock_guard<std::mutex> lock(flusher_mutex);
+        stopping = true;
+    }
+    flusher_cv.notify_all();
+    if (flusher_thread.joinable()) {
+        flusher_thread.join();
+    }
+    closeAll();
+}
+
+FileHandleManager::Writer& FileHandleManager::getWriter(const std::string& path) {
+    std::lock_guard<std::mutex> lock(writers_mutex);
+    auto it = writers.find(path);
+    if (it == writers.end()) {
+        auto writer = std::make_unique<Writer>();
+        writer->policy = default_policy;
+        it = writers.emplace(path, std::move(writer)).first;
+    }
+    return *it->second;
+}
+
+void FileHandleManager::setPolicy(const std::string& path, const FlushPolicy& policy) {
+    Writer& writer = getWriter(path);
+    std::lock_guard<std::mutex> lock(writer.mutex);
+    writer.policy = policy;
+}
+
+bool FileHandleManager::openWriter(const std::string& path, Writer& writer) {
+    writer.stream.open(path, std::ios::app | std::ios::binary);
+    if (!writer.stream.is_open()) {
+        std::cerr << "Failed to open " << path << " for appending" << std::endl;
+        return false;
+    }
+    std::error_code ec;
+    writer.written_bytes = std::filesystem::file_size(path, ec);
+    if (ec) {
+        writer.written_bytes = 0;
+    }
+    open_count++;
+    return true;
+}
+
+bool FileHandleManager::flushWriter(const std::string& path, Writer& writer) {
+    if (writer.pending.empty()) {
+        return true;
+    }
+
+    // Detect rotation: the file vanished or shrank underneath our handle
+    if (writer.stream.is_open()) {
+        std::error_code ec;
+        auto size = std::filesystem::file_size(path, ec);
+        if (ec || size < writer.written_bytes) {
+            writer.stream.close();
+        }
+    }
+
+    if (!writer.stream.is_open() && !openWriter(path, writer)) {
+        return false;
+    }
+
+    writer.stream.write(writer.pending.data(), static_cast<std::streamsize>(writer.pending.size()));
+    writer.stream.flush();
+    flush_count++;
+
+    if (writer.stream.fail()) {
+        // Drop the data and cut off whatever part of it reached the file, so
+        // a failed write never shows up ahead of the next one; the next
+        // append opens a fresh descriptor
+        writer.stream.close();
+        writer.stream.clear();
+        writer.pending.clear();
+        std::error_code ec;
+        std::filesystem::resize_file(path, writer.written_bytes, ec);
+        if (ec) {
+            std::cerr << "Failed to truncate " << path << " after a failed write: " << ec.message() << std::endl;
+        }
+        return false;
+    }
+
+    writer.written_bytes += writer.pending.size();
+    writer.pending.clear();
+    return true;
+}
+
+bool FileHandleManager::append(const std::string& path, const std::string& data) {
+    Writer& writer = getWriter(path);
+    std::lock_guard<std::mutex> lock(writer.mutex);
+
+    if (writer.pending.empty()) {
+        writer.oldest_pending = std::chrono::steady_clock::now();
+    }
+    writer.pending += data;
+
+    if (writer.pending.size() >= writer.policy.max_buffered_bytes) {
+        return flushWriter(path, writer);
+    }
+    return true;
+}
+
+bool FileHandleManager::commit(const std::string& path) {
+    Writer& writer = getWriter(path);
+    std::lock_guard<std::mutex> lock(writer.mutex);
+    return flushWriter(path, writer);
+}
+
+void FileHandleManager::commitAll() {
+    std::vector<std::pair<std::string, Writer*>> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(writers_mutex);
+        for (auto& entry : writers) {
+            snapshot.emplace_back(entry.first, entry.second.get());
+        }
+    }
+
+    for (auto& entry : snapshot) {
+        std::lock_guard<std::mutex> lock(entry.second->mutex);
+        flushWriter(entry.first, *entry.second);
+    }
+}
+
+void FileHandleManager::reopen(const std::string& path) {
+    Writer& writer = getWriter(path);
+    std::lock_guard<std::mutex> lock(writer.mutex);
+    flushWriter(path, writer);
+    if (writer.stream.is_open()) {
+        writer.stream.close();
+    }
+    writer.stream.clear();
+}
+
+void FileHandleManager::closeAll() {
+    std::lock_guard<std::mutex> lock(writers_mutex);
+    for (auto& entry : writers) {
+        std::lock_guard<std::mutex> writer_lock(entry.second->mutex);
+        flushWriter(entry.first, *entry.second);
+        if (entry.second->stream.is_open()) {
+            entry.second->stream.close();
+        }
+    }
+}
+
+void FileHandleManager::flusherLoop() {
+    std::unique_lock<std::mutex> lock(flusher_mutex);
+    while (!stopping) {
+        flusher_cv.wait_for(lock, default_policy.max_delay / 2);
+        if (stopping) {
+            break;
+        }
+        lock.unlock();
+
+        auto now = std::chrono::steady_clock::now();
+        std::vector<std::pair<std::string, Writer*>> snapshot;
+        {
+            std::lock_guard<std::mutex> writers_lock(writers_mutex);
+            for (auto& entry : writers) {
+                snapshot.emplace_back(entry.first, entry.second.get());
+            }
+        }
+
+        for (auto& entry : snapshot) {
+            Writer& writer = *entry.second;
+            std::lock_guard<std::mutex> writer_lock(writer.mutex);
+            if (!writer.pending.empty() && now - writer.oldest_pending >= writer.policy.max_delay) {
+                flushWriter(entry.first, writer);
+            }
+        }
+
+        lock.lock();
+    }
+}
+
+size_t FileHandleManager::getOpenCount() const {
+    return open_count.load();
+}
+
+size_t FileHandleManager::getFlushCount() const {
+    return flush_count.load();
+}
@@ -0,0 +1,182 @@
+#include "../include/core/IdempotencyCache.h"
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+std::string IdempotencyRecord::toCsvRow() const {
+    // The message is the last column and may contain commas, not line breaks
+    std::string safe_message = message;
+    std::replace(safe_message.begin(), safe_message.end(), '\n', ' ');
+    std::replace(safe_message.begin(), safe_message.end(), '\r', ' ');
+
+    std::ostringstream row;
+    row << key << "," << fingerprint << "," << created_at << "," << transaction_id << ","
+        << std::fixed << std::setprecision(2) << new_balance << "," << account_version << "," << safe_message;
+    return row.str();
+}
+
+bool IdempotencyRecord::fromCsvRow(const std::string& csv_row) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    for (int column = 0; column < 6; ++column) {
+        size_t comma = csv_row.find(',', start);
+        if (comma == std::string::npos) {
+            return false;
+        }
+        fields.push_back(csv_row.substr(start, comma - start));
+        start = comma + 1;
+    }
+
+    try {
+        key = fields[0];
+        fingerprint = fields[1];
+        created_at = static_cast<std::time_t>(std::stoll(fields[2]));
+        transaction_id = fields[3];
+        new_balance = std::stod(fields[4]);
+        account_version = std::stoull(fields[5]);
+        message = csv_row.substr(start);
+    } catch (const std::exception&) {
+        return false;
+    }
+    return !key.empty();
+}
+
+IdempotencyCache::IdempotencyCache(size_t capacity, std::time_t ttl_seconds)
+    : capacity(std::max<size_t>(capacity, 1)), ttl_seconds(ttl_seconds) {
+}
+
+void IdempotencyCache::evictLocked(std::time_t now, size_t room) {
+    // Slots queued again since the loop began sit at the back; once only
+    // they are left, everything still queued is in flight
+    size_t requeued = 0;
+    while (expiry_queue.size() > requeued) {
+        auto it = entries.find(expiry_queue.front().second);
+        // Slots of abandoned or re-claimed keys are skipped
+        if (it == entries.end() || it->second.sequence != expiry_queue.front().first) {
+            expiry_queue.pop_front();
+            continue;
+        }
+        if (it->second.record.created_at + ttl_seconds > now && entries.size() + room <= capacity) {
+            break;
+        }
+        // Forgetting a running key would let a retry run the request twice
+        if (!it->second.done) {
+            expiry_queue.push_back(expiry_queue.front());
+            expiry_queue.pop_front();
+            requeued++;
+            continue;
+        }
+        dropped.push_back(it->first);
+        entries.erase(it);
+        expiry_queue.pop_front();
+        evicted++;
+    }
+}
+
+void IdempotencyCache::insertLocked(const std::string& key, Entry entry) {
+    entry.sequence = next_sequence++;
+    expiry_queue.emplace_back(entry.sequence, key);
+    entries[key] = std::move(entry);
+}
+
+IdempotencyClaim IdempotencyCache::claim(const std::string& key, const std::string& fingerprint, std::time_t now,
+                                         IdempotencyRecord& original) {
+    std::lock_guard<std::mutex> lock(mutex);
+    evictLocked(now, 0);
+
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        if (it->second.record.fingerprint != fingerprint) {
+            return IdempotencyClaim::MISMATCH;
+        }
+        if (!it->second.done) {
+            return IdempotencyClaim::IN_PROGRESS;
+        }
+        repeats++;
+        original = it->second.record;
+        return IdempotencyClaim::REPEAT;
+    }
+
+    evictLocked(now, 1);
+    Entry entry;
+    entry.record.key = key;
+    entry.record.fingerprint = fingerprint;
+    entry.record.created_at = now;
+    insertLocked(key, std::move(entry));
+    return IdempotencyClaim::FIRST;
+}
+
+bool IdempotencyCache::claimed(IdempotencyRecord& record) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(record.key);
+    if (it == entries.end() || it->second.done) {
+        return false;
+    }
+    record.fingerprint = it->second.record.fingerprint;
+    record.created_at = it->second.record.created_at;
+    return true;
+}
+
+bool IdempotencyCache::complete(IdempotencyRecord& record, std::vector<std::string>& dropped_keys) {
+    std::lock_guard<std::mutex> lock(mutex);
+    dropped_keys.swap(dropped);
+    dropped.clear();
+
+    auto it = entries.find(record.key);
+    // An entry cleared while its request ran is not brought back
+    if (it == entries.end() || it->second.done) {
+        return false;
+    }
+    record.fingerprint = it->second.record.fingerprint;
+    record.created_at = it->second.record.created_at;
+    it->second.record = record;
+    it->second.done = true;
+    return true;
+}
+
+void IdempotencyCache::abandon(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it != entries.end() && !it->second.done) {
+        entries.erase(it);
+    }
+}
+
+void IdempotencyCache::restore(const IdempotencyRecord& record, std::time_t now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (record.created_at + ttl_seconds <= now) {
+        dropped.push_back(record.key);
+        evicted++;
+        return;
+    }
+    auto it = entries.find(record.key);
+    if (it != entries.end()) {
+        return;
+    }
+    evictLocked(now, 1);
+    Entry entry;
+    entry.done = true;
+    entry.record = record;
+    insertLocked(record.key, std::move(entry));
+}
+
+void IdempotencyCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    expiry_queue.clear();
+    dropped.clear();
+}
+
+std::time_t IdempotencyCache::getTtlSeconds() const {
+    return ttl_seconds;
+}
+
+IdempotencyStats IdempotencyCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    IdempotencyStats stats;
+    stats.keys = entries.size();
+    stats.capacity = capacity;
+    stats.repeats = repeats;
+    stats.evicted = evicted;
+    return stats;
+}
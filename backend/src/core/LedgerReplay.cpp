@@ -0,0 +1,235 @@
+#include "../include/core/LedgerReplay.h"
+#include "../include/models/Account.h"
+#include "../include/models/Transaction.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <memory>
+
+namespace {
+
+int64_t toCents(double amount) {
+    return static_cast<int64_t>(std::llround(amount * 100.0));
+}
+
+// Transaction columns the replay needs, in transactions.csv order
+enum Column {
+    TRANSACTION_ID,
+    FROM_ACCOUNT,
+    TO_ACCOUNT,
+    AMOUNT,
+    TYPE,
+    STATUS,
+    DESCRIPTION,
+    BALANCE_BEFORE,
+    BALANCE_AFTER,
+    COLUMNS_USED
+};
+
+// Splits the leading columns in place. Transaction::fromCsvRow also parses
+// the timestamp, and mktime takes a process-wide lock that would serialize
+// the shard tasks.
+bool splitRow(const std::string& row, std::string (&fields)[COLUMNS_USED]) {
+    size_t start = 0;
+    for (int column = 0; column < COLUMNS_USED; ++column) {
+        size_t comma = row.find(',', start);
+        if (comma == std::string::npos) {
+            return false; // The timestamp and reference columns follow
+        }
+        fields[column].assign(row, start, comma - start);
+        start = comma + 1;
+    }
+    return true;
+}
+
+bool parseCents(const std::string& field, int64_t& cents) {
+    if (field.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    double value = std::strtod(field.c_str(), &end);
+    if (end != field.c_str() + field.size()) {
+        return false;
+    }
+    cents = toCents(value);
+    return true;
+}
+
+} // namespace
+
+LedgerReplay::LedgerReplay(Database& database, TaskPool& pool, size_t partitions)
+    : database(database), pool(pool), partition_count(partitions > 0 ? partitions : pool.size()) {
+}
+
+size_t LedgerReplay::partitionOf(const std::string& account_number) const {
+    return std::hash<std::string>{}(account_number) % partition_count;
+}
+
+void LedgerReplay::replayShard(size_t shard, ShardResult& result) {
+    result.partitions.assign(partition_count, Partition());
+    std::string fields[COLUMNS_USED];
+    std::string header;
+
+    result.ok = database.scanLiveRows("transactions", shard, header, [&](const std::string& row) {
+        int64_t amount = 0;
+        if (!splitRow(row, fields) || !parseCents(fields[AMOUNT], amount) ||
+            (fields[FROM_ACCOUNT].empty() && fields[TO_ACCOUNT].empty())) {
+            result.unreadable++;
+            return true;
+        }
+        // A failed transfer keeps its row but was refunded; only completed
+        // rows moved money
+        if (Transaction::stringToStatus(fields[STATUS]) != TransactionStatus::COMPLETED) {
+            result.skipped++;
+            return true;
+        }
+
+        // The row records the balances of the account it was stored with:
+        // the source, or the destination of a deposit
+        int64_t before = 0;
+        int64_t after = 0;
+        if (parseCents(fields[BALANCE_BEFORE], before) && parseCents(fields[BALANCE_AFTER], after)) {
+            int64_t expected = fields[FROM_ACCOUNT].empty() ? amount : -amount;
+            if (after - before != expected) {
+                result.inconsistent++;
+            }
+        }
+
+        if (!fields[FROM_ACCOUNT].empty()) {
+            AccountDelta& debited = result.partitions[partitionOf(fields[FROM_ACCOUNT])][fields[FROM_ACCOUNT]];
+            debited.net_cents -= amount;
+            debited.transactions++;
+        }
+        if (!fields[TO_ACCOUNT].empty()) {
+            AccountDelta& credited = result.partitions[partitionOf(fields[TO_ACCOUNT])][fields[TO_ACCOUNT]];
+            credited.net_cents += amount;
+            credited.transactions++;
+        }
+        result.replayed++;
+        return true;
+    });
+}
+
+ReplayReport LedgerReplay::run() {
+    auto started = std::chrono::steady_clock::now();
+    ReplayReport report;
+    report.partitions = partition_count;
+    size_t shards = database.getShardCount();
+
+    // Waits for one task per index; the caller must not be a pool worker
+    auto forEach = [this](size_t count, const std::function<void(size_t)>& task) {
+        std::vector<std::future<void>> pending;
+        for (size_t i = 0; i < count; ++i) {
+            auto done = std::make_shared<std::promise<void>>();
+            pending.push_back(done->get_future());
+            pool.submit([&task, i, done]() {
+                task(i);
+                done->set_value();
+            });
+        }
+        for (auto& finished : pending) {
+            finished.get();
+        }
+    };
+
+    // Read every transaction shard
+    std::vector<ShardResult> shard_results(shards);
+    forEach(shards, [&](size_t shard) { replayShard(shard, shard_results[shard]); });
+
+    // Sum each partition, taking the shards in order so the per-account
+    // sequence is the same on every run
+    std::vector<Partition> balances(partition_count);
+    forEach(partition_count, [&](size_t partition) {
+        Partition& merged = balances[partition];
+        for (auto& shard : shard_results) {
+            for (auto& entry : shard.partitions[partition]) {
+                AccountDelta& total = merged[entry.first];
+                total.net_cents += entry.second.net_cents;
+                total.transactions += entry.second.transactions;
+            }
+            shard.partitions[partition].clear();
+        }
+    });
+
+    for (const auto& shard : shard_results) {
+        report.ok = report.ok && shard.ok;
+        report.transactions_replayed += shard.replayed;
+        report.transactions_skipped += shard.skipped;
+        report.rows_unreadable += shard.unreadable;
+        report.rows_inconsistent += shard.inconsistent;
+    }
+
+    // Compare with the stored accounts; the replayed balances are only read
+    struct AccountCheck {
+        bool ok = true;
+        size_t checked = 0;
+        size_t matched = 0;
+        std::vector<ReplayDivergence> divergences;
+        std::vector<std::string> seen;
+    };
+    std::vector<AccountCheck> checks(shards);
+    forEach(shards, [&](size_t shard) {
+        AccountCheck& check = checks[shard];
+        std::string header;
+        check.ok = database.scanLiveRows("accounts", shard, header, [&](const std::string& row) {
+            Account account;
+            if (!account.fromCsvRow(row)) {
+                return true;
+            }
+            const std::string& number = account.getAccountNumber();
+            int64_t stored = toCents(account.getBalance());
+            int64_t replayed = 0;
+            const Partition& partition = balances[partitionOf(number)];
+            auto it = partition.find(number);
+            if (it != partition.end()) {
+                replayed = it->second.net_cents;
+                check.seen.push_back(number);
+            }
+
+            check.checked++;
+            if (stored == replayed) {
+                check.matched++;
+            } else {
+                ReplayDivergence divergence;
+                divergence.account_number = number;
+                divergence.stored_cents = stored;
+                divergence.replayed_cents = replayed;
+                check.divergences.push_back(divergence);
+            }
+            return true;
+        });
+    });
+
+    std::vector<std::string> seen;
+    for (auto& check : checks) {
+        report.ok = report.ok && check.ok;
+        report.accounts_checked += check.checked;
+        report.accounts_matched += check.matched;
+        report.divergences.insert(report.divergences.end(), check.divergences.begin(), check.divergences.end());
+        seen.insert(seen.end(), check.seen.begin(), check.seen.end());
+    }
+
+    // History for accounts that no longer have a row
+    std::sort(seen.begin(), seen.end());
+    for (const auto& partition : balances) {
+        for (const auto& entry : partition) {
+            if (!std::binary_search(seen.begin(), seen.end(), entry.first)) {
+                ReplayDivergence divergence;
+                divergence.account_number = entry.first;
+                divergence.replayed_cents = entry.second.net_cents;
+                divergence.missing_account = true;
+                report.divergences.push_back(divergence);
+            }
+        }
+    }
+
+    std::sort(report.divergences.begin(), report.divergences.end(),
+              [](const ReplayDivergence& a, const ReplayDivergence& b) {
+                  return a.account_number < b.account_number;
+              });
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return report;
+}
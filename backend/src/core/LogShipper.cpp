@@ -0,0 +1,418 @@
+#include "../include/core/LogShipper.h"
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    #pragma comment(lib, "ws2_32.lib")
+#else
+    #include <netdb.h>
+    #include <sys/socket.h>
+    #include <sys/time.h>
+    #include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef _WIN32
+const int SEND_FLAGS = 0;
+#else
+// A standby that went away must fail the send, not raise SIGPIPE
+const int SEND_FLAGS = MSG_NOSIGNAL;
+#endif
+
+// Snapshot rows are sent in chunks of about this many bytes
+const size_t SNAPSHOT_CHUNK = 64 * 1024;
+
+// Connecting, the handshake and every send give up after this long, so a
+// hung standby is dropped instead of blocking the sender
+const int SOCKET_TIMEOUT_SECONDS = 5;
+
+void setSocketTimeouts(int fd, int send_seconds, int receive_seconds) {
+#ifdef _WIN32
+    DWORD send_timeout = send_seconds * 1000;
+    DWORD receive_timeout = receive_seconds * 1000;
+#else
+    timeval send_timeout = {send_seconds, 0};
+    timeval receive_timeout = {receive_seconds, 0};
+#endif
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, (char*)&send_timeout, sizeof(send_timeout));
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (char*)&receive_timeout, sizeof(receive_timeout));
+}
+
+void closeSocket(int fd) {
+#ifdef _WIN32
+    closesocket(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+int64_t steadyNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        int length = static_cast<int>(std::min<size_t>(data.size() - sent, 1 << 20));
+        int n = static_cast<int>(::send(fd, data.data() + sent, length, SEND_FLAGS));
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Reads one '\n'-terminated line; buffer keeps whatever came after it
+bool readLine(int fd, std::string& buffer, std::string& line) {
+    size_t newline;
+    while ((newline = buffer.find('\n')) == std::string::npos) {
+        char chunk[4096];
+        int n = static_cast<int>(::recv(fd, chunk, sizeof(chunk), 0));
+        if (n <= 0) {
+            return false;
+        }
+        buffer.append(chunk, static_cast<size_t>(n));
+    }
+    line = buffer.substr(0, newline);
+    buffer.erase(0, newline + 1);
+    return true;
+}
+
+void appendRecordLine(std::string& out, uint64_t seq, const std::string& table, size_t shard,
+                      const ReplicatedRow& row) {
+    out += "R " + std::to_string(seq) + " " + table + " " + std::to_string(shard) +
+           (row.tombstone ? " D " : " U ") + row.row + "\n";
+}
+
+} // namespace
+
+LogShipper::LogShipper(Database& db, const std::string& host, int port, const std::string& secret,
+                       bool synchronous, std::chrono::milliseconds ack_timeout)
+    : database(db), host(host), port(port), secret(secret), synchronous(synchronous), ack_timeout(ack_timeout),
+      next_seq(0), connected(false), broken(false), stopping(false), snapshotting(false), degraded(false),
+      socket_fd(-1) {
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        throw std::runtime_error("Failed to initialize Winsock");
+    }
+#endif
+}
+
+LogShipper::~LogShipper() {
+    stop();
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+void LogShipper::start() {
+    std::cout << "[DEBUG] Shipping log to standby " << host << ":" << port
+              << (synchronous ? " (synchronous)" : " (asynchronous)") << std::endl;
+    stopping = false;
+    sender_thread = std::thread(&LogShipper::senderLoop, this);
+}
+
+void LogShipper::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    queue_cv.notify_all();
+    if (sender_thread.joinable()) {
+        sender_thread.join();
+    }
+    disconnect();
+}
+
+uint64_t LogShipper::ship(const std::string& table, size_t shard, const std::vector<ReplicatedRow>& rows) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!connected || broken) {
+        return 0;
+    }
+
+    // A standby this far behind gets a fresh snapshot instead of the queue
+    if (pending.size() >= MAX_PENDING_RECORDS) {
+        std::cout << "[ERROR] " << pending.size() << " records queued for the standby, resyncing it" << std::endl;
+        pending.clear();
+        broken = true;
+        overflows++;
+        queue_cv.notify_all();
+        ack_cv.notify_all();
+        return 0;
+    }
+
+    Record record;
+    record.seq = ++next_seq;
+    record.table = table;
+    record.shard = shard;
+    record.rows = rows;
+    pending.push_back(std::move(record));
+    unacked[next_seq] = steadyNowMs();
+
+    queue_cv.notify_one();
+    return next_seq;
+}
+
+bool LogShipper::isSynchronous() const {
+    return synchronous;
+}
+
+bool LogShipper::waitForAck(uint64_t seq) {
+    if (seq == 0) {
+        sync_timeouts++;
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (degraded) {
+        return false;
+    }
+
+    // Records committed while a snapshot is being sent are acknowledged
+    // with it, which can take longer than a commit should wait
+    bool done = ack_cv.wait_for(lock, ack_timeout, [&] {
+        return acked_seq.load() >= seq || !connected || snapshotting;
+    });
+    if (acked_seq.load() >= seq) {
+        return true;
+    }
+    if (!done && connected) {
+        // The commit stands either way; until the standby has caught up,
+        // commits stop waiting for it rather than each paying the timeout
+        degraded = true;
+        std::cout << "[ERROR] Standby did not acknowledge record " << seq << " within " << ack_timeout.count()
+                  << " ms; commits no longer wait for it until it catches up" << std::endl;
+    }
+    if (!done || !connected) {
+        sync_timeouts++;
+    }
+    return false;
+}
+
+bool LogShipper::connectToStandby() {
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* address = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &address) != 0 || !address) {
+        return false;
+    }
+
+    int fd = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+    if (fd < 0) {
+        freeaddrinfo(address);
+        return false;
+    }
+    setSocketTimeouts(fd, SOCKET_TIMEOUT_SECONDS, SOCKET_TIMEOUT_SECONDS);
+    bool ok = ::connect(fd, address->ai_addr, static_cast<int>(address->ai_addrlen)) == 0;
+    freeaddrinfo(address);
+
+    std::string buffer;
+    std::string reply;
+    ok = ok && sendAll(fd, "HELLO " + std::to_string(database.getShardCount()) + " " +
+                         database.getShardHashScheme() + " " + secret + "\n") &&
+         readLine(fd, buffer, reply);
+    if (!ok || reply != "READY") {
+        if (ok) {
+            std::cout << "[ERROR] Standby refused log shipping: " << reply << std::endl;
+        }
+        closeSocket(fd);
+        return false;
+    }
+    // Acknowledgements stop while nothing is committed; the ack thread is
+    // woken by shutdown() instead
+    setSocketTimeouts(fd, SOCKET_TIMEOUT_SECONDS, 0);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        socket_fd = fd;
+        connected = true;
+        broken = false;
+        degraded = false;
+        pending.clear();
+        unacked.clear();
+    }
+    ack_thread = std::thread(&LogShipper::ackLoop, this, fd);
+    std::cout << "[DEBUG] Connected to standby " << host << ":" << port << std::endl;
+    return true;
+}
+
+// Records committed from here on are queued, so every row committed before
+// each table is opened is in the snapshot and everything after follows it.
+// A row can arrive twice; applying it again on the standby is harmless.
+bool LogShipper::sendSnapshot(uint64_t& snapshot_seq) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        snapshot_seq = next_seq;
+        snapshotting = true;
+    }
+    ack_cv.notify_all();
+
+    std::string chunk = "SNAPSHOT_BEGIN\n";
+    bool ok = true;
+    size_t rows = 0;
+    database.forEachLiveRow([&](const std::string& table, size_t shard,
+                                const std::string& key, const std::string& row) {
+        if (!ok) {
+            return;
+        }
+        appendRecordLine(chunk, 0, table, shard, ReplicatedRow{key, row, false});
+        rows++;
+        if (chunk.size() >= SNAPSHOT_CHUNK) {
+            ok = sendLine(chunk);
+            chunk.clear();
+        }
+    });
+    chunk += "SNAPSHOT_END " + std::to_string(snapshot_seq) + "\n";
+    ok = ok && sendLine(chunk);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        snapshotting = false;
+    }
+    resyncs++;
+    std::cout << "[DEBUG] Snapshot of " << rows << " rows sent to standby" << std::endl;
+    return ok;
+}
+
+bool LogShipper::sendLine(const std::string& line) {
+    return sendAll(socket_fd, line);
+}
+
+void LogShipper::disconnect() {
+    int fd;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fd = socket_fd;
+        socket_fd = -1;
+        connected = false;
+        broken = false;
+        pending.clear();
+        unacked.clear();
+    }
+    ack_cv.notify_all();
+
+    if (fd >= 0) {
+#ifdef _WIN32
+        ::shutdown(fd, SD_BOTH);
+#else
+        ::shutdown(fd, SHUT_RDWR);
+#endif
+    }
+    if (ack_thread.joinable()) {
+        ack_thread.join();
+    }
+    if (fd >= 0) {
+        closeSocket(fd);
+        std::cout << "[DEBUG] Disconnected from standby " << host << ":" << port << std::endl;
+    }
+}
+
+void LogShipper::senderLoop() {
+    while (true) {
+        if (!connected) {
+            uint64_t snapshot_seq = 0;
+            if (connectToStandby()) {
+                if (!sendSnapshot(snapshot_seq)) {
+                    disconnect();
+                }
+                continue;
+            }
+
+            // Standby not reachable; try again shortly
+            std::unique_lock<std::mutex> lock(mutex);
+            queue_cv.wait_for(lock, std::chrono::seconds(1), [this] { return stopping; });
+            if (stopping) {
+                break;
+            }
+            continue;
+        }
+
+        std::deque<Record> batch;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queue_cv.wait(lock, [this] { return stopping || broken || !pending.empty(); });
+            if (stopping) {
+                break;
+            }
+            if (!broken) {
+                batch.swap(pending);
+            }
+        }
+        if (batch.empty()) {
+            disconnect();
+            continue;
+        }
+
+        // Everything queued so far goes out in one write
+        std::string out;
+        for (const auto& record : batch) {
+            for (const auto& row : record.rows) {
+                appendRecordLine(out, record.seq, record.table, record.shard, row);
+            }
+            out += "C " + std::to_string(record.seq) + "\n";
+        }
+        if (!sendLine(out)) {
+            disconnect();
+            continue;
+        }
+        shipped_seq = batch.back().seq;
+    }
+}
+
+void LogShipper::ackLoop(int fd) {
+    std::string buffer;
+    std::string line;
+    while (readLine(fd, buffer, line)) {
+        if (line.compare(0, 4, "ACK ") != 0 || line.size() == 4 || line.size() > 23 ||
+            line.find_first_not_of("0123456789", 4) != std::string::npos) {
+            continue;
+        }
+        uint64_t seq = std::stoull(line.substr(4));
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (seq > acked_seq.load()) {
+            acked_seq = seq;
+        }
+        unacked.erase(unacked.begin(), unacked.upper_bound(seq));
+        if (degraded && unacked.empty()) {
+            degraded = false;
+            std::cout << "[DEBUG] Standby caught up; commits wait for it again" << std::endl;
+        }
+        ack_cv.notify_all();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    broken = true;
+    queue_cv.notify_all();
+    ack_cv.notify_all();
+}
+
+ShippingStatus LogShipper::getStatus() {
+    ShippingStatus status;
+    status.standby = host + ":" + std::to_string(port);
+    status.synchronous = synchronous;
+    status.shipped_seq = shipped_seq.load();
+    status.acked_seq = acked_seq.load();
+    status.resyncs = resyncs.load();
+    status.sync_timeouts = sync_timeouts.load();
+    status.overflows = overflows.load();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    status.connected = connected;
+    status.degraded = degraded;
+    status.lag_records = next_seq - std::min(next_seq, status.acked_seq);
+    status.lag_ms = unacked.empty() ? 0 : steadyNowMs() - unacked.begin()->second;
+    return status;
+}
@@ -0,0 +1,472 @@
+#include "../include/core/ReplicaStore.h"
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+    #define NOMINMAX
+    #include <windows.h>
+    #include <io.h>
+    #include <fcntl.h>
+#else
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace {
+
+// Bytes read from a followed file per step
+const size_t READ_CHUNK = 4 * 1024 * 1024;
+
+// Followed files are read by offset through a descriptor that stays on the
+// version it was opened on. On Windows the handle is opened with full
+// sharing so the primary can still write, rename and delete the file.
+int openFollowed(const std::string& path) {
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+    int fd = _open_osfhandle(reinterpret_cast<intptr_t>(handle), _O_RDONLY | _O_BINARY);
+    if (fd < 0) {
+        CloseHandle(handle);
+    }
+    return fd;
+#else
+    return ::open(path.c_str(), O_RDONLY);
+#endif
+}
+
+void closeFollowed(int fd) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+// Identity distinguishes a file from the copy compaction renames over it
+bool describeFollowed(int fd, uint64_t& identity, std::uintmax_t& size) {
+#ifdef _WIN32
+    BY_HANDLE_FILE_INFORMATION info;
+    if (!GetFileInformationByHandle(reinterpret_cast<HANDLE>(_get_osfhandle(fd)), &info)) {
+        return false;
+    }
+    identity = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+    size = (static_cast<std::uintmax_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+#else
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        return false;
+    }
+    identity = static_cast<uint64_t>(info.st_ino);
+    size = static_cast<std::uintmax_t>(info.st_size);
+#endif
+    return true;
+}
+
+// Reads at an offset without moving a shared file position, so lookups on
+// several threads can use the same descriptor
+int64_t readFollowed(int fd, char* buffer, size_t length, std::uintmax_t offset) {
+#ifdef _WIN32
+    OVERLAPPED position = {};
+    position.Offset = static_cast<DWORD>(offset & 0xFFFFFFFFu);
+    position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD got = 0;
+    if (!ReadFile(reinterpret_cast<HANDLE>(_get_osfhandle(fd)), buffer, static_cast<DWORD>(length), &got, &position)) {
+        return -1;
+    }
+    return static_cast<int64_t>(got);
+#else
+    return static_cast<int64_t>(pread(fd, buffer, length, static_cast<off_t>(offset)));
+#endif
+}
+
+int64_t steadyNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string rowKey(const std::string& row) {
+    return row.substr(0, row.find(','));
+}
+
+std::string csvField(const std::string& row, size_t index) {
+    size_t start = 0;
+    for (size_t i = 0; i < index; ++i) {
+        start = row.find(',', start);
+        if (start == std::string::npos) {
+            return "";
+        }
+        start++;
+    }
+    return row.substr(start, row.find(',', start) - start);
+}
+
+} // namespace
+
+ReplicaStore::ReplicaStore(const std::string& primary_dir, std::chrono::milliseconds poll)
+    : primary_directory(primary_dir), poll_interval(poll), stopping(false) {
+    size_t shard_count = Database::readShardManifest(primary_dir);
+    if (shard_count == 0) {
+        shard_count = 1;
+    }
+
+    users.resize(1);
+    users[0].path = primary_dir + "/users/users.csv";
+    users[0].indexed_fields = {1}; // username
+
+    accounts.resize(shard_count);
+    transactions.resize(shard_count);
+    for (size_t shard = 0; shard < shard_count; ++shard) {
+        accounts[shard].path = Database::shardFilePath(primary_dir, "accounts", shard, shard_count);
+        accounts[shard].indexed_fields = {1}; // customer_id
+        transactions[shard].path = Database::shardFilePath(primary_dir, "transactions", shard, shard_count);
+        transactions[shard].indexed_fields = {1, 2}; // from_account_id, to_account_id
+    }
+}
+
+ReplicaStore::~ReplicaStore() {
+    stop();
+    for (auto* group : {&users, &accounts, &transactions}) {
+        for (auto& file : *group) {
+            if (file.fd >= 0) {
+                closeFollowed(file.fd);
+            }
+        }
+    }
+}
+
+bool ReplicaStore::start() {
+    std::cout << "[DEBUG] Replica following " << primary_directory << std::endl;
+    if (!poll()) {
+        std::cout << "[ERROR] Replica cannot read primary data in " << primary_directory << std::endl;
+        return false;
+    }
+    std::cout << "[DEBUG] Replica caught up, " << applied_rows.load() << " rows applied" << std::endl;
+
+    stopping = false;
+    tail_thread = std::thread(&ReplicaStore::tailLoop, this);
+    return true;
+}
+
+void ReplicaStore::stop() {
+    {
+        std::lock_guard<std::mutex> lock(tail_mutex);
+        stopping = true;
+    }
+    tail_cv.notify_all();
+    if (tail_thread.joinable()) {
+        tail_thread.join();
+    }
+}
+
+void ReplicaStore::tailLoop() {
+    std::unique_lock<std::mutex> lock(tail_mutex);
+    while (!stopping) {
+        tail_cv.wait_for(lock, poll_interval);
+        if (stopping) {
+            break;
+        }
+        lock.unlock();
+        poll();
+        lock.lock();
+    }
+}
+
+bool ReplicaStore::poll() {
+    std::uintmax_t behind = 0;
+    bool ok = true;
+
+    for (auto* group : {&users, &accounts, &transactions}) {
+        for (auto& file : *group) {
+            if (!follow(file, behind)) {
+                ok = false;
+            }
+        }
+    }
+
+    lag_bytes = behind;
+    if (ok && behind == 0) {
+        last_caught_up_ms = steadyNowMs();
+    }
+    return ok;
+}
+
+// Only the tail thread (or start() before it exists) calls this, so the
+// bookkeeping fields need no lock; rows are applied under state_mutex.
+bool ReplicaStore::follow(FollowedFile& file, std::uintmax_t& behind) {
+    int fd = openFollowed(file.path);
+    if (fd < 0) {
+        return false;
+    }
+
+    // Identity and size come from a descriptor on the current version, so a
+    // compaction swapping the file in between cannot mix two versions
+    uint64_t identity = 0;
+    std::uintmax_t size = 0;
+    if (!describeFollowed(fd, identity, size)) {
+        closeFollowed(fd);
+        return false;
+    }
+
+    FollowedFile fresh;
+    FollowedFile* target = &file;
+    bool reload = file.identity != 0 && (identity != file.identity || size < file.position);
+    if (reload) {
+        // Build the new version aside; readers keep the old one until the swap
+        fresh.path = file.path;
+        fresh.indexed_fields = file.indexed_fields;
+        fresh.generation = file.generation + 1;
+        fresh.fd = fd;
+        target = &fresh;
+    } else if (file.fd < 0) {
+        std::unique_lock<std::shared_mutex> lock(state_mutex);
+        file.fd = fd;
+    } else {
+        closeFollowed(fd);
+    }
+    target->identity = identity;
+
+    std::string buffer;
+    while (target->position < size) {
+        size_t want = static_cast<size_t>(std::min<std::uintmax_t>(READ_CHUNK, size - target->position));
+        buffer.resize(want);
+        int64_t got = readFollowed(target->fd, &buffer[0], want, target->position);
+        if (got <= 0) {
+            break;
+        }
+        buffer.resize(static_cast<size_t>(got));
+
+        // Apply complete lines only; a partial row is picked up next time
+        size_t last_newline = buffer.rfind('\n');
+        if (last_newline == std::string::npos) {
+            break;
+        }
+
+        std::unique_lock<std::shared_mutex> lock(state_mutex, std::defer_lock);
+        if (target == &file) {
+            lock.lock();
+        }
+
+        size_t line_start = 0;
+        while (line_start <= last_newline) {
+            size_t line_end = buffer.find('\n', line_start);
+            std::string row = buffer.substr(line_start, line_end - line_start);
+            if (!row.empty() && row.back() == '\r') {
+                row.pop_back();
+            }
+
+            // The first line of every file is the CSV header
+            if (target->position + line_start != 0 && !row.empty()) {
+                applyRow(*target, row, target->position + line_start);
+            }
+            line_start = line_end + 1;
+        }
+        target->position += last_newline + 1;
+    }
+
+    if (reload) {
+        int old_fd = file.fd;
+        {
+            std::unique_lock<std::shared_mutex> lock(state_mutex);
+            file = std::move(fresh);
+        }
+        if (old_fd >= 0) {
+            closeFollowed(old_fd);
+        }
+        reloads++;
+    }
+
+    behind += size - file.position;
+    return true;
+}
+
+void ReplicaStore::applyRow(FollowedFile& file, const std::string& row, std::uintmax_t offset) {
+    std::string key = rowKey(row);
+
+    auto it = file.rows.find(key);
+    if (it != file.rows.end()) {
+        // The superseded version is read back to find its index entries
+        std::string previous;
+        if (readRow(file, it->second, previous)) {
+            for (size_t field : file.indexed_fields) {
+                auto entry = file.index.find(csvField(previous, field));
+                if (entry != file.index.end()) {
+                    entry->second.erase(it->second.seq);
+                    if (entry->second.empty()) {
+                        file.index.erase(entry);
+                    }
+                }
+            }
+        }
+        file.order.erase(it->second.seq);
+        file.rows.erase(it);
+    }
+
+    if (row != key + "," + Database::TOMBSTONE_MARKER) {
+        RowRef ref;
+        ref.seq = file.next_seq++;
+        ref.offset = offset;
+        ref.length = row.size();
+        file.rows[key] = ref;
+        file.order[ref.seq] = key;
+        for (size_t field : file.indexed_fields) {
+            std::string value = csvField(row, field);
+            if (!value.empty()) {
+                file.index[value].insert(ref.seq);
+            }
+        }
+    }
+    applied_rows++;
+}
+
+bool ReplicaStore::readRow(const FollowedFile& file, const RowRef& ref, std::string& row) {
+    row.resize(ref.length);
+    int64_t got = readFollowed(file.fd, &row[0], ref.length, ref.offset);
+    if (got != static_cast<int64_t>(ref.length)) {
+        return false;
+    }
+    return true;
+}
+
+bool ReplicaStore::loadUserByUsername(const std::string& username, User& user) const {
+    std::shared_lock<std::shared_mutex> lock(state_mutex);
+    for (const auto& file : users) {
+        auto found = file.index.find(username);
+        if (found == file.index.end()) {
+            continue;
+        }
+        std::string row;
+        const RowRef& ref = file.rows.at(file.order.at(*found->second.begin()));
+        return readRow(file, ref, row) && user.fromCsvRow(row);
+    }
+    return false;
+}
+
+bool ReplicaStore::loadAccount(const std::string& account_number, Account& account) const {
+    std::shared_lock<std::shared_mutex> lock(state_mutex);
+    for (const auto& file : accounts) {
+        auto it = file.rows.find(account_number);
+        if (it != file.rows.end()) {
+            std::string row;
+            return readRow(file, it->second, row) && account.fromCsvRow(row);
+        }
+    }
+    return false;
+}
+
+std::vector<Account> ReplicaStore::getAccountsByCustomerId(const std::string& customer_id) const {
+    std::vector<Account> result;
+    std::shared_lock<std::shared_mutex> lock(state_mutex);
+    for (const auto& file : accounts) {
+        auto found = file.index.find(customer_id);
+        if (found == file.index.end()) {
+            continue;
+        }
+        for (uint64_t seq : found->second) {
+            std::string row;
+            Account account;
+            if (readRow(file, file.rows.at(file.order.at(seq)), row) && account.fromCsvRow(row)) {
+                result.push_back(account);
+            }
+        }
+    }
+    return result;
+}
+
+bool ReplicaStore::loadTransaction(const std::string& transaction_id, Transaction& transaction) const {
+    std::shared_lock<std::shared_mutex> lock(state_mutex);
+    for (const auto& file : transactions) {
+        auto it = file.rows.find(transaction_id);
+        if (it != file.rows.end()) {
+            std::string row;
+            return readRow(file, it->second, row) && transaction.fromCsvRow(row);
+        }
+    }
+    return false;
+}
+
+// Same paging contract as Database::scanTransactions; the token is
+// "<file>.<generation>.<seq>" of the next matching row
+ScanResult ReplicaStore::scanTransactionsByAccount(const std::string& account_id, const ScanOptions& options,
+                                                   const TransactionVisitor& visitor) const {
+    ScanResult result;
+
+    size_t start_file = 0;
+    uint64_t start_generation = 0;
+    uint64_t start_seq = 0;
+    bool resuming = !options.resume_token.empty();
+    if (resuming) {
+        char dot1 = 0, dot2 = 0;
+        std::istringstream in(options.resume_token);
+        if (!(in >> start_file >> dot1 >> start_generation >> dot2 >> start_seq) ||
+            dot1 != '.' || dot2 != '.' || start_file >= transactions.size()) {
+            result.ok = false;
+            return result;
+        }
+    }
+
+    std::shared_lock<std::shared_mutex> lock(state_mutex);
+
+    size_t skipped = 0;
+    bool page_full = false;
+
+    for (size_t index = start_file; index < transactions.size(); ++index) {
+        const FollowedFile& file = transactions[index];
+        if (resuming && index == start_file && file.generation != start_generation) {
+            result.ok = false;
+            return result;
+        }
+
+        // Only the account's own rows are visited, in file order
+        auto found = file.index.find(account_id);
+        if (found == file.index.end()) {
+            continue;
+        }
+        const std::set<uint64_t>& seqs = found->second;
+        auto it = resuming && index == start_file ? seqs.lower_bound(start_seq) : seqs.begin();
+
+        for (; it != seqs.end(); ++it) {
+            std::string row;
+            Transaction transaction;
+            if (!readRow(file, file.rows.at(file.order.at(*it)), row) || !transaction.fromCsvRow(row) ||
+                (options.since > 0 && std::chrono::system_clock::to_time_t(transaction.getTimePoint()) < options.since)) {
+                continue;
+            }
+
+            if (page_full) {
+                result.has_more = true;
+                result.resume_token = std::to_string(index) + "." + std::to_string(file.generation) + "." +
+                                      std::to_string(*it);
+                return result;
+            }
+
+            if (skipped < options.offset) {
+                skipped++;
+                continue;
+            }
+
+            result.returned++;
+            if (!visitor(transaction) || (options.limit > 0 && result.returned >= options.limit)) {
+                page_full = true;
+            }
+        }
+    }
+
+    return result;
+}
+
+ReplicationStatus ReplicaStore::getStatus() const {
+    ReplicationStatus status;
+    status.primary_directory = primary_directory;
+    status.applied_rows = applied_rows.load();
+    status.lag_bytes = lag_bytes.load();
+    status.reloads = reloads.load();
+
+    int64_t caught_up = last_caught_up_ms.load();
+    status.lag_ms = caught_up == 0 ? -1 : steadyNowMs() - caught_up;
+    return status;
+}
@@ -0,0 +1,348 @@
+#include "../include/core/StandbyReceiver.h"
+#include <iostream>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    #pragma comment(lib, "ws2_32.lib")
+#else
+    #include <arpa/inet.h>
+    #include <netinet/in.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef _WIN32
+const int SEND_FLAGS = 0;
+#else
+// A primary that went away must fail the send, not raise SIGPIPE
+const int SEND_FLAGS = MSG_NOSIGNAL;
+#endif
+
+// How often blocked reads check whether the receiver is stopping
+const int POLL_TIMEOUT_MS = 200;
+
+// Snapshot rows are applied in batches of this many
+const size_t SNAPSHOT_BATCH = 1000;
+
+// No row comes close; a longer line is not from a primary
+const size_t MAX_LINE_BYTES = 1024 * 1024;
+
+int64_t steadyNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void closeSocket(int fd) {
+#ifdef _WIN32
+    closesocket(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+// Waits up to timeout_ms for fd to become readable; < 0 on error
+int waitReadable(int fd, int timeout_ms) {
+#ifdef _WIN32
+    WSAPOLLFD ready = {static_cast<SOCKET>(fd), POLLRDNORM, 0};
+    return WSAPoll(&ready, 1, timeout_ms);
+#else
+    pollfd ready = {fd, POLLIN, 0};
+    return ::poll(&ready, 1, timeout_ms);
+#endif
+}
+
+bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        int length = static_cast<int>(std::min<size_t>(data.size() - sent, 1 << 20));
+        int n = static_cast<int>(::send(fd, data.data() + sent, length, SEND_FLAGS));
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Splits off the next space-separated field of line, starting at pos
+std::string nextField(const std::string& line, size_t& pos) {
+    size_t end = line.find(' ', pos);
+    std::string field = line.substr(pos, end - pos);
+    pos = end == std::string::npos ? line.size() : end + 1;
+    return field;
+}
+
+// Numbers off the wire are checked before they are converted
+bool parseNumber(const std::string& field, uint64_t& value) {
+    if (field.empty() || field.size() > 19) {
+        return false;
+    }
+    value = 0;
+    for (char c : field) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        value = value * 10 + static_cast<uint64_t>(c - '0');
+    }
+    return true;
+}
+
+} // namespace
+
+StandbyReceiver::StandbyReceiver(Database& db, const std::string& bind_address, int port,
+                                 const std::string& secret)
+    : database(db), bind_address(bind_address), port(port), secret(secret), listen_fd(-1), stopping(false) {
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        throw std::runtime_error("Failed to initialize Winsock");
+    }
+#endif
+}
+
+StandbyReceiver::~StandbyReceiver() {
+    stop();
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+bool StandbyReceiver::start() {
+    listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        std::cerr << "Error creating standby socket" << std::endl;
+        return false;
+    }
+
+    int opt = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, (char*)&opt, sizeof(opt));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, bind_address.c_str(), &addr.sin_addr) != 1) {
+        std::cerr << "Invalid standby bind address " << bind_address << std::endl;
+        closeSocket(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, 1) < 0) {
+        std::cerr << "Error listening for the primary on " << bind_address << ":" << port << std::endl;
+        closeSocket(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    stopping = false;
+    receive_thread = std::thread(&StandbyReceiver::receiveLoop, this);
+    std::cout << "[DEBUG] Standby waiting for the primary on " << bind_address << ":" << port << std::endl;
+    return true;
+}
+
+void StandbyReceiver::stop() {
+    stopping = true;
+    if (receive_thread.joinable()) {
+        receive_thread.join();
+    }
+    if (listen_fd >= 0) {
+        closeSocket(listen_fd);
+        listen_fd = -1;
+    }
+}
+
+void StandbyReceiver::receiveLoop() {
+    while (!stopping) {
+        if (waitReadable(listen_fd, POLL_TIMEOUT_MS) <= 0) {
+            continue;
+        }
+
+        int fd = ::accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        serveConnection(fd);
+        closeSocket(fd);
+        connected = false;
+
+        // A resync cut short leaves the data as it was before it began
+        if (snapshotting) {
+            database.abortReplicationSnapshot();
+            snapshotting = false;
+            std::cout << "[WARNING] Primary disconnected during a snapshot; keeping the previous data" << std::endl;
+        }
+    }
+}
+
+void StandbyReceiver::serveConnection(int fd) {
+    std::string buffer;
+    std::string line;
+
+    // Reads the next line, giving up when the receiver stops
+    auto readLine = [&]() {
+        size_t newline;
+        while ((newline = buffer.find('\n')) == std::string::npos) {
+            if (buffer.size() > MAX_LINE_BYTES) {
+                return false;
+            }
+            int polled = waitReadable(fd, POLL_TIMEOUT_MS);
+            if (stopping || polled < 0) {
+                return false;
+            }
+            if (polled == 0) {
+                continue;
+            }
+            char chunk[64 * 1024];
+            int n = static_cast<int>(::recv(fd, chunk, sizeof(chunk), 0));
+            if (n <= 0) {
+                return false;
+            }
+            buffer.append(chunk, static_cast<size_t>(n));
+        }
+        line = buffer.substr(0, newline);
+        buffer.erase(0, newline + 1);
+        return true;
+    };
+
+    // "HELLO <shards> <hash scheme> <secret>"; anything else ends the
+    // connection before a single row is taken from it
+    if (!readLine() || line.compare(0, 6, "HELLO ") != 0) {
+        return;
+    }
+    size_t hello_pos = 6;
+    uint64_t shards = 0;
+    bool counted = parseNumber(nextField(line, hello_pos), shards);
+    std::string scheme = nextField(line, hello_pos);
+    if (!counted || !checkSecret(line.substr(hello_pos))) {
+        std::cout << "[ERROR] Refused a primary with a malformed HELLO or the wrong secret" << std::endl;
+        sendAll(fd, "ERROR refused\n");
+        return;
+    }
+    // Both sides must place accounts alike, or promotion would look for
+    // them in the wrong shard files
+    if (shards != database.getShardCount() || scheme != database.getShardHashScheme()) {
+        std::cout << "[ERROR] Primary has " << shards << " shards placed by " << scheme << ", standby has "
+                  << database.getShardCount() << " placed by " << database.getShardHashScheme() << std::endl;
+        sendAll(fd, "ERROR shard layout mismatch\n");
+        return;
+    }
+    if (!sendAll(fd, "READY\n")) {
+        return;
+    }
+    connected = true;
+    std::cout << "[DEBUG] Primary connected to standby" << std::endl;
+
+    // Rows of the record being received; a record covers a single table shard
+    std::string table;
+    size_t shard = 0;
+    std::vector<ReplicatedRow> rows;
+
+    while (readLine()) {
+        size_t pos = 0;
+        std::string kind = nextField(line, pos);
+
+        if (kind == "R") {
+            uint64_t row_seq = 0;
+            uint64_t row_shard = 0;
+            bool numbered = parseNumber(nextField(line, pos), row_seq); // repeated on the commit line
+            std::string row_table = nextField(line, pos);
+            numbered = parseNumber(nextField(line, pos), row_shard) && numbered;
+            std::string marker = nextField(line, pos);
+            if (!numbered || (marker != "U" && marker != "D")) {
+                std::cout << "[ERROR] Malformed row from the primary, dropping the connection" << std::endl;
+                return;
+            }
+            bool tombstone = marker == "D";
+            std::string row = line.substr(pos);
+
+            // Snapshot rows come table by table in large numbers
+            if (!rows.empty() && (row_table != table || row_shard != shard ||
+                                  (snapshotting && rows.size() >= SNAPSHOT_BATCH))) {
+                if (!applyBatch(table, shard, rows)) {
+                    return;
+                }
+            }
+            table = row_table;
+            shard = row_shard;
+            rows.push_back({row.substr(0, row.find(',')), row, tombstone});
+        } else if (kind == "C" || kind == "SNAPSHOT_END") {
+            std::string seq = nextField(line, pos);
+            uint64_t seq_number = 0;
+            if (!parseNumber(seq, seq_number)) {
+                std::cout << "[ERROR] Malformed commit from the primary, dropping the connection" << std::endl;
+                return;
+            }
+            if (!rows.empty() && !applyBatch(table, shard, rows)) {
+                return;
+            }
+            if (kind == "SNAPSHOT_END") {
+                if (!snapshotting || !database.finishReplicationSnapshot()) {
+                    std::cout << "[ERROR] Standby could not swap in the snapshot" << std::endl;
+                    return;
+                }
+                snapshotting = false;
+                snapshots++;
+                std::cout << "[DEBUG] Standby snapshot applied up to record " << seq << std::endl;
+            }
+            applied_seq = seq_number;
+            last_apply_ms = steadyNowMs();
+            if (!sendAll(fd, "ACK " + seq + "\n")) {
+                return;
+            }
+        } else if (kind == "SNAPSHOT_BEGIN") {
+            if (!database.beginReplicationSnapshot()) {
+                std::cout << "[ERROR] Standby could not stage a snapshot" << std::endl;
+                return;
+            }
+            snapshotting = true;
+        } else {
+            std::cout << "[ERROR] Unknown line from the primary, dropping the connection" << std::endl;
+            return;
+        }
+    }
+}
+
+bool StandbyReceiver::applyBatch(const std::string& table, size_t shard, std::vector<ReplicatedRow>& rows) {
+    bool applied = snapshotting ? database.stageReplicatedRows(table, shard, rows)
+                                : database.applyReplicatedRows(table, shard, rows);
+    if (!applied) {
+        std::cout << "[ERROR] Standby failed to apply rows to " << table << " shard " << shard << std::endl;
+        return false;
+    }
+    applied_rows += rows.size();
+    rows.clear();
+    return true;
+}
+
+bool StandbyReceiver::checkSecret(const std::string& presented) const {
+    // Compared in full whatever the first difference, so the time taken
+    // says nothing about how much of it was right
+    unsigned char difference = presented.size() == secret.size() ? 0 : 1;
+    for (size_t i = 0; i < presented.size(); ++i) {
+        difference |= static_cast<unsigned char>(presented[i] ^ secret[i % secret.size()]);
+    }
+    return !secret.empty() && difference == 0;
+}
+
+StandbyStatus StandbyReceiver::getStatus() const {
+    StandbyStatus status;
+    status.port = port;
+    status.connected = connected.load();
+    status.applied_seq = applied_seq.load();
+    status.applied_rows = applied_rows.load();
+    status.snapshots = snapshots.load();
+    status.snapshotting = snapshotting.load();
+
+    int64_t last = last_apply_ms.load();
+    status.last_apply_ms = last == 0 ? -1 : steadyNowMs() - last;
+    return status;
+}
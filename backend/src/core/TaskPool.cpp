@@ -0,0 +1,127 @@
+#include "../include/core/TaskPool.h"
+#include <iostream>
+
+namespace {
+    // Set on pool threads so submit() can queue follow-up work locally
+    thread_local const TaskPool* current_pool = nullptr;
+    thread_local size_t current_worker = 0;
+}
+
+TaskPool::TaskPool(size_t thread_count) : stopping(false) {
+    if (thread_count == 0) {
+        thread_count = std::thread::hardware_concurrency();
+    }
+    if (thread_count == 0) {
+        thread_count = 1;
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers[i]->thread = std::thread(&TaskPool::run, this, i);
+    }
+    std::cout << "[DEBUG] Started task pool with " << thread_count << " workers" << std::endl;
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (auto& worker : workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+void TaskPool::submit(Task task) {
+    size_t index = current_pool == this ? current_worker : next_worker++ % workers.size();
+    Worker& worker = *workers[index];
+    // Counted before it is visible so a worker taking it never sees zero
+    queued++;
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+        if (worker.tasks.size() > worker.max_queued) {
+            worker.max_queued = worker.tasks.size();
+        }
+    }
+
+    // Taking idle_mutex orders this with a worker checking queued before it sleeps
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex);
+    }
+    ready.notify_one();
+}
+
+size_t TaskPool::size() const {
+    return workers.size();
+}
+
+bool TaskPool::takeOwn(Worker& worker, Task& task) {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) {
+        return false;
+    }
+    task = std::move(worker.tasks.front());
+    worker.tasks.pop_front();
+    return true;
+}
+
+bool TaskPool::steal(size_t thief, Task& task) {
+    for (size_t offset = 1; offset < workers.size(); ++offset) {
+        Worker& victim = *workers[(thief + offset) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskPool::run(size_t index) {
+    current_pool = this;
+    current_worker = index;
+    Worker& own = *workers[index];
+
+    while (true) {
+        Task task;
+        if (takeOwn(own, task)) {
+            // Taken from this worker's queue
+        } else if (steal(index, task)) {
+            steals++;
+        } else {
+            std::unique_lock<std::mutex> lock(idle_mutex);
+            // queued can be non-zero for the moment between another worker
+            // popping a task and decrementing it; the rescan handles that
+            ready.wait(lock, [this] { return stopping || queued > 0; });
+            if (stopping && queued == 0) {
+                return;
+            }
+            continue;
+        }
+
+        queued--;
+        task();
+        completed++;
+    }
+}
+
+TaskPoolStats TaskPool::getStats() {
+    TaskPoolStats stats;
+    stats.threads = workers.size();
+    stats.queued = queued.load();
+    stats.completed = completed.load();
+    stats.steals = steals.load();
+    for (auto& worker : workers) {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        if (worker->max_queued > stats.max_queued) {
+            stats.max_queued = worker->max_queued;
+        }
+    }
+    return stats;
+}
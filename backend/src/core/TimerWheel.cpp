@@ -0,0 +1,73 @@
+#include "../include/core/TimerWheel.h"
+
+TimerWheel::TimerWheel(std::time_t now) : current(now) {
+}
+
+void TimerWheel::place(const TimerEntry& entry) {
+    if (entry.due <= current) {
+        overdue.push_back(entry);
+        return;
+    }
+
+    // The coarsest level still within one turn of its wheel; a timer past
+    // the top level's reach waits in its last slot and is placed again
+    // when that slot cascades
+    uint64_t distance = static_cast<uint64_t>(entry.due - current);
+    int level = 0;
+    while (level < LEVELS - 1 && distance >= (uint64_t(1) << (SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+    uint64_t slot_time = static_cast<uint64_t>(entry.due);
+    if (distance >= (uint64_t(1) << (SLOT_BITS * LEVELS))) {
+        slot_time = static_cast<uint64_t>(current) + (uint64_t(SLOTS - 1) << (SLOT_BITS * level));
+    }
+    wheels[level][(slot_time >> (SLOT_BITS * level)) & (SLOTS - 1)].push_back(entry);
+}
+
+void TimerWheel::cascade(int level) {
+    auto& slot = wheels[level][(static_cast<uint64_t>(current) >> (SLOT_BITS * level)) & (SLOTS - 1)];
+    std::vector<TimerEntry> moving;
+    moving.swap(slot);
+    for (const auto& entry : moving) {
+        place(entry);
+    }
+}
+
+void TimerWheel::schedule(uint64_t id, std::time_t due) {
+    place({id, due});
+    pending++;
+}
+
+void TimerWheel::advance(std::time_t now, std::vector<TimerEntry>& due) {
+    size_t first = due.size();
+    due.insert(due.end(), overdue.begin(), overdue.end());
+    overdue.clear();
+
+    while (current < now) {
+        current++;
+        uint64_t tick = static_cast<uint64_t>(current);
+
+        // Coarse levels first, so their timers can land in this tick's slot
+        for (int level = LEVELS - 1; level > 0; --level) {
+            if ((tick & ((uint64_t(1) << (SLOT_BITS * level)) - 1)) == 0) {
+                cascade(level);
+            }
+        }
+
+        auto& slot = wheels[0][tick & (SLOTS - 1)];
+        due.insert(due.end(), slot.begin(), slot.end());
+        slot.clear();
+        // Cascaded timers that were already due
+        due.insert(due.end(), overdue.begin(), overdue.end());
+        overdue.clear();
+    }
+    pending -= due.size() - first;
+}
+
+std::time_t TimerWheel::now() const {
+    return current;
+}
+
+size_t TimerWheel::size() const {
+    return pending;
+}
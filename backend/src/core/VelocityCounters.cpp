@@ -0,0 +1,126 @@
+#include "../include/core/VelocityCounters.h"
+#include <functional>
+#include <algorithm>
+
+VelocityCounters::VelocityCounters() : stripes(STRIPES) {
+}
+
+VelocityCounters::Stripe& VelocityCounters::stripeFor(const std::string& account_number) {
+    return stripes[std::hash<std::string>{}(account_number) % STRIPES];
+}
+
+void VelocityCounters::advance(Window& window, int64_t bucket) {
+    if (bucket <= window.newest_bucket) {
+        return;
+    }
+    if (bucket - window.newest_bucket >= BUCKETS) {
+        window.cents.fill(0);
+        window.total_cents = 0;
+    } else {
+        for (int64_t expired = window.newest_bucket + 1; expired <= bucket; ++expired) {
+            int64_t& slot = window.cents[expired % BUCKETS];
+            window.total_cents -= slot;
+            slot = 0;
+        }
+    }
+    window.newest_bucket = bucket;
+}
+
+void VelocityCounters::sweep(Stripe& stripe, int64_t bucket) {
+    for (auto it = stripe.windows.begin(); it != stripe.windows.end();) {
+        advance(it->second, bucket);
+        if (it->second.total_cents == 0) {
+            it = stripe.windows.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    stripe.swept_bucket = bucket;
+}
+
+bool VelocityCounters::reserve(const std::string& account_number, int64_t cents, int64_t limit_cents,
+                               std::time_t now) {
+    int64_t bucket = now / BUCKET_SECONDS;
+    Stripe& stripe = stripeFor(account_number);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    if (bucket > stripe.swept_bucket) {
+        sweep(stripe, bucket);
+    }
+
+    Window& window = stripe.windows[account_number];
+    advance(window, bucket);
+    if (window.total_cents + cents > limit_cents) {
+        refused++;
+        if (window.total_cents == 0) {
+            stripe.windows.erase(account_number);
+        }
+        return false;
+    }
+    window.cents[bucket % BUCKETS] += cents;
+    window.total_cents += cents;
+    return true;
+}
+
+void VelocityCounters::release(const std::string& account_number, int64_t cents, std::time_t at) {
+    int64_t bucket = at / BUCKET_SECONDS;
+    Stripe& stripe = stripeFor(account_number);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+
+    auto it = stripe.windows.find(account_number);
+    // Nothing to give back once the bucket has left the window
+    if (it == stripe.windows.end() || bucket <= it->second.newest_bucket - BUCKETS) {
+        return;
+    }
+    Window& window = it->second;
+    window.cents[bucket % BUCKETS] -= cents;
+    window.total_cents -= cents;
+}
+
+void VelocityCounters::record(const std::string& account_number, int64_t cents, std::time_t at) {
+    int64_t bucket = at / BUCKET_SECONDS;
+    Stripe& stripe = stripeFor(account_number);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    if (bucket > stripe.swept_bucket) {
+        sweep(stripe, bucket);
+    }
+
+    Window& window = stripe.windows[account_number];
+    if (bucket > window.newest_bucket) {
+        advance(window, bucket);
+    } else if (bucket <= window.newest_bucket - BUCKETS) {
+        return; // Older than the window
+    }
+    window.cents[bucket % BUCKETS] += cents;
+    window.total_cents += cents;
+}
+
+int64_t VelocityCounters::usedCents(const std::string& account_number, std::time_t now) {
+    Stripe& stripe = stripeFor(account_number);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+
+    auto it = stripe.windows.find(account_number);
+    if (it == stripe.windows.end()) {
+        return 0;
+    }
+    advance(it->second, now / BUCKET_SECONDS);
+    return it->second.total_cents;
+}
+
+void VelocityCounters::clear() {
+    for (auto& stripe : stripes) {
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        stripe.windows.clear();
+    }
+}
+
+VelocityStats VelocityCounters::getStats() {
+    VelocityStats stats;
+    int64_t bucket = std::time(nullptr) / BUCKET_SECONDS;
+    for (auto& stripe : stripes) {
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        sweep(stripe, std::max(bucket, stripe.swept_bucket));
+        stats.accounts += stripe.windows.size();
+    }
+    stats.refused = refused.load();
+    return stats;
+}
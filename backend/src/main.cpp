@@ -6,17 +6,18 @@
 #include <chrono>
 #include <filesystem>
 #include <fstream>  // ADDED: For std::ifstream
+#include <cstdlib>
 #include "../include/services/BankingService.h"
 #include "../include/services/ApiServer.h"
 
 std::unique_ptr<ApiServer> server;
 
+// Set by the signal handler; main() notices it and shuts down. Locks and
+// I/O are not safe inside the handler itself.
+volatile sig_atomic_t shutdown_requested = 0;
+
 void signalHandler(int) {
-    std::cout << "\nShutting down server..." << std::endl;
-    if (server) {
-        server->stop();
-    }
-    exit(0);
+    shutdown_requested = 1;
 }
 
 void printWelcome() {
@@ -33,6 +34,20 @@ void printUsage() {
     std::cout << "Options:" << std::endl;
     std::cout << "  --port <port>    Set server port (default: 8080)" << std::endl;
     std::cout << "  --data <path>    Set data directory (default: ../data)" << std::endl;
+    std::cout << "  --shards <n>     Partition accounts into n shards (default: 1, fixed once data exists)" << std::endl;
+    std::cout << "  --replica-of <path>  Serve reads from a primary's data directory (read-only)" << std::endl;
+    std::cout << "  --hot-days <n>   Keep the last n days of transactions in memory (default: 30, 0 = off)" << std::endl;
+    std::cout << "  --hot-mb <n>     Memory budget for recent transactions in MB (default: 256)" << std::endl;
+    std::cout << "  --ship-to <host:port>  Ship every commit to a warm standby" << std::endl;
+    std::cout << "  --sync-ack       With --ship-to, wait for the standby before reporting a commit" << std::endl;
+    std::cout << "  --standby-port <port>  Run as a warm standby receiving on this port (read-only until promoted)" << std::endl;
+    std::cout << "  --standby-bind <addr>  Address the standby receives on (default: 127.0.0.1)" << std::endl;
+    std::cout << "  --replication-secret <secret>  Shared by primary and standby, required with --ship-to and" << std::endl;
+    std::cout << "                   --standby-port; also needed to promote (default: $BANKING_REPLICATION_SECRET)" << std::endl;
+    std::cout << "  --optimistic     Apply balance changes without account locks, retrying on version conflicts" << std::endl;
+    std::cout << "  --ledger         Acknowledge balance changes from memory and write them in the background" << std::endl;
+    std::cout << "  --executors <n>  Apply balance changes on n single-writer threads that own the accounts" << std::endl;
+    std::cout << "  --workers <n>    Worker threads for connections and async work (default: hardware threads)" << std::endl;
     std::cout << "  --help          Show this help message" << std::endl;
 }
 
@@ -42,6 +57,20 @@ int main(int argc, char* argv[]) {
     // Parse command line arguments
     int port = 8080;
     std::string data_dir = "../data";  // FIXED: Use relative path from build directory
+    size_t shard_count = 1;
+    std::string replica_of;
+    std::string ship_to;
+    bool sync_ack = false;
+    int standby_port = 0;
+    std::string standby_bind = "127.0.0.1";
+    const char* secret_env = std::getenv("BANKING_REPLICATION_SECRET");
+    std::string replication_secret = secret_env ? secret_env : "";
+    long long hot_days = 30;
+    std::uintmax_t hot_mb = 256;
+    bool optimistic = false;
+    bool use_ledger = false;
+    size_t executor_count = 0;
+    size_t worker_count = 0;
     
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
@@ -53,9 +82,42 @@ int main(int argc, char* argv[]) {
             port = std::stoi(argv[++i]);
         } else if (arg == "--data" && i + 1 < argc) {
             data_dir = argv[++i];
+        } else if (arg == "--shards" && i + 1 < argc) {
+            shard_count = std::stoul(argv[++i]);
+        } else if (arg == "--replica-of" && i + 1 < argc) {
+            replica_of = argv[++i];
+        } else if (arg == "--ship-to" && i + 1 < argc) {
+            ship_to = argv[++i];
+        } else if (arg == "--sync-ack") {
+            sync_ack = true;
+        } else if (arg == "--standby-port" && i + 1 < argc) {
+            standby_port = std::stoi(argv[++i]);
+        } else if (arg == "--standby-bind" && i + 1 < argc) {
+            standby_bind = argv[++i];
+        } else if (arg == "--replication-secret" && i + 1 < argc) {
+            replication_secret = argv[++i];
+        } else if (arg == "--hot-days" && i + 1 < argc) {
+            hot_days = std::stoll(argv[++i]);
+        } else if (arg == "--hot-mb" && i + 1 < argc) {
+            hot_mb = std::stoull(argv[++i]);
+        } else if (arg == "--optimistic") {
+            optimistic = true;
+        } else if (arg == "--ledger") {
+            use_ledger = true;
+        } else if (arg == "--executors" && i + 1 < argc) {
+            executor_count = std::stoul(argv[++i]);
+        } else if (arg == "--workers" && i + 1 < argc) {
+            worker_count = std::stoul(argv[++i]);
         }
     }
     
+    // The secret travels as one field of the HELLO line
+    if ((!ship_to.empty() || standby_port > 0) &&
+        (replication_secret.empty() || replication_secret.find_first_of(" \t\r\n") != std::string::npos)) {
+        std::cerr << "--ship-to and --standby-port need a --replication-secret without whitespace" << std::endl;
+        return 1;
+    }
+    
     // Set up signal handling
     signal(SIGINT, signalHandler);
     signal(SIGTERM, signalHandler);
@@ -77,13 +139,49 @@ int main(int argc, char* argv[]) {
         
         // Initialize banking service
         std::cout << "Initializing banking service..." << std::endl;
-        auto banking_service = std::make_shared<BankingService>(data_dir);
+        auto banking_service = std::make_shared<BankingService>(data_dir, shard_count, worker_count);
+        banking_service->configureTiering(hot_days * 24 * 3600, hot_mb * 1024 * 1024);
+        if (optimistic) {
+            banking_service->setConcurrencyMode(ConcurrencyMode::OPTIMISTIC);
+        }
         
-        if (!banking_service->initialize()) {
+        bool initialized;
+        if (!replica_of.empty()) {
+            initialized = banking_service->initializeReplica(replica_of);
+        } else if (standby_port > 0) {
+            initialized = banking_service->initializeStandby(standby_bind, standby_port, replication_secret);
+        } else {
+            initialized = banking_service->initialize();
+        }
+        if (!initialized) {
             std::cerr << "Failed to initialize banking service!" << std::endl;
             return 1;
         }
         
+        if (!ship_to.empty()) {
+            size_t colon = ship_to.rfind(':');
+            if (colon == std::string::npos ||
+                !banking_service->configureLogShipping(ship_to.substr(0, colon), std::stoi(ship_to.substr(colon + 1)),
+                                                       replication_secret, sync_ack)) {
+                std::cerr << "Invalid --ship-to " << ship_to << std::endl;
+                return 1;
+            }
+        }
+        
+        if (use_ledger && !banking_service->enableLedger()) {
+            std::cerr << "--ledger needs a primary" << std::endl;
+            return 1;
+        }
+        if (executor_count > 0 && !banking_service->enableExecutors(executor_count)) {
+            std::cerr << "--executors needs a primary and cannot be combined with --ledger" << std::endl;
+            return 1;
+        }
+        // A standby starts running standing orders when it is promoted
+        if (replica_of.empty() && standby_port == 0 && !banking_service->enableScheduler()) {
+            std::cerr << "Failed to start the standing order scheduler" << std::endl;
+            return 1;
+        }
+        
         std::cout << "Banking service initialized successfully." << std::endl;
         std::cout << "Data directory: " << abs_data_path << std::endl;
         
@@ -133,9 +231,17 @@ int main(int argc, char* argv[]) {
         std::cout << "========================================" << std::endl;
         
         // Keep the main thread alive
-        while (server->isRunning()) {
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+        while (server->isRunning() && !shutdown_requested) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
+        
+        std::cout << "\nShutting down server..." << std::endl;
+        server->stop();
+        // Ledger mode: write the changes already acknowledged to clients
+        if (!banking_service->flushLedger()) {
+            std::cerr << "Balance ledger did not finish writing before shutdown" << std::endl;
         }
+        server.reset();
         
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -1,14 +1,16 @@
 #include "../include/models/Account.h"
+#include "../include/core/LocalTime.h"
 #include <sstream>
 #include <random>
 #include <iomanip>
 #include <chrono>
 #include <iostream>
 #include <ctime>
+#include <algorithm>
 
 Account::Account() 
     : account_type(AccountType::CHECKING), balance(0.0), 
-      status(AccountStatus::PENDING), daily_limit(1000.0), minimum_balance(0.0) {
+      status(AccountStatus::PENDING), daily_limit(1000.0), minimum_balance(0.0), version(1) {
     created_date = std::chrono::system_clock::now();
     last_updated = created_date;
 }
@@ -17,7 +19,7 @@ Account::Account(const std::string& acc_num, const std::string& cust_id,
                 AccountType type, double initial_balance)
     : account_number(acc_num), customer_id(cust_id), account_type(type),
       balance(initial_balance), status(AccountStatus::ACTIVE), 
-      daily_limit(1000.0), minimum_balance(0.0) {
+      daily_limit(1000.0), minimum_balance(0.0), version(1) {
     
     // Set account-specific limits
     switch (type) {
@@ -47,18 +49,23 @@ double Account::getBalance() const { return balance; }
 AccountStatus Account::getStatus() const { return status; }
 double Account::getDailyLimit() const { return daily_limit; }
 double Account::getMinimumBalance() const { return minimum_balance; }
+uint64_t Account::getVersion() const { return version; }
 
 std::string Account::getCreatedDate() const {
     auto time_t = std::chrono::system_clock::to_time_t(created_date);
     std::stringstream ss;
-    ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
+    std::tm local_tm = {};
+    toLocalTime(time_t, local_tm);
+    ss << std::put_time(&local_tm, "%Y-%m-%d %H:%M:%S");
     return ss.str();
 }
 
 std::string Account::getLastUpdated() const {
     auto time_t = std::chrono::system_clock::to_time_t(last_updated);
     std::stringstream ss;
-    ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
+    std::tm local_tm = {};
+    toLocalTime(time_t, local_tm);
+    ss << std::put_time(&local_tm, "%Y-%m-%d %H:%M:%S");
     return ss.str();
 }
 
@@ -87,6 +94,10 @@ void Account::updateLastModified() {
     last_updated = std::chrono::system_clock::now();
 }
 
+void Account::setVersion(uint64_t new_version) {
+    version = new_version;
+}
+
 // Account operations
 bool Account::deposit(double amount) {
     if (amount <= 0 || !isActive()) {
@@ -190,7 +201,8 @@ std::string Account::toJson() const {
          << "\"daily_limit\":" << std::fixed << std::setprecision(2) << daily_limit << ","
          << "\"minimum_balance\":" << std::fixed << std::setprecision(2) << minimum_balance << ","
          << "\"created_date\":\"" << getCreatedDate() << "\","
-         << "\"last_updated\":\"" << getLastUpdated() << "\""
+         << "\"last_updated\":\"" << getLastUpdated() << "\","
+         << "\"version\":" << version
          << "}";
     
     return json.str();
@@ -222,7 +234,8 @@ std::string Account::toCsvRow() const {
         << std::fixed << std::setprecision(2) << daily_limit << ","
         << std::fixed << std::setprecision(2) << minimum_balance << ","
         << getCreatedDate() << ","
-        << getLastUpdated();
+        << getLastUpdated() << ","
+        << version;
     
     std::string result = oss.str();
     std::cout << "[DEBUG] toCsvRow result: " << result << std::endl;
@@ -256,6 +269,9 @@ bool Account::fromCsvRow(const std::string& csv_row) {
         created_date = std::chrono::system_clock::now();
         last_updated = std::chrono::system_clock::now();
         
+        // Rows written before accounts were versioned have no version column
+        version = tokens.size() > 9 ? std::stoull(tokens[9]) : 1;
+        
         return true;
     } catch (const std::exception& e) {
         return false;
@@ -303,6 +319,7 @@ bool Account::fromJson(const std::string& json_str) {
         // Set timestamps to current time for simplicity
         created_date = std::chrono::system_clock::now();
         last_updated = std::chrono::system_clock::now();
+        version = std::max<uint64_t>(1, static_cast<uint64_t>(extractDouble("version")));
         
         return true;
     } catch (const std::exception& e) {
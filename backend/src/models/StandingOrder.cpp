@@ -0,0 +1,255 @@
+#include "../../include/models/StandingOrder.h"
+#include "../../include/core/LocalTime.h"
+#include <sstream>
+#include <iomanip>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+namespace {
+
+// Descriptions end up in CSV rows and JSON strings unescaped
+std::string sanitize(std::string text) {
+    std::replace_if(text.begin(), text.end(), [](char c) {
+        return c == ',' || c == '"' || c == '\\' || c == '\n' || c == '\r' || c == '[' || c == ']';
+    }, ' ');
+    return text;
+}
+
+int daysInMonth(int year, int month) { // month 0-11, year since 1900
+    static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    int full_year = year + 1900;
+    bool leap = (full_year % 4 == 0 && full_year % 100 != 0) || full_year % 400 == 0;
+    return month == 1 && leap ? 29 : days[month];
+}
+
+const char* RUN_MARKER = " [standing order ";
+
+} // namespace
+
+StandingOrder::StandingOrder()
+    : amount(0.0), frequency(StandingOrderFrequency::MONTHLY), first_run(0), next_run_index(0),
+      status(StandingOrderStatus::ACTIVE), failed_runs(0), skipped_runs(0) {
+}
+
+StandingOrder::StandingOrder(const std::string& from_account, const std::string& to_account, double amount,
+                             StandingOrderFrequency frequency, std::time_t first_run,
+                             const std::string& description)
+    : from_account_id(from_account), to_account_id(to_account), amount(amount), frequency(frequency),
+      first_run(first_run), next_run_index(0), status(StandingOrderStatus::ACTIVE), failed_runs(0),
+      skipped_runs(0), description(sanitize(description)) {
+    order_id = generateOrderId();
+}
+
+// Getters
+std::string StandingOrder::getOrderId() const { return order_id; }
+std::string StandingOrder::getFromAccountId() const { return from_account_id; }
+std::string StandingOrder::getToAccountId() const { return to_account_id; }
+double StandingOrder::getAmount() const { return amount; }
+StandingOrderFrequency StandingOrder::getFrequency() const { return frequency; }
+std::time_t StandingOrder::getFirstRun() const { return first_run; }
+uint64_t StandingOrder::getNextRunIndex() const { return next_run_index; }
+StandingOrderStatus StandingOrder::getStatus() const { return status; }
+uint64_t StandingOrder::getFailedRuns() const { return failed_runs; }
+uint64_t StandingOrder::getSkippedRuns() const { return skipped_runs; }
+std::string StandingOrder::getLastResult() const { return last_result; }
+std::string StandingOrder::getDescription() const { return description; }
+
+// Setters
+void StandingOrder::setStatus(StandingOrderStatus status) {
+    this->status = status;
+}
+
+void StandingOrder::setNextRunIndex(uint64_t index) {
+    this->next_run_index = index;
+}
+
+void StandingOrder::setLastResult(const std::string& result) {
+    this->last_result = sanitize(result);
+}
+
+void StandingOrder::addFailedRun() {
+    failed_runs++;
+}
+
+void StandingOrder::addSkippedRuns(uint64_t count) {
+    skipped_runs += count;
+}
+
+// Schedule
+std::time_t StandingOrder::runTime(uint64_t index) const {
+    switch (frequency) {
+        case StandingOrderFrequency::DAILY:
+            return first_run + static_cast<std::time_t>(index) * 24 * 3600;
+        case StandingOrderFrequency::WEEKLY:
+            return first_run + static_cast<std::time_t>(index) * 7 * 24 * 3600;
+        case StandingOrderFrequency::MONTHLY:
+        default: {
+            // Same local time of day, on the first run's day or the month's last
+            std::tm first_tm = {};
+            toLocalTime(first_run, first_tm);
+            std::tm run_tm = first_tm;
+            long long months = static_cast<long long>(first_tm.tm_mon) + static_cast<long long>(index);
+            run_tm.tm_year = first_tm.tm_year + static_cast<int>(months / 12);
+            run_tm.tm_mon = static_cast<int>(months % 12);
+            run_tm.tm_mday = std::min(first_tm.tm_mday, daysInMonth(run_tm.tm_year, run_tm.tm_mon));
+            run_tm.tm_isdst = -1;
+            return std::mktime(&run_tm);
+        }
+    }
+}
+
+std::time_t StandingOrder::getNextRun() const {
+    return runTime(next_run_index);
+}
+
+std::string StandingOrder::runDescription(uint64_t index) const {
+    return (description.empty() ? "Standing order" : description) + RUN_MARKER + order_id + " run " +
+           std::to_string(index) + "]";
+}
+
+bool StandingOrder::parseRunDescription(const std::string& description, std::string& order_id, uint64_t& index) {
+    size_t marker = description.rfind(RUN_MARKER);
+    if (marker == std::string::npos || description.empty() || description.back() != ']') {
+        return false;
+    }
+    size_t id_start = marker + std::string(RUN_MARKER).size();
+    size_t run = description.find(" run ", id_start);
+    if (run == std::string::npos) {
+        return false;
+    }
+    try {
+        order_id = description.substr(id_start, run - id_start);
+        index = std::stoull(description.substr(run + 5, description.size() - 1 - (run + 5)));
+    } catch (const std::exception& e) {
+        return false;
+    }
+    return !order_id.empty();
+}
+
+// Validation
+bool StandingOrder::isValid() const {
+    return !order_id.empty() && !from_account_id.empty() && !to_account_id.empty() &&
+           from_account_id != to_account_id && amount > 0 && first_run > 0;
+}
+
+// Serialization
+std::string StandingOrder::toJson() const {
+    std::ostringstream json;
+    json << "{"
+         << "\"order_id\":\"" << order_id << "\","
+         << "\"from_account\":\"" << from_account_id << "\","
+         << "\"to_account\":\"" << to_account_id << "\","
+         << "\"amount\":" << std::fixed << std::setprecision(2) << amount << ","
+         << "\"frequency\":\"" << frequencyToString() << "\","
+         << "\"status\":\"" << statusToString() << "\","
+         << "\"first_run\":" << first_run << ","
+         << "\"next_run\":" << getNextRun() << ","
+         << "\"runs\":" << next_run_index << ","
+         << "\"failed_runs\":" << failed_runs << ","
+         << "\"skipped_runs\":" << skipped_runs << ","
+         << "\"last_result\":\"" << last_result << "\","
+         << "\"description\":\"" << description << "\""
+         << "}";
+
+    return json.str();
+}
+
+std::string StandingOrder::toCsvRow() const {
+    std::ostringstream csv;
+    csv << order_id << ","
+        << from_account_id << ","
+        << to_account_id << ","
+        << std::fixed << std::setprecision(2) << amount << ","
+        << frequencyToString() << ","
+        << first_run << ","
+        << next_run_index << ","
+        << statusToString() << ","
+        << failed_runs << ","
+        << skipped_runs << ","
+        << last_result << ","
+        << description;
+
+    return csv.str();
+}
+
+bool StandingOrder::fromCsvRow(const std::string& csv_row) {
+    std::vector<std::string> tokens;
+    std::stringstream ss(csv_row);
+    std::string token;
+
+    while (std::getline(ss, token, ',')) {
+        tokens.push_back(token);
+    }
+    if (!csv_row.empty() && csv_row.back() == ',') {
+        tokens.push_back(""); // Empty description
+    }
+
+    if (tokens.size() < 12) {
+        return false;
+    }
+
+    try {
+        order_id = tokens[0];
+        from_account_id = tokens[1];
+        to_account_id = tokens[2];
+        amount = std::stod(tokens[3]);
+        if (!stringToFrequency(tokens[4], frequency)) {
+            return false;
+        }
+        first_run = static_cast<std::time_t>(std::stoll(tokens[5]));
+        next_run_index = std::stoull(tokens[6]);
+        status = stringToStatus(tokens[7]);
+        failed_runs = std::stoull(tokens[8]);
+        skipped_runs = std::stoull(tokens[9]);
+        last_result = tokens[10];
+        description = tokens[11];
+
+        return true;
+    } catch (const std::exception& e) {
+        return false;
+    }
+}
+
+// Utility
+std::string StandingOrder::frequencyToString() const {
+    switch (frequency) {
+        case StandingOrderFrequency::DAILY: return "DAILY";
+        case StandingOrderFrequency::WEEKLY: return "WEEKLY";
+        case StandingOrderFrequency::MONTHLY: return "MONTHLY";
+        default: return "MONTHLY";
+    }
+}
+
+std::string StandingOrder::statusToString() const {
+    switch (status) {
+        case StandingOrderStatus::ACTIVE: return "ACTIVE";
+        case StandingOrderStatus::CANCELLED: return "CANCELLED";
+        default: return "ACTIVE";
+    }
+}
+
+bool StandingOrder::stringToFrequency(const std::string& frequency_str, StandingOrderFrequency& frequency) {
+    if (frequency_str == "DAILY") {
+        frequency = StandingOrderFrequency::DAILY;
+    } else if (frequency_str == "WEEKLY") {
+        frequency = StandingOrderFrequency::WEEKLY;
+    } else if (frequency_str == "MONTHLY") {
+        frequency = StandingOrderFrequency::MONTHLY;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+StandingOrderStatus StandingOrder::stringToStatus(const std::string& status_str) {
+    if (status_str == "CANCELLED") return StandingOrderStatus::CANCELLED;
+    return StandingOrderStatus::ACTIVE;
+}
+
+std::string StandingOrder::generateOrderId() {
+    thread_local std::random_device rd;
+    thread_local std::mt19937 gen(rd());
+    thread_local std::uniform_int_distribution<long long> dis(100000000000000LL, 999999999999999LL);
+    return "SO" + std::to_string(dis(gen));
+}
@@ -1,4 +1,5 @@
 #include "../include/models/Transaction.h"
+#include "../include/core/LocalTime.h"
 #include <sstream>
 #include <random>
 #include <iomanip>
@@ -37,10 +38,16 @@ std::string Transaction::getReferenceNumber() const { return reference_number; }
 std::string Transaction::getTimestamp() const {
     auto time_t = std::chrono::system_clock::to_time_t(timestamp);
     std::stringstream ss;
-    ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
+    std::tm local_tm = {};
+    toLocalTime(time_t, local_tm);
+    ss << std::put_time(&local_tm, "%Y-%m-%d %H:%M:%S");
     return ss.str();
 }
 
+std::chrono::system_clock::time_point Transaction::getTimePoint() const {
+    return timestamp;
+}
+
 // Setters
 void Transaction::setStatus(TransactionStatus status) {
     this->status = status;
@@ -106,16 +113,17 @@ TransactionStatus Transaction::stringToStatus(const std::string& status_str) {
 }
 
 std::string Transaction::generateTransactionId() {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_int_distribution<> dis(100000000, 999999999);
+    thread_local std::random_device rd;
+    thread_local std::mt19937 gen(rd());
+    // Wide enough that ids stay unique at ledger-mode volumes
+    thread_local std::uniform_int_distribution<long long> dis(100000000000000LL, 999999999999999LL);
     return "TXN" + std::to_string(dis(gen));
 }
 
 std::string Transaction::generateReferenceNumber() {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_int_distribution<long long> dis(1000000000LL, 9999999999LL);
+    thread_local std::random_device rd;
+    thread_local std::mt19937 gen(rd());
+    thread_local std::uniform_int_distribution<long long> dis(1000000000LL, 9999999999LL);
     return "REF" + std::to_string(dis(gen));
 }
 
@@ -181,8 +189,16 @@ bool Transaction::fromCsvRow(const std::string& csv_row) {
         balance_after = std::stod(tokens[8]);
         reference_number = tokens[10];
         
-        // Parse timestamp - simplified implementation
-        timestamp = std::chrono::system_clock::now();
+        // Timestamps are stored in local time as written by getTimestamp()
+        std::tm tm = {};
+        std::istringstream ts(tokens[9]);
+        ts >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
+        if (ts.fail()) {
+            timestamp = std::chrono::system_clock::now();
+        } else {
+            tm.tm_isdst = -1;
+            timestamp = std::chrono::system_clock::from_time_t(std::mktime(&tm));
+        }
         
         return true;
     } catch (const std::exception& e) {
@@ -1,8 +1,10 @@
 #include "../include/models/User.h"
+#include "../include/core/LocalTime.h"
 #include <sstream>
 #include <random>
 #include <algorithm>
 #include <iomanip>
+#include <ctime>
 
 User::User() 
     : role(UserRole::CUSTOMER), is_active(true), failed_login_attempts(0) {
@@ -23,9 +25,9 @@ User::User(const std::string& username, const std::string& password_hash,
 }
 
 std::string User::generateUserId() {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_int_distribution<> dis(100000, 999999);
+    thread_local std::random_device rd;
+    thread_local std::mt19937 gen(rd());
+    thread_local std::uniform_int_distribution<> dis(100000, 999999);
     return "USR" + std::to_string(dis(gen));
 }
 
@@ -47,14 +49,18 @@ std::string User::getLastLogin() const {
     }
     auto time_t = std::chrono::system_clock::to_time_t(last_login);
     std::stringstream ss;
-    ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
+    std::tm local_tm = {};
+    toLocalTime(time_t, local_tm);
+    ss << std::put_time(&local_tm, "%Y-%m-%d %H:%M:%S");
     return ss.str();
 }
 
 std::string User::getCreatedDate() const {
     auto time_t = std::chrono::system_clock::to_time_t(created_date);
     std::stringstream ss;
-    ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
+    std::tm local_tm = {};
+    toLocalTime(time_t, local_tm);
+    ss << std::put_time(&local_tm, "%Y-%m-%d %H:%M:%S");
     return ss.str();
 }
 
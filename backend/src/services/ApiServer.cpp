@@ -9,6 +9,10 @@
 #include <cstring>
 #include <cctype>
 #include <iomanip>  // For std::fixed and std::setprecision
+#include <ctime>
+#include <chrono>
+#include <vector>
+#include <unordered_map>
 
 #ifdef _WIN32
     #include <winsock2.h>
@@ -16,12 +20,37 @@
     #pragma comment(lib, "ws2_32.lib")
 #else
     #include <sys/socket.h>
+    #include <sys/time.h>
     #include <netinet/in.h>
     #include <arpa/inet.h>
     #include <unistd.h>
     #include <fcntl.h>
+    #include <poll.h>
 #endif
 
+namespace {
+
+void closeClient(int client_socket) {
+#ifdef _WIN32
+    closesocket(client_socket);
+#else
+    close(client_socket);
+#endif
+}
+
+int pollSockets(std::vector<pollfd>& sockets, int timeout_ms) {
+#ifdef _WIN32
+    return WSAPoll(sockets.data(), static_cast<ULONG>(sockets.size()), timeout_ms);
+#else
+    return poll(sockets.data(), static_cast<nfds_t>(sockets.size()), timeout_ms);
+#endif
+}
+
+// How often the server thread checks deadlines and whether it should stop
+const int SERVER_POLL_MS = 200;
+
+} // namespace
+
 ApiServer::ApiServer(int port) : port(port), running(false) {
     setupRoutes();
     
@@ -64,22 +93,57 @@ void ApiServer::setupRoutes() {
     routes["/api/accounts/create"] = [this](const HttpRequest& req) { return handleCreateAccount(req); };
     std::cout << "[DEBUG] Route registered: /api/accounts/create" << std::endl;
 
-    routes["/api/transactions/deposit"] = [this](const HttpRequest& req) { return handleDeposit(req); };
+    async_routes["/api/transactions/deposit"] = [this](const HttpRequest& req, Responder respond) {
+        handleDeposit(req, std::move(respond));
+    };
     std::cout << "[DEBUG] Route registered: /api/transactions/deposit" << std::endl;
 
-    routes["/api/transactions/withdraw"] = [this](const HttpRequest& req) { return handleWithdraw(req); };
+    async_routes["/api/transactions/withdraw"] = [this](const HttpRequest& req, Responder respond) {
+        handleWithdraw(req, std::move(respond));
+    };
     std::cout << "[DEBUG] Route registered: /api/transactions/withdraw" << std::endl;
 
-    routes["/api/transactions/transfer"] = [this](const HttpRequest& req) { return handleTransfer(req); };
+    async_routes["/api/transactions/transfer"] = [this](const HttpRequest& req, Responder respond) {
+        handleTransfer(req, std::move(respond));
+    };
     std::cout << "[DEBUG] Route registered: /api/transactions/transfer" << std::endl;
 
+    async_routes["/api/batch"] = [this](const HttpRequest& req, Responder respond) {
+        handleBatch(req, std::move(respond));
+    };
+    std::cout << "[DEBUG] Route registered: /api/batch" << std::endl;
+
     routes["/api/transactions"] = [this](const HttpRequest& req) { return handleGetTransactions(req); };
     std::cout << "[DEBUG] Route registered: /api/transactions" << std::endl;
 
     routes["/api/balance"] = [this](const HttpRequest& req) { return handleGetBalance(req); };
     std::cout << "[DEBUG] Route registered: /api/balance" << std::endl;
 
-    std::cout << "[DEBUG] Total routes registered: " << routes.size() << std::endl;
+    routes["/api/standing-orders"] = [this](const HttpRequest& req) { return handleGetStandingOrders(req); };
+    std::cout << "[DEBUG] Route registered: /api/standing-orders" << std::endl;
+
+    routes["/api/standing-orders/create"] = [this](const HttpRequest& req) { return handleCreateStandingOrder(req); };
+    std::cout << "[DEBUG] Route registered: /api/standing-orders/create" << std::endl;
+
+    routes["/api/standing-orders/cancel"] = [this](const HttpRequest& req) { return handleCancelStandingOrder(req); };
+    std::cout << "[DEBUG] Route registered: /api/standing-orders/cancel" << std::endl;
+
+    prefix_routes["/api/transactions/"] = [this](const HttpRequest& req) { return handleGetTransactionById(req); };
+    std::cout << "[DEBUG] Route registered: /api/transactions/{id}" << std::endl;
+
+    routes["/api/status"] = [this](const HttpRequest& req) { return handleStatus(req); };
+    std::cout << "[DEBUG] Route registered: /api/status" << std::endl;
+
+    routes["/api/promote"] = [this](const HttpRequest& req) { return handlePromote(req); };
+    std::cout << "[DEBUG] Route registered: /api/promote" << std::endl;
+
+    // Checked per request: a standby becomes writable when promoted
+    write_routes = {"/api/login", "/api/register", "/api/accounts/create",
+                    "/api/transactions/deposit", "/api/transactions/withdraw",
+                    "/api/transactions/transfer", "/api/batch",
+                    "/api/standing-orders/create", "/api/standing-orders/cancel"};
+
+    std::cout << "[DEBUG] Total routes registered: " << routes.size() + async_routes.size() << std::endl;
 }
 
 bool ApiServer::start() {
@@ -92,8 +156,9 @@ bool ApiServer::start() {
         return false;
     }
     
-    server_thread = std::thread(&ApiServer::serverLoop, this);
+    // Set first: serverLoop exits as soon as it sees running == false
     running = true;
+    server_thread = std::thread(&ApiServer::serverLoop, this);
     return true;
 }
 
@@ -150,17 +215,111 @@ void ApiServer::serverLoop() {
     
     std::cout << "Server started on port " << port << std::endl;
     
+    // Connections whose request has not fully arrived yet. Pool workers
+    // only ever see complete requests, so slow or idle clients cost a
+    // poll entry here instead of a worker.
+    struct Incoming {
+        std::string data;
+        std::chrono::steady_clock::time_point deadline;
+    };
+    std::unordered_map<int, Incoming> incoming;
+    std::vector<pollfd> sockets;
+    
     while (running) {
-        struct sockaddr_in client_addr;
-        socklen_t client_len = sizeof(client_addr);
+        sockets.clear();
+        // Stop accepting while too many connections are still being read
+        if (incoming.size() < MAX_OPEN_CONNECTIONS) {
+            pollfd listener = {};
+            listener.fd = server_socket;
+            listener.events = POLLIN;
+            sockets.push_back(listener);
+        }
+        for (const auto& connection : incoming) {
+            pollfd client = {};
+            client.fd = connection.first;
+            client.events = POLLIN;
+            sockets.push_back(client);
+        }
+        
+        if (pollSockets(sockets, SERVER_POLL_MS) < 0) {
+            continue;
+        }
         
-        int client_socket = accept(server_socket, (struct sockaddr*)&client_addr, &client_len);
-        if (client_socket >= 0) {
-            std::thread client_thread(&ApiServer::handleClient, this, client_socket);
-            client_thread.detach();
+        auto now = std::chrono::steady_clock::now();
+        for (const auto& ready : sockets) {
+            int socket_fd = static_cast<int>(ready.fd);
+            if (socket_fd == server_socket) {
+                if (!(ready.revents & POLLIN)) {
+                    continue;
+                }
+                struct sockaddr_in client_addr;
+                socklen_t client_len = sizeof(client_addr);
+                int client_socket = accept(server_socket, (struct sockaddr*)&client_addr, &client_len);
+                if (client_socket >= 0) {
+                    // Responses are sent from the pool; a client that stops
+                    // reading must not hold a worker forever either
+#ifdef _WIN32
+                    DWORD timeout_ms = CLIENT_RECEIVE_TIMEOUT_SECONDS * 1000;
+                    setsockopt(client_socket, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout_ms, sizeof(timeout_ms));
+#else
+                    struct timeval timeout;
+                    timeout.tv_sec = CLIENT_RECEIVE_TIMEOUT_SECONDS;
+                    timeout.tv_usec = 0;
+                    setsockopt(client_socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#endif
+                    incoming[client_socket].deadline = now + std::chrono::seconds(CLIENT_RECEIVE_TIMEOUT_SECONDS);
+                }
+                continue;
+            }
+            
+            auto connection = incoming.find(socket_fd);
+            if (connection == incoming.end()) {
+                continue;
+            }
+            if (now >= connection->second.deadline) {
+                std::cout << "[DEBUG] Request not received in time, closing connection" << std::endl;
+                closeClient(socket_fd);
+                incoming.erase(connection);
+                continue;
+            }
+            if (ready.revents == 0) {
+                continue;
+            }
+            
+            // Readable: this recv returns at once
+            char buffer[4096];
+            int bytes_received = recv(socket_fd, buffer, sizeof(buffer), 0);
+            if (bytes_received <= 0) {
+                std::cout << "[DEBUG] Connection closed or error" << std::endl;
+                closeClient(socket_fd);
+                incoming.erase(connection);
+                continue;
+            }
+            std::string& data = connection->second.data;
+            data.append(buffer, bytes_received);
+            
+            if (data.size() > MAX_REQUEST_BYTES) {
+                incoming.erase(connection);
+                HttpResponse response(413);
+                response.body = "{\"error\":\"Request too large\"}";
+                sendResponse(socket_fd, response);
+                continue;
+            }
+            
+            size_t length = completeRequestLength(data);
+            if (length > 0) {
+                std::string raw_request = data.substr(0, length);
+                incoming.erase(connection);
+                banking_service->getTaskPool().submit([this, socket_fd, raw_request]() {
+                    handleRequest(socket_fd, raw_request);
+                });
+            }
         }
     }
     
+    for (const auto& connection : incoming) {
+        closeClient(connection.first);
+    }
 #ifdef _WIN32
     closesocket(server_socket);
 #else
@@ -230,96 +389,42 @@ void ApiServer::serverLoop() {
 //     close(client_socket);
 // #endif
 // }
-void ApiServer::handleClient(int client_socket) {
-    std::string raw_request;
-    char buffer[4096];
-    int content_length = 0;
-    bool headers_complete = false;
-    size_t header_end_pos = 0;
-    
-    // Step 1: Read until we have complete headers
-    while (!headers_complete) {
-        memset(buffer, 0, sizeof(buffer));
-        int bytes_received = recv(client_socket, buffer, sizeof(buffer) - 1, 0);
-        
-        if (bytes_received <= 0) {
-            std::cout << "[DEBUG] Connection closed or error" << std::endl;
-#ifdef _WIN32
-            closesocket(client_socket);
-#else
-            close(client_socket);
-#endif
-            return;
-        }
-        
-        raw_request.append(buffer, bytes_received);
-        std::cout << "[DEBUG] Received " << bytes_received << " bytes, total: " << raw_request.length() << std::endl;
-        
-        // Look for end of headers
-        header_end_pos = raw_request.find("\r\n\r\n");
+size_t ApiServer::completeRequestLength(const std::string& raw_request) {
+    // Headers end at the first blank line
+    size_t header_end_pos = raw_request.find("\r\n\r\n");
+    if (header_end_pos == std::string::npos) {
+        header_end_pos = raw_request.find("\n\n");
         if (header_end_pos == std::string::npos) {
-            header_end_pos = raw_request.find("\n\n");
-            if (header_end_pos != std::string::npos) {
-                header_end_pos += 2; // Skip \n\n
-                headers_complete = true;
-            }
-        } else {
-            header_end_pos += 4; // Skip \r\n\r\n
-            headers_complete = true;
-        }
-        
-        // Extract Content-Length if headers are complete
-        if (headers_complete) {
-            size_t content_length_pos = raw_request.find("Content-Length:");
-            if (content_length_pos != std::string::npos && content_length_pos < header_end_pos) {
-                size_t start = raw_request.find(":", content_length_pos) + 1;
-                size_t end = raw_request.find("\r\n", start);
-                if (end == std::string::npos) {
-                    end = raw_request.find("\n", start);
-                }
-                
-                if (end != std::string::npos && end < raw_request.length()) {
-                    std::string length_str = raw_request.substr(start, end - start);
-                    // Trim whitespace
-                    length_str.erase(0, length_str.find_first_not_of(" \t"));
-                    length_str.erase(length_str.find_last_not_of(" \t\r\n") + 1);
-                    
-                    try {
-                        content_length = std::stoi(length_str);
-                        std::cout << "[DEBUG] Found Content-Length: " << content_length << std::endl;
-                    } catch (const std::exception& e) {
-                        std::cout << "[DEBUG] Failed to parse Content-Length: " << e.what() << std::endl;
-                        content_length = 0;
-                    }
-                }
-            }
+            return 0;
         }
+        header_end_pos += 2; // Skip \n\n
+    } else {
+        header_end_pos += 4; // Skip \r\n\r\n
     }
     
-    // Step 2: Read body if Content-Length > 0
-    if (content_length > 0) {
-        int body_bytes_received = raw_request.length() - header_end_pos;
-        std::cout << "[DEBUG] Body bytes already received: " << body_bytes_received << std::endl;
-        std::cout << "[DEBUG] Body bytes needed: " << content_length << std::endl;
+    // Then Content-Length bytes of body, if the header is there
+    size_t content_length = 0;
+    size_t content_length_pos = raw_request.find("Content-Length:");
+    if (content_length_pos != std::string::npos && content_length_pos < header_end_pos) {
+        size_t start = raw_request.find(":", content_length_pos) + 1;
+        size_t end = raw_request.find_first_of("\r\n", start);
+        std::string length_str = raw_request.substr(start, end - start);
+        length_str.erase(0, length_str.find_first_not_of(" \t"));
         
-        // Read remaining body bytes
-        while (body_bytes_received < content_length) {
-            memset(buffer, 0, sizeof(buffer));
-            int bytes_needed = content_length - body_bytes_received;
-            int bytes_to_read = std::min(bytes_needed, (int)sizeof(buffer) - 1);
-            
-            int bytes_received = recv(client_socket, buffer, bytes_to_read, 0);
-            if (bytes_received <= 0) {
-                std::cout << "[DEBUG] Failed to receive body data" << std::endl;
-                break;
-            }
-            
-            raw_request.append(buffer, bytes_received);
-            body_bytes_received += bytes_received;
-            std::cout << "[DEBUG] Received additional " << bytes_received << " body bytes, total body: " << body_bytes_received << std::endl;
+        // A malformed length reads as no body, as before
+        if (!length_str.empty() && length_str.size() <= 9 &&
+            length_str.find_first_not_of("0123456789") == std::string::npos) {
+            content_length = std::stoul(length_str);
         }
     }
     
+    if (raw_request.size() < header_end_pos + content_length) {
+        return 0;
+    }
+    return header_end_pos + content_length;
+}
+
+void ApiServer::handleRequest(int client_socket, const std::string& raw_request) {
     std::cout << "[DEBUG] Final request size: " << raw_request.length() << std::endl;
     std::cout << "[DEBUG] Raw request received:" << std::endl;
     std::cout << raw_request << std::endl;
@@ -333,15 +438,53 @@ void ApiServer::handleClient(int client_socket) {
     
     HttpResponse response;
     
+    // Balance changes are answered from the service's worker pool, so this
+    // thread does not wait on the commit; the responder closes the socket
+    auto async_route = async_routes.find(request.path);
+    if (request.method != "OPTIONS" && async_route != async_routes.end()) {
+        if (banking_service->isReadOnly()) {
+            response.status_code = 403;
+            response.body = "{\"error\":\"Read-only node\"}";
+            sendResponse(client_socket, response);
+            return;
+        }
+        try {
+            async_route->second(request, [this, client_socket](const HttpResponse& completed) {
+                sendResponse(client_socket, completed);
+            });
+        } catch (const std::exception& e) {
+            response.status_code = 500;
+            response.body = "{\"error\":\"Internal server error: " + std::string(e.what()) + "\"}";
+            sendResponse(client_socket, response);
+        }
+        return;
+    }
+    
     if (request.method == "OPTIONS") {
         response = handleOptions(request);
     } else {
         std::cout << "[DEBUG] Looking for route: '" << request.path << "'" << std::endl;
         
+        const std::function<HttpResponse(const HttpRequest&)>* handler = nullptr;
         auto it = routes.find(request.path);
         if (it != routes.end()) {
+            handler = &it->second;
+        } else {
+            for (const auto& prefix : prefix_routes) {
+                if (request.path.size() > prefix.first.size() &&
+                    request.path.compare(0, prefix.first.size(), prefix.first) == 0) {
+                    handler = &prefix.second;
+                    break;
+                }
+            }
+        }
+        
+        if (handler && write_routes.count(request.path) && banking_service->isReadOnly()) {
+            response.status_code = 403;
+            response.body = "{\"error\":\"Read-only node\"}";
+        } else if (handler) {
             try {
-                response = it->second(request);
+                response = (*handler)(request);
             } catch (const std::exception& e) {
                 response.status_code = 500;
                 response.body = "{\"error\":\"Internal server error: " + std::string(e.what()) + "\"}";
@@ -352,6 +495,10 @@ void ApiServer::handleClient(int client_socket) {
         }
     }
     
+    sendResponse(client_socket, response);
+}
+
+void ApiServer::sendResponse(int client_socket, const HttpResponse& response) {
     std::string response_str = serializeResponse(response);
     send(client_socket, response_str.c_str(), response_str.length(), 0);
     
@@ -555,8 +702,13 @@ std::string ApiServer::serializeResponse(const HttpResponse& response) {
         case 204: stream << "No Content"; break;
         case 400: stream << "Bad Request"; break;
         case 401: stream << "Unauthorized"; break;
+        case 403: stream << "Forbidden"; break;
         case 404: stream << "Not Found"; break;
         case 405: stream << "Method Not Allowed"; break;
+        case 409: stream << "Conflict"; break;
+        case 412: stream << "Precondition Failed"; break;
+        case 413: stream << "Payload Too Large"; break;
+        case 422: stream << "Unprocessable Entity"; break;
         case 500: stream << "Internal Server Error"; break;
         default: stream << "Unknown"; break;
     }
@@ -566,7 +718,8 @@ std::string ApiServer::serializeResponse(const HttpResponse& response) {
     stream << "Access-Control-Allow-Origin: *\r\n";
 
     stream << "Access-Control-Allow-Methods: GET, POST, PUT, DELETE, OPTIONS\r\n";
-    stream << "Access-Control-Allow-Headers: Content-Type, Authorization, Accept, Origin, X-Requested-With\r\n";
+    stream << "Access-Control-Allow-Headers: Content-Type, Authorization, Accept, Origin, X-Requested-With, If-Match, Idempotency-Key, X-Replication-Secret\r\n";
+    stream << "Access-Control-Expose-Headers: ETag, Idempotent-Replayed\r\n";
     stream << "Access-Control-Allow-Credentials: true\r\n";
     stream << "Access-Control-Max-Age: 86400\r\n";
     stream << "Content-Type: application/json\r\n";
@@ -632,7 +785,175 @@ std::string ApiServer::urlDecode(const std::string& str) {
     return result;
 }
 
+std::string ApiServer::etag(uint64_t version) {
+    return "\"" + std::to_string(version) + "\"";
+}
+
+uint64_t ApiServer::ifMatchVersion(const HttpRequest& request) {
+    for (const auto& header : request.headers) {
+        std::string name = header.first;
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        if (name != "if-match") {
+            continue;
+        }
+        
+        // Accepts "7", W/"7" and a bare 7
+        std::string digits;
+        for (char c : header.second) {
+            if (std::isdigit(static_cast<unsigned char>(c))) {
+                digits += c;
+            }
+        }
+        return digits.empty() ? 0 : std::stoull(digits);
+    }
+    return 0;
+}
+
+void ApiServer::runIdempotent(const HttpRequest& request, const Responder& respond,
+                              std::function<HttpResponse(const TransactionResult& result)> answer,
+                              const std::function<void(const std::string& idempotency_key,
+                                                       ResultCallback)>& start) {
+    std::string key;
+    bool has_key = false;
+    for (const auto& header : request.headers) {
+        std::string name = header.first;
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        if (name == "idempotency-key") {
+            key = header.second;
+            has_key = true;
+            break;
+        }
+    }
+    if (!has_key) {
+        start("", [answer, respond](const TransactionResult& result) {
+            respond(answer(result));
+        });
+        return;
+    }
+    
+    // Keys are stored as the first CSV column: visible ASCII, no commas
+    bool valid = !key.empty() && key.size() <= MAX_IDEMPOTENCY_KEY_LENGTH;
+    for (char c : key) {
+        if (c < '!' || c > '~' || c == ',') {
+            valid = false;
+        }
+    }
+    if (!valid) {
+        HttpResponse response(400);
+        response.body = "{\"error\":\"Invalid Idempotency-Key\"}";
+        respond(response);
+        return;
+    }
+    
+    // The same key must come with the same request (FNV-1a of path and body)
+    uint64_t hash = 14695981039346656037ull;
+    for (const std::string* part : {&request.path, &request.body}) {
+        for (unsigned char c : *part) {
+            hash = (hash ^ c) * 1099511628211ull;
+        }
+        hash = (hash ^ 0) * 1099511628211ull;
+    }
+    std::ostringstream fingerprint;
+    fingerprint << std::hex << std::setw(16) << std::setfill('0') << hash;
+    
+    TransactionResult original;
+    switch (banking_service->claimIdempotencyKey(key, fingerprint.str(), original)) {
+        case IdempotencyClaim::REPEAT: {
+            HttpResponse response = answer(original);
+            response.headers["Idempotent-Replayed"] = "true";
+            respond(response);
+            return;
+        }
+        case IdempotencyClaim::IN_PROGRESS: {
+            HttpResponse response(409);
+            response.body = "{\"error\":\"A request with this Idempotency-Key is still in progress\"}";
+            respond(response);
+            return;
+        }
+        case IdempotencyClaim::MISMATCH: {
+            HttpResponse response(422);
+            response.body = "{\"error\":\"Idempotency-Key was already used for a different request\"}";
+            respond(response);
+            return;
+        }
+        case IdempotencyClaim::FIRST:
+            break;
+    }
+    
+    try {
+        start(key, [this, key, answer, respond](const TransactionResult& result) {
+            banking_service->finishIdempotencyKey(key, result);
+            respond(answer(result));
+        });
+    } catch (...) {
+        banking_service->finishIdempotencyKey(key, TransactionResult());
+        throw;
+    }
+}
+
 // Improved JSON parsing function
+std::vector<std::map<std::string, std::string>> ApiServer::extractJsonObjects(const std::string& json,
+                                                                             const std::string& field) {
+    std::vector<std::map<std::string, std::string>> objects;
+    size_t pos = json.find("\"" + field + "\"");
+    if (pos == std::string::npos) {
+        return objects;
+    }
+    pos = json.find('[', pos);
+    if (pos == std::string::npos) {
+        return objects;
+    }
+    
+    // One pass over the array; values are kept as raw text (strings unquoted,
+    // escapes taken literally), which is all the flat batch items need
+    std::map<std::string, std::string> current;
+    std::string token;
+    std::string key;
+    bool in_object = false;
+    bool in_string = false;
+    bool have_key = false;
+    for (size_t i = pos + 1; i < json.size(); ++i) {
+        char c = json[i];
+        if (in_string) {
+            if (c == '\\' && i + 1 < json.size()) {
+                token += json[++i];
+            } else if (c == '"') {
+                in_string = false;
+            } else {
+                token += c;
+            }
+            continue;
+        }
+        if (c == '"') {
+            in_string = true;
+        } else if (c == '{') {
+            in_object = true;
+            current.clear();
+            token.clear();
+            have_key = false;
+        } else if (c == ':' && in_object) {
+            key = token;
+            token.clear();
+            have_key = true;
+        } else if ((c == ',' || c == '}') && in_object) {
+            if (have_key) {
+                current[key] = token;
+            }
+            token.clear();
+            have_key = false;
+            if (c == '}') {
+                objects.push_back(current);
+                in_object = false;
+            }
+        } else if (c == ']' && !in_object) {
+            break;
+        } else if (in_object && !std::isspace(static_cast<unsigned char>(c))) {
+            token += c;
+        }
+    }
+    return objects;
+}
+
 std::string ApiServer::extractJsonField(const std::string& json, const std::string& field) {
     // Remove all whitespace for easier parsing
     std::string clean_json = json;
@@ -1039,13 +1360,14 @@ HttpResponse ApiServer::handleCreateAccount(const HttpRequest& request) {
     return response;
 }
 
-HttpResponse ApiServer::handleDeposit(const HttpRequest& request) {
+void ApiServer::handleDeposit(const HttpRequest& request, Responder respond) {
     HttpResponse response;
     
     if (request.method != "POST") {
         response.status_code = 405;
         response.body = "{\"error\":\"Method not allowed\"}";
-        return response;
+        respond(response);
+        return;
     }
     
     try {
@@ -1053,28 +1375,39 @@ HttpResponse ApiServer::handleDeposit(const HttpRequest& request) {
         std::string amount_str = extractJsonField(request.body, "amount");
         double amount = std::stod(amount_str);
         
-        TransactionResult deposit_result = banking_service->deposit(account_number, amount);
-        if (deposit_result.success) {
-            response.body = "{\"success\":true,\"message\":\"" + deposit_result.message + "\",\"new_balance\":" + std::to_string(deposit_result.new_balance) + "}";
-        } else {
-            response.status_code = 400;
-            response.body = "{\"success\":false,\"message\":\"" + deposit_result.message + "\"}";
-        }
+        auto answer = [this](const TransactionResult& deposit_result) {
+            HttpResponse response;
+            if (deposit_result.success) {
+                if (deposit_result.account_version != 0) {
+                    response.headers["ETag"] = etag(deposit_result.account_version);
+                }
+                response.body = "{\"success\":true,\"message\":\"" + deposit_result.message + "\",\"new_balance\":" + std::to_string(deposit_result.new_balance) + "}";
+            } else {
+                response.status_code = deposit_result.version_mismatch ? 412 : 400;
+                response.body = "{\"success\":false,\"message\":\"" + deposit_result.message + "\"}";
+            }
+            return response;
+        };
+        runIdempotent(request, respond, answer, [&](const std::string& key, ResultCallback done) {
+            banking_service->depositAsync(account_number, amount, "Deposit", ifMatchVersion(request), key, done);
+        });
+        return;
     } catch (const std::exception& e) {
         response.status_code = 400;
         response.body = "{\"error\":\"Invalid request format\"}";
     }
     
-    return response;
+    respond(response);
 }
 
-HttpResponse ApiServer::handleWithdraw(const HttpRequest& request) {
+void ApiServer::handleWithdraw(const HttpRequest& request, Responder respond) {
     HttpResponse response;
     
     if (request.method != "POST") {
         response.status_code = 405;
         response.body = "{\"error\":\"Method not allowed\"}";
-        return response;
+        respond(response);
+        return;
     }
     
     try {
@@ -1082,28 +1415,39 @@ HttpResponse ApiServer::handleWithdraw(const HttpRequest& request) {
         std::string amount_str = extractJsonField(request.body, "amount");
         double amount = std::stod(amount_str);
         
-        TransactionResult withdraw_result = banking_service->withdraw(account_number, amount);
-        if (withdraw_result.success) {
-            response.body = "{\"success\":true,\"message\":\"" + withdraw_result.message + "\",\"new_balance\":" + std::to_string(withdraw_result.new_balance) + "}";
-        } else {
-            response.status_code = 400;
-            response.body = "{\"success\":false,\"message\":\"" + withdraw_result.message + "\"}";
-        }
+        auto answer = [this](const TransactionResult& withdraw_result) {
+            HttpResponse response;
+            if (withdraw_result.success) {
+                if (withdraw_result.account_version != 0) {
+                    response.headers["ETag"] = etag(withdraw_result.account_version);
+                }
+                response.body = "{\"success\":true,\"message\":\"" + withdraw_result.message + "\",\"new_balance\":" + std::to_string(withdraw_result.new_balance) + "}";
+            } else {
+                response.status_code = withdraw_result.version_mismatch ? 412 : 400;
+                response.body = "{\"success\":false,\"message\":\"" + withdraw_result.message + "\"}";
+            }
+            return response;
+        };
+        runIdempotent(request, respond, answer, [&](const std::string& key, ResultCallback done) {
+            banking_service->withdrawAsync(account_number, amount, "Withdrawal", ifMatchVersion(request), key, done);
+        });
+        return;
     } catch (const std::exception& e) {
         response.status_code = 400;
         response.body = "{\"error\":\"Invalid request format\"}";
     }
     
-    return response;
+    respond(response);
 }
 
-HttpResponse ApiServer::handleTransfer(const HttpRequest& request) {
+void ApiServer::handleTransfer(const HttpRequest& request, Responder respond) {
     HttpResponse response;
     
     if (request.method != "POST") {
         response.status_code = 405;
         response.body = "{\"error\":\"Method not allowed\"}";
-        return response;
+        respond(response);
+        return;
     }
     
     try {
@@ -1112,19 +1456,119 @@ HttpResponse ApiServer::handleTransfer(const HttpRequest& request) {
         std::string amount_str = extractJsonField(request.body, "amount");
         double amount = std::stod(amount_str);
         
-        TransactionResult transfer_result = banking_service->transfer(from_account, to_account, amount);
-        if (transfer_result.success) {
-            response.body = "{\"success\":true,\"message\":\"" + transfer_result.message + "\"}";
-        } else {
-            response.status_code = 400;
-            response.body = "{\"success\":false,\"message\":\"" + transfer_result.message + "\"}";
-        }
+        auto answer = [this](const TransactionResult& transfer_result) {
+            HttpResponse response;
+            if (transfer_result.success) {
+                if (transfer_result.account_version != 0) {
+                    response.headers["ETag"] = etag(transfer_result.account_version);
+                }
+                response.body = "{\"success\":true,\"message\":\"" + transfer_result.message + "\"}";
+            } else {
+                response.status_code = transfer_result.version_mismatch ? 412 : 400;
+                response.body = "{\"success\":false,\"message\":\"" + transfer_result.message + "\"}";
+            }
+            return response;
+        };
+        runIdempotent(request, respond, answer, [&](const std::string& key, ResultCallback done) {
+            banking_service->transferAsync(from_account, to_account, amount, "Transfer", ifMatchVersion(request),
+                                           key, done);
+        });
+        return;
     } catch (const std::exception& e) {
         response.status_code = 400;
         response.body = "{\"error\":\"Invalid request format\"}";
     }
     
-    return response;
+    respond(response);
+}
+
+// Body: {"operations":[{"type":"deposit|withdraw|transfer","account_number":"...",
+// "to_account":"...","amount":1.5,"description":"..."}, ...]}. Transfers also
+// accept from_account. Answers 200 with one result per operation, in order.
+void ApiServer::handleBatch(const HttpRequest& request, Responder respond) {
+    HttpResponse response;
+    
+    if (request.method != "POST") {
+        response.status_code = 405;
+        response.body = "{\"error\":\"Method not allowed\"}";
+        respond(response);
+        return;
+    }
+    
+    std::vector<std::map<std::string, std::string>> items = extractJsonObjects(request.body, "operations");
+    if (items.empty()) {
+        response.status_code = 400;
+        response.body = "{\"error\":\"Invalid request format\"}";
+        respond(response);
+        return;
+    }
+    if (items.size() > BankingService::MAX_BATCH_OPERATIONS) {
+        response.status_code = 413;
+        response.body = "{\"error\":\"At most " + std::to_string(BankingService::MAX_BATCH_OPERATIONS) +
+                        " operations per batch\"}";
+        respond(response);
+        return;
+    }
+    
+    // Items that do not parse are answered here; the rest go in one batch
+    std::vector<BatchOperation> operations;
+    std::vector<size_t> positions;
+    std::vector<TransactionResult> results(items.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+        auto& item = items[i];
+        BatchOperation operation;
+        const std::string& type = item["type"];
+        if (type == "deposit") {
+            operation.type = BatchOperationType::DEPOSIT;
+        } else if (type == "withdraw" || type == "withdrawal") {
+            operation.type = BatchOperationType::WITHDRAWAL;
+        } else if (type == "transfer") {
+            operation.type = BatchOperationType::TRANSFER;
+        } else {
+            results[i].message = "Unknown operation type";
+            continue;
+        }
+        
+        operation.account_number = item.count("from_account") ? item["from_account"] : item["account_number"];
+        operation.to_account = item["to_account"];
+        operation.description = item["description"];
+        try {
+            operation.amount = std::stod(item["amount"]);
+        } catch (const std::exception&) {
+            results[i].message = "Invalid amount";
+            continue;
+        }
+        operations.push_back(operation);
+        positions.push_back(i);
+    }
+    
+    banking_service->executeBatchAsync(std::move(operations),
+        [respond, positions, results](const std::vector<TransactionResult>& applied) mutable {
+            for (size_t i = 0; i < applied.size(); ++i) {
+                results[positions[i]] = applied[i];
+            }
+            
+            size_t succeeded = 0;
+            std::ostringstream body;
+            body << std::fixed << std::setprecision(2) << "{\"results\":[";
+            for (size_t i = 0; i < results.size(); ++i) {
+                const TransactionResult& result = results[i];
+                if (i > 0) {
+                    body << ",";
+                }
+                if (result.success) {
+                    succeeded++;
+                    body << "{\"success\":true,\"transaction_id\":\"" << result.transaction_id
+                         << "\",\"new_balance\":" << result.new_balance << "}";
+                } else {
+                    body << "{\"success\":false,\"message\":\"" << result.message << "\"}";
+                }
+            }
+            body << "],\"succeeded\":" << succeeded << ",\"failed\":" << (results.size() - succeeded) << "}";
+            HttpResponse response;
+            response.body = body.str();
+            respond(response);
+        });
 }
 
 HttpResponse ApiServer::handleGetTransactions(const HttpRequest& request) {
@@ -1143,23 +1587,69 @@ HttpResponse ApiServer::handleGetTransactions(const HttpRequest& request) {
         return response;
     }
     
+    // Paging: limit, offset and cursor (the next_cursor of a previous page).
+    // A page is bounded even without a limit, so a long history is never
+    // built up in one response
+    ScanOptions options;
+    options.limit = DEFAULT_TRANSACTION_PAGE;
+    try {
+        auto limit_it = request.query_params.find("limit");
+        if (limit_it != request.query_params.end()) {
+            options.limit = std::stoul(limit_it->second);
+            if (options.limit == 0 || options.limit > MAX_TRANSACTION_PAGE) {
+                options.limit = MAX_TRANSACTION_PAGE;
+            }
+        }
+        auto offset_it = request.query_params.find("offset");
+        if (offset_it != request.query_params.end()) {
+            options.offset = std::stoul(offset_it->second);
+        }
+        // days=N limits the history to the last N days (served from memory)
+        auto days_it = request.query_params.find("days");
+        if (days_it != request.query_params.end()) {
+            options.since = std::time(nullptr) - static_cast<std::time_t>(std::stoul(days_it->second)) * 24 * 3600;
+        }
+    } catch (const std::exception& e) {
+        response.status_code = 400;
+        response.body = "{\"error\":\"Invalid limit, offset or days\"}";
+        return response;
+    }
+    auto cursor_it = request.query_params.find("cursor");
+    if (cursor_it != request.query_params.end()) {
+        options.resume_token = cursor_it->second;
+    }
+    
     try {
-        auto transactions = banking_service->getAccountTransactions(it->second);
+        // Rows are serialized as they are scanned; the page limit bounds the body
         std::ostringstream json;
         json << "{\"transactions\":[";
         
-        for (size_t i = 0; i < transactions.size(); ++i) {
-            if (i > 0) json << ",";
-            json << "{";
-            json << "\"id\":\"" << transactions[i].getTransactionId() << "\",";
-            json << "\"type\":\"" << static_cast<int>(transactions[i].getType()) << "\",";
-            json << "\"amount\":" << transactions[i].getAmount() << ",";
-            json << "\"description\":\"" << transactions[i].getDescription() << "\",";
-            json << "\"timestamp\":\"" << transactions[i].getTimestamp() << "\"";
-            json << "}";
+        bool first = true;
+        ScanResult scan = banking_service->scanAccountTransactions(it->second, options,
+            [&](const Transaction& transaction) {
+                if (!first) json << ",";
+                first = false;
+                json << "{";
+                json << "\"id\":\"" << transaction.getTransactionId() << "\",";
+                json << "\"type\":\"" << static_cast<int>(transaction.getType()) << "\",";
+                json << "\"amount\":" << transaction.getAmount() << ",";
+                json << "\"description\":\"" << transaction.getDescription() << "\",";
+                json << "\"timestamp\":\"" << transaction.getTimestamp() << "\"";
+                json << "}";
+                return true;
+            });
+        
+        if (!scan.ok) {
+            response.status_code = 400;
+            response.body = "{\"error\":\"Invalid or expired cursor\"}";
+            return response;
         }
         
-        json << "]}";
+        json << "]";
+        if (scan.has_more) {
+            json << ",\"next_cursor\":\"" << scan.resume_token << "\"";
+        }
+        json << "}";
         response.body = json.str();
     } catch (const std::exception& e) {
         response.status_code = 500;
@@ -1169,6 +1659,28 @@ HttpResponse ApiServer::handleGetTransactions(const HttpRequest& request) {
     return response;
 }
 
+HttpResponse ApiServer::handleGetTransactionById(const HttpRequest& request) {
+    HttpResponse response;
+    
+    if (request.method != "GET") {
+        response.status_code = 405;
+        response.body = "{\"error\":\"Method not allowed\"}";
+        return response;
+    }
+    
+    std::string transaction_id = urlDecode(request.path.substr(std::string("/api/transactions/").size()));
+    
+    Transaction transaction;
+    if (banking_service->getTransaction(transaction_id, transaction)) {
+        response.body = transaction.toJson();
+    } else {
+        response.status_code = 404;
+        response.body = "{\"error\":\"Transaction not found\"}";
+    }
+    
+    return response;
+}
+
 HttpResponse ApiServer::handleGetBalance(const HttpRequest& request) {
     HttpResponse response;
     
@@ -1186,9 +1698,11 @@ HttpResponse ApiServer::handleGetBalance(const HttpRequest& request) {
     }
     
     try {
-        double balance;
-        if (banking_service->getAccountBalance(it->second, balance)) {
-            response.body = "{\"balance\":" + std::to_string(balance) + "}";
+        // The account version doubles as the ETag for If-Match on writes
+        Account account;
+        if (banking_service->getAccountInfo(it->second, account)) {
+            response.headers["ETag"] = etag(account.getVersion());
+            response.body = "{\"balance\":" + std::to_string(account.getBalance()) + "}";
         } else {
             response.status_code = 404;
             response.body = "{\"error\":\"Account not found\"}";
@@ -1201,9 +1715,144 @@ HttpResponse ApiServer::handleGetBalance(const HttpRequest& request) {
     return response;
 }
 
+// Body: {"from_account":"...","to_account":"...","amount":1200,
+// "frequency":"DAILY|WEEKLY|MONTHLY","first_run":<unix time, optional>,
+// "description":"..."}
+HttpResponse ApiServer::handleCreateStandingOrder(const HttpRequest& request) {
+    HttpResponse response;
+    
+    if (request.method != "POST") {
+        response.status_code = 405;
+        response.body = "{\"error\":\"Method not allowed\"}";
+        return response;
+    }
+    
+    try {
+        std::string from_account = extractJsonField(request.body, "from_account");
+        std::string to_account = extractJsonField(request.body, "to_account");
+        double amount = std::stod(extractJsonField(request.body, "amount"));
+        std::string frequency = extractJsonField(request.body, "frequency");
+        std::string first_run_str = extractJsonField(request.body, "first_run");
+        std::time_t first_run = first_run_str.empty() ? 0 : static_cast<std::time_t>(std::stoll(first_run_str));
+        std::string description = extractJsonField(request.body, "description");
+        
+        StandingOrderResult create_result = banking_service->createStandingOrder(
+            from_account, to_account, amount, frequency, first_run, description);
+        if (create_result.success) {
+            response.body = "{\"success\":true,\"message\":\"" + create_result.message +
+                            "\",\"standing_order\":" + create_result.order.toJson() + "}";
+        } else {
+            response.status_code = 400;
+            response.body = "{\"success\":false,\"message\":\"" + create_result.message + "\"}";
+        }
+    } catch (const std::exception& e) {
+        response.status_code = 400;
+        response.body = "{\"error\":\"Invalid request format\"}";
+    }
+    
+    return response;
+}
+
+HttpResponse ApiServer::handleCancelStandingOrder(const HttpRequest& request) {
+    HttpResponse response;
+    
+    if (request.method != "POST") {
+        response.status_code = 405;
+        response.body = "{\"error\":\"Method not allowed\"}";
+        return response;
+    }
+    
+    std::string order_id = extractJsonField(request.body, "order_id");
+    StandingOrderResult cancel_result = banking_service->cancelStandingOrder(order_id);
+    if (cancel_result.success) {
+        response.body = "{\"success\":true,\"message\":\"" + cancel_result.message +
+                        "\",\"standing_order\":" + cancel_result.order.toJson() + "}";
+    } else {
+        response.status_code = 404;
+        response.body = "{\"success\":false,\"message\":\"" + cancel_result.message + "\"}";
+    }
+    
+    return response;
+}
+
+// Orders paying from or into the account, cancelled ones included
+HttpResponse ApiServer::handleGetStandingOrders(const HttpRequest& request) {
+    HttpResponse response;
+    
+    if (request.method != "GET") {
+        response.status_code = 405;
+        response.body = "{\"error\":\"Method not allowed\"}";
+        return response;
+    }
+    
+    auto it = request.query_params.find("account_number");
+    if (it == request.query_params.end()) {
+        response.status_code = 400;
+        response.body = "{\"error\":\"Account number parameter required\"}";
+        return response;
+    }
+    
+    std::ostringstream json;
+    json << "{\"standing_orders\":[";
+    bool first = true;
+    for (const auto& order : banking_service->getStandingOrders(it->second)) {
+        if (!first) json << ",";
+        json << order.toJson();
+        first = false;
+    }
+    json << "]}";
+    response.body = json.str();
+    
+    return response;
+}
+
+HttpResponse ApiServer::handleStatus(const HttpRequest& request) {
+    HttpResponse response;
+    
+    if (request.method != "GET") {
+        response.status_code = 405;
+        response.body = "{\"error\":\"Method not allowed\"}";
+        return response;
+    }
+    
+    response.body = banking_service->getSystemStatus();
+    return response;
+}
+
 HttpResponse ApiServer::handleOptions(const HttpRequest& request) {
     HttpResponse response;
     response.status_code = 204;
     response.body = "";
     return response;
 }
+
+HttpResponse ApiServer::handlePromote(const HttpRequest& request) {
+    HttpResponse response;
+    
+    if (request.method != "POST") {
+        response.status_code = 405;
+        response.body = "{\"error\":\"Method not allowed\"}";
+        return response;
+    }
+    
+    // Only whoever runs the replication pair may promote: the request
+    // carries the secret the standby shares with its primary
+    std::string secret;
+    for (const auto& header : request.headers) {
+        std::string name = header.first;
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        if (name == "x-replication-secret") {
+            secret = header.second;
+        }
+    }
+    
+    std::string message;
+    if (!banking_service->promote(secret, message)) {
+        response.status_code = message == "Wrong replication secret" ? 403 : 409;
+        response.body = "{\"error\":\"" + message + "\"}";
+        return response;
+    }
+    
+    response.body = "{\"message\":\"Promoted to primary\"}";
+    return response;
+}
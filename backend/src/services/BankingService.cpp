@@ -4,15 +4,161 @@
 #include <sstream>
 #include <iomanip>
 #include <functional>
+#include <algorithm>
 #include <random>
 #include <chrono>
+#include <unordered_set>
+#include <set>
+#include <map>
+#include <thread>
+#include <future>
+#include <ctime>
+#include <cmath>
 
-BankingService::BankingService(const std::string& data_directory) {
+BankingService::BankingService(const std::string& data_directory, size_t shard_count, size_t worker_threads) {
     std::cout << "Creating BankingService with data directory: " << data_directory << std::endl;
-    database = std::make_unique<Database>(data_directory);
+    database = std::make_unique<Database>(data_directory, shard_count);
+    task_pool = std::make_unique<TaskPool>(worker_threads);
+    database->setTaskPool(task_pool.get());
     std::cout << "BankingService constructor completed." << std::endl;
 }
 
+bool BankingService::initializeReplica(const std::string& primary_directory) {
+    std::cout << "Initializing read replica of " << primary_directory << std::endl;
+    replica = std::make_unique<ReplicaStore>(primary_directory);
+    if (!replica->start()) {
+        replica.reset();
+        return false;
+    }
+    return true;
+}
+
+bool BankingService::initializeStandby(const std::string& bind_address, int standby_port,
+                                       const std::string& secret) {
+    std::cout << "Initializing warm standby on port " << standby_port << std::endl;
+    if (!database->initialize()) {
+        std::cout << "Database initialization failed!" << std::endl;
+        return false;
+    }
+    
+    // The primary's snapshot replaces whatever is here on first connect
+    read_only = true;
+    standby = std::make_unique<StandbyReceiver>(*database, bind_address, standby_port, secret);
+    if (!standby->start()) {
+        standby.reset();
+        return false;
+    }
+    return true;
+}
+
+void BankingService::configureTiering(long long hot_window_seconds, std::uintmax_t hot_max_bytes) {
+    database->setTieringPolicy(static_cast<std::time_t>(hot_window_seconds), hot_max_bytes);
+}
+
+bool BankingService::configureLogShipping(const std::string& host, int port, const std::string& secret,
+                                          bool synchronous) {
+    if (replica || standby) {
+        std::cout << "Log shipping needs a primary" << std::endl;
+        return false;
+    }
+    
+    log_shipper = std::make_unique<LogShipper>(*database, host, port, secret, synchronous);
+    database->setLogShipper(log_shipper.get());
+    log_shipper->start();
+    return true;
+}
+
+bool BankingService::promote(const std::string& secret, std::string& message) {
+    std::lock_guard<std::mutex> lock(promote_mutex);
+    
+    if (!standby || !read_only) {
+        message = "Not an unpromoted standby";
+        return false;
+    }
+    if (!standby->checkSecret(secret)) {
+        message = "Wrong replication secret";
+        return false;
+    }
+    if (standby->getStatus().snapshotting) {
+        message = "A snapshot from the primary is still being received";
+        return false;
+    }
+    
+    // Once the receiver is gone the old primary cannot reach us any more;
+    // everything it got acknowledged is already in our files. A snapshot
+    // that began since the check above is dropped by stop()
+    standby->stop();
+    settlePendingTransfers();
+    rebuildDailyLimits();
+    rebuildIdempotencyKeys();
+    read_only = false;
+    enableScheduler();
+    
+    logActivity("SYSTEM", "Standby promoted to primary at record " +
+                std::to_string(standby->getStatus().applied_seq));
+    std::cout << "Standby promoted to primary" << std::endl;
+    return true;
+}
+
+void BankingService::setConcurrencyMode(ConcurrencyMode mode) {
+    concurrency_mode = mode;
+}
+
+bool BankingService::enableLedger() {
+    if (replica || standby) {
+        std::cout << "The balance ledger needs a primary" << std::endl;
+        return false;
+    }
+    if (executors) {
+        std::cout << "The balance ledger cannot be used with account executors" << std::endl;
+        return false;
+    }
+    
+    ledger = std::make_unique<BalanceLedger>(*database);
+    ledger->setVelocityCounters(&velocity);
+    ledger->start();
+    return true;
+}
+
+bool BankingService::enableScheduler() {
+    if (replica || isReadOnly()) {
+        std::cout << "Standing orders need a primary" << std::endl;
+        return false;
+    }
+    if (scheduler) {
+        return true;
+    }
+    
+    scheduler = std::make_unique<StandingOrderScheduler>(*this, *database);
+    if (!scheduler->start()) {
+        scheduler.reset();
+        return false;
+    }
+    return true;
+}
+
+bool BankingService::flushLedger() {
+    return !ledger || ledger->flush();
+}
+
+bool BankingService::enableExecutors(size_t executor_count) {
+    if (replica || standby) {
+        std::cout << "Account executors need a primary" << std::endl;
+        return false;
+    }
+    if (ledger) {
+        std::cout << "Account executors cannot be used with the balance ledger" << std::endl;
+        return false;
+    }
+    
+    executors = std::make_unique<AccountExecutors>(executor_count);
+    return true;
+}
+
+bool BankingService::isReadOnly() const {
+    return replica != nullptr || read_only;
+}
+
 bool BankingService::initialize() {
     std::cout << "Initializing database..." << std::endl;
     if (!database->initialize()) {
@@ -28,6 +174,10 @@ bool BankingService::initialize() {
         std::cout << "Sample data created." << std::endl;
     }
     
+    settlePendingTransfers();
+    rebuildDailyLimits();
+    rebuildIdempotencyKeys();
+    
     std::cout << "BankingService initialization completed." << std::endl;
     return true;
 }
@@ -52,6 +202,56 @@ bool BankingService::verifyPassword(const std::string& password, const std::stri
     return hashPassword(password) == hash;
 }
 
+bool BankingService::reserveDailyLimit(const Account& account, double amount, std::time_t now) {
+    return velocity.reserve(account.getAccountNumber(), std::llround(amount * 100.0),
+                            std::llround(account.getDailyLimit() * 100.0), now);
+}
+
+void BankingService::releaseDailyLimit(const std::string& account_number, double amount, std::time_t at) {
+    velocity.release(account_number, std::llround(amount * 100.0), at);
+}
+
+void BankingService::rebuildIdempotencyKeys() {
+    std::vector<IdempotencyRecord> records;
+    std::string header;
+    database->scanLiveRows("idempotency", 0, header, [&](const std::string& row) {
+        IdempotencyRecord record;
+        if (record.fromCsvRow(row)) {
+            records.push_back(record);
+        }
+        return true;
+    });
+    
+    // Restored oldest first, so they expire in the order they were made
+    std::sort(records.begin(), records.end(), [](const IdempotencyRecord& a, const IdempotencyRecord& b) {
+        return a.created_at < b.created_at;
+    });
+    idempotency.clear();
+    std::time_t now = std::time(nullptr);
+    for (const auto& record : records) {
+        idempotency.restore(record, now);
+    }
+    std::cout << "[DEBUG] Idempotency keys restored: " << idempotency.getStats().keys << std::endl;
+}
+
+void BankingService::rebuildDailyLimits() {
+    velocity.clear();
+    
+    // Recent rows are normally still in the hot tier, so this reads no files
+    ScanOptions options;
+    options.since = std::time(nullptr) - VelocityCounters::WINDOW_SECONDS;
+    size_t debits = 0;
+    database->scanTransactions([](const Transaction& transaction) {
+        return transaction.getStatus() == TransactionStatus::COMPLETED && !transaction.getFromAccountId().empty();
+    }, options, [&](const Transaction& transaction) {
+        velocity.record(transaction.getFromAccountId(), std::llround(transaction.getAmount() * 100.0),
+                        std::chrono::system_clock::to_time_t(transaction.getTimePoint()));
+        debits++;
+        return true;
+    });
+    std::cout << "[DEBUG] Daily limits rebuilt from " << debits << " debits" << std::endl;
+}
+
 bool BankingService::validateAmount(double amount) {
     return amount > 0 && amount <= 1000000; // Max transaction limit
 }
@@ -71,11 +271,17 @@ void BankingService::logActivity(const std::string& user_id, const std::string&
 
 // Authentication and User Management
 AuthResult BankingService::authenticateUser(const std::string& username, const std::string& password) {
-    std::lock_guard<std::mutex> lock(service_mutex);
+    // Logins update the user row (failed attempts, last login)
+    std::lock_guard<std::mutex> lock(users_mutex);
     
     AuthResult result;
     result.success = false;
     
+    if (isReadOnly()) {
+        result.message = "Read-only node";
+        return result;
+    }
+    
     User user;
     if (!database->loadUserByUsername(username, user)) {
         result.message = "User not found";
@@ -109,11 +315,16 @@ AuthResult BankingService::authenticateUser(const std::string& username, const s
 AuthResult BankingService::registerUser(const std::string& username, const std::string& password,
                                        const std::string& email, const std::string& full_name,
                                        const std::string& phone) {
-    std::lock_guard<std::mutex> lock(service_mutex);
+    std::lock_guard<std::mutex> lock(users_mutex);
     
     AuthResult result;
     result.success = false;
     
+    if (isReadOnly()) {
+        result.message = "Read-only node";
+        return result;
+    }
+    
     if (database->userExists(username)) {
         result.message = "Username already exists";
         return result;
@@ -144,6 +355,10 @@ AuthResult BankingService::registerUser(const std::string& username, const std::
 bool BankingService::getUserByUsername(const std::string& username, User& user) {
     std::cout << "[DEBUG] BankingService::getUserByUsername called for: " << username << std::endl;
     
+    if (replica) {
+        return replica->loadUserByUsername(username, user);
+    }
+    
     std::cout << "[DEBUG] Calling database->loadUserByUsername (no mutex)" << std::endl;
     bool result = database->loadUserByUsername(username, user);
     std::cout << "[DEBUG] loadUserByUsername result: " << (result ? "SUCCESS" : "FAILED") << std::endl;
@@ -249,12 +464,18 @@ AccountCreationResult BankingService::createAccount(const std::string& user_id,
     std::cout << "[DEBUG] === createAccount START ===" << std::endl;
     std::cout << "[DEBUG] Parameters: user_id=" << user_id << ", account_type=" << account_type << ", initial_deposit=" << initial_deposit << std::endl;
     
-    std::lock_guard<std::mutex> lock(service_mutex);
+    // The new account number is added to the user row
+    std::lock_guard<std::mutex> lock(users_mutex);
     std::cout << "[DEBUG] Mutex acquired in createAccount" << std::endl;
     
     AccountCreationResult result;
     result.success = false;
     
+    if (isReadOnly()) {
+        result.message = "Read-only node";
+        return result;
+    }
+    
     // Validate user ID
     if (!validateUserId(user_id)) {
         result.message = "Invalid user ID";
@@ -333,197 +554,1178 @@ AccountCreationResult BankingService::createAccount(const std::string& user_id,
     return result;
 }
 std::vector<Account> BankingService::getUserAccounts(const std::string& user_id) {
-    std::lock_guard<std::mutex> lock(service_mutex);
+    if (replica) {
+        return replica->getAccountsByCustomerId(user_id);
+    }
+    
     return database->getAccountsByCustomerId(user_id);
 }
 
 // Transaction Operations
-TransactionResult BankingService::deposit(const std::string& account_number, double amount,
-                                         const std::string& description) {
-    std::lock_guard<std::mutex> lock(service_mutex);
+TransactionResult BankingService::runBalanceChange(const std::string& first_account,
+                                                   const std::string& second_account,
+                                                   const BalanceAttempt& attempt) {
+    if (executors) {
+        // transfer() sends changes spanning two owners elsewhere
+        return runOnOwner(first_account, attempt);
+    }
     
     TransactionResult result;
-    result.success = false;
     
-    if (!validateAmount(amount)) {
-        result.message = "Invalid amount";
-        return result;
+    if (concurrency_mode == ConcurrencyMode::OPTIMISTIC) {
+        // No locks across the I/O; the version check in the commit catches
+        // a writer that got in between, and the change is recomputed
+        for (int tries = 0; tries < MAX_OPTIMISTIC_ATTEMPTS; ++tries) {
+            result = TransactionResult();
+            if (attempt(result)) {
+                return result;
+            }
+            optimistic_conflicts++;
+            std::this_thread::sleep_for(std::chrono::microseconds(50 << tries));
+        }
+        // A hot account: queue on its lock rather than keep losing the race
+        optimistic_fallbacks++;
     }
     
-    Account account;
+    // Held until the new balances and their transaction are written
+    auto account_lock = second_account.empty()
+        ? std::make_pair(account_locks.lock(first_account), std::unique_lock<std::mutex>())
+        : account_locks.lockPair(first_account, second_account);
+    
+    // Optimistic writers do not take the locks, so a conflict is still possible
+    for (int tries = 0; tries < MAX_OPTIMISTIC_ATTEMPTS; ++tries) {
+        result = TransactionResult();
+        if (attempt(result)) {
+            return result;
+        }
+        optimistic_conflicts++;
+    }
+    result.message = "Account is busy, try again";
+    return result;
+}
+
+TransactionResult BankingService::runOnOwner(const std::string& account_number, const BalanceAttempt& attempt) {
+    auto done = std::make_shared<std::promise<TransactionResult>>();
+    std::future<TransactionResult> outcome = done->get_future();
+    
+    // The caller waits for the outcome, so the attempt can be run by reference
+    executors->submit(executors->ownerOf(account_number), [this, &attempt, done]() {
+        TransactionResult result;
+        bool reread = false;
+        // Only the owner writes its accounts; a conflict means a write from
+        // outside the executors (a new account's first row, say)
+        for (int tries = 0; tries < MAX_OPTIMISTIC_ATTEMPTS; ++tries) {
+            result = TransactionResult();
+            if (attempt(result)) {
+                // A refusal may rest on copies such a write has made stale
+                if (!result.success && !reread && executors->forgetServed()) {
+                    reread = true;
+                    continue;
+                }
+                done->set_value(result);
+                return;
+            }
+            optimistic_conflicts++;
+        }
+        result.message = "Account is busy, try again";
+        done->set_value(result);
+    });
+    return outcome.get();
+}
+
+bool BankingService::loadForChange(const std::string& account_number, Account& account) {
+    if (executors && executors->cachedAccount(account_number, account)) {
+        return true;
+    }
     if (!database->loadAccount(account_number, account)) {
-        result.message = "Account not found";
+        return false;
+    }
+    if (executors) {
+        executors->cacheAccount(account);
+    }
+    return true;
+}
+
+CommitResult BankingService::commitChange(const std::vector<Account>& accounts, const Transaction& transaction,
+                                          const std::string& idempotency_key,
+                                          const std::string& idempotency_row) {
+    CommitResult committed = database->commitAccountTransaction(accounts, transaction, idempotency_key,
+                                                                idempotency_row);
+    if (!executors) {
+        return committed;
+    }
+    for (const auto& account : accounts) {
+        if (committed != CommitResult::COMMITTED) {
+            executors->forgetAccount(account.getAccountNumber());
+            continue;
+        }
+        // Kept as the row reads back, rounding included
+        Account next = account;
+        next.setVersion(account.getVersion() + 1);
+        Account stored;
+        if (stored.fromCsvRow(next.toCsvRow())) {
+            executors->cacheAccount(stored);
+        } else {
+            executors->forgetAccount(account.getAccountNumber());
+        }
+    }
+    return committed;
+}
+
+// Two owners: the source's executor debits the account and records the
+// transfer as PENDING, then hands the credit to the destination's executor,
+// which credits the account and marks the record COMPLETED in one commit.
+// If the credit cannot be applied the destination hands a refund back,
+// which marks the record FAILED in the same commit as the refund. No
+// executor ever waits for another; a record left PENDING by a crash is
+// settled on the next start (see settlePendingTransfers).
+TransactionResult BankingService::transferAcrossExecutors(const std::string& from_account,
+                                                          const std::string& to_account, double amount,
+                                                          const std::string& description,
+                                                          uint64_t expected_version,
+                                                          const std::string& idempotency_key) {
+    auto done = std::make_shared<std::promise<TransactionResult>>();
+    std::future<TransactionResult> outcome = done->get_future();
+    
+    executors->submit(executors->ownerOf(from_account), [=]() {
+        TransactionResult result;
+        Transaction transaction(from_account, to_account, amount, TransactionType::TRANSFER, description);
+        std::string key_row;
+        std::time_t reserved_at = 0;
+        std::string customer_id;
+        bool debited = false;
+        bool reread = false;
+        
+        // A refusal may rest on a cached copy of the source made stale by a
+        // write from outside the executors; that is read again first
+        auto refuse = [&](const std::string& message) {
+            if (!reread && executors->forgetServed()) {
+                reread = true;
+                return false;
+            }
+            result.message = message;
+            done->set_value(result);
+            return true;
+        };
+        
+        // Only the owner writes the source; a conflict means a write from
+        // outside the executors, so the debit is simply tried again
+        for (int tries = 0; tries < MAX_OPTIMISTIC_ATTEMPTS && !debited; ++tries) {
+            result = TransactionResult();
+            Account from_acc, to_acc;
+            if (!loadForChange(from_account, from_acc) || !loadForChange(to_account, to_acc)) {
+                if (refuse("One or both accounts not found")) return;
+                continue;
+            }
+            
+            if (expected_version != 0 && from_acc.getVersion() != expected_version) {
+                result.version_mismatch = true;
+                if (refuse("Account has changed")) return;
+                continue;
+            }
+            
+            if (!from_acc.isActive() || !to_acc.isActive()) {
+                if (refuse("One or both accounts are not active")) return;
+                continue;
+            }
+            
+            if (!from_acc.canWithdraw(amount)) {
+                if (refuse("Insufficient funds or exceeds daily limit")) return;
+                continue;
+            }
+            reserved_at = std::time(nullptr);
+            if (!reserveDailyLimit(from_acc, amount, reserved_at)) {
+                if (refuse("Exceeds daily limit")) return;
+                continue;
+            }
+            
+            double from_balance_before = from_acc.getBalance();
+            from_acc.withdraw(amount);
+            
+            transaction.setStatus(TransactionStatus::PENDING);
+            transaction.setBalanceBefore(from_balance_before);
+            transaction.setBalanceAfter(from_acc.getBalance());
+            
+            key_row = idempotencyRow(idempotency_key, transaction, from_acc, "Transfer successful");
+            CommitResult committed = commitChange({from_acc}, transaction, key_row.empty() ? "" : idempotency_key,
+                                                  key_row);
+            if (committed != CommitResult::COMMITTED) {
+                releaseDailyLimit(from_account, amount, reserved_at);
+            }
+            if (committed == CommitResult::CONFLICT) {
+                optimistic_conflicts++;
+                continue;
+            }
+            if (committed == CommitResult::FAILED) {
+                result.message = "Transfer failed";
+                done->set_value(result);
+                return;
+            }
+            debited = true;
+            customer_id = from_acc.getCustomerId();
+            
+            result.success = true;
+            result.transaction_id = transaction.getTransactionId();
+            result.new_balance = from_acc.getBalance();
+            result.account_version = from_acc.getVersion() + 1;
+            result.message = "Transfer successful";
+        }
+        if (!debited) {
+            result.message = "Account is busy, try again";
+            done->set_value(result);
+            return;
+        }
+        cross_executor_transfers++;
+        
+        executors->submit(executors->ownerOf(to_account), [=]() {
+            Transaction completed = transaction;
+            completed.setStatus(TransactionStatus::COMPLETED);
+            bool reread = false;
+            for (int tries = 0; tries < MAX_OPTIMISTIC_ATTEMPTS; ++tries) {
+                Account credited;
+                if (!loadForChange(to_account, credited) || !credited.isActive() || !credited.deposit(amount)) {
+                    // Check the files before refunding on the word of a cached copy
+                    if (!reread && executors->forgetServed()) {
+                        reread = true;
+                        continue;
+                    }
+                    break;
+                }
+                CommitResult committed = commitChange({credited}, completed);
+                if (committed == CommitResult::COMMITTED) {
+                    logActivity(customer_id, "Transfer: $" + std::to_string(amount) + " from " + from_account +
+                                " to " + to_account);
+                    done->set_value(result);
+                    return;
+                }
+                if (committed == CommitResult::FAILED) {
+                    break;
+                }
+            }
+            
+            // The destination went away since the debit; give the money back
+            executors->submit(executors->ownerOf(from_account), [=]() {
+                Transaction failed = transaction;
+                failed.setStatus(TransactionStatus::FAILED);
+                releaseDailyLimit(from_account, amount, reserved_at);
+                bool refunded = false;
+                for (int tries = 0; tries < MAX_OPTIMISTIC_ATTEMPTS && !refunded; ++tries) {
+                    Account source;
+                    if (!loadForChange(from_account, source)) {
+                        break;
+                    }
+                    source.setBalance(source.getBalance() + amount);
+                    // The key stored with the debit goes with it
+                    refunded = commitChange({source}, failed, key_row.empty() ? "" : idempotency_key, "") ==
+                               CommitResult::COMMITTED;
+                }
+                if (!refunded) {
+                    // Still PENDING on disk, so the next start settles it
+                    stuck_transfers++;
+                    std::cout << "[ERROR] Refund of transfer " << transaction.getTransactionId()
+                              << " could not be written; it stays pending" << std::endl;
+                }
+                TransactionResult refused;
+                refused.message = refunded ? "Transfer failed" : "Transfer failed; the refund is pending";
+                done->set_value(refused);
+            });
+        });
+    });
+    return outcome.get();
+}
+
+void BankingService::settlePendingTransfers() {
+    std::vector<Transaction> pending;
+    database->scanTransactions([](const Transaction& transaction) {
+        return transaction.getStatus() == TransactionStatus::PENDING &&
+               transaction.getType() == TransactionType::TRANSFER;
+    }, ScanOptions(), [&](const Transaction& transaction) {
+        pending.push_back(transaction);
+        return true;
+    });
+    if (pending.empty()) {
+        return;
+    }
+    
+    // The debit is in, the credit is not: finish the transfer if the
+    // destination can still take the money, refund the source otherwise
+    size_t completed = 0;
+    std::set<std::string> refunded;
+    for (const auto& transaction : pending) {
+        bool settled = false;
+        for (int tries = 0; tries < MAX_OPTIMISTIC_ATTEMPTS && !settled; ++tries) {
+            Account credited;
+            if (database->loadAccount(transaction.getToAccountId(), credited) && credited.isActive() &&
+                credited.deposit(transaction.getAmount())) {
+                Transaction done = transaction;
+                done.setStatus(TransactionStatus::COMPLETED);
+                CommitResult committed = database->commitAccountTransaction({credited}, done);
+                if (committed == CommitResult::COMMITTED) {
+                    completed++;
+                    settled = true;
+                }
+                if (committed != CommitResult::FAILED) {
+                    continue;
+                }
+            }
+            
+            Account source;
+            if (!database->loadAccount(transaction.getFromAccountId(), source)) {
+                break;
+            }
+            source.setBalance(source.getBalance() + transaction.getAmount());
+            Transaction failed = transaction;
+            failed.setStatus(TransactionStatus::FAILED);
+            if (database->commitAccountTransaction({source}, failed) == CommitResult::COMMITTED) {
+                refunded.insert(transaction.getTransactionId());
+                settled = true;
+            }
+        }
+        if (!settled) {
+            stuck_transfers++;
+            std::cout << "[ERROR] Pending transfer " << transaction.getTransactionId()
+                      << " could not be settled" << std::endl;
+        }
+    }
+    
+    // A key stored with a refunded debit no longer describes a success
+    std::vector<std::string> keys;
+    std::string header;
+    database->scanLiveRows("idempotency", 0, header, [&](const std::string& row) {
+        IdempotencyRecord record;
+        if (record.fromCsvRow(row) && refunded.count(record.transaction_id) > 0) {
+            keys.push_back(record.key);
+        }
+        return true;
+    });
+    if (!keys.empty() && !database->deleteIdempotencyRecords(keys)) {
+        std::cout << "[ERROR] Failed to delete the idempotency keys of refunded transfers" << std::endl;
+    }
+    std::cout << "[DEBUG] Pending transfers settled: " << completed << " completed, " << refunded.size()
+              << " refunded" << std::endl;
+}
+
+TransactionResult BankingService::deposit(const std::string& account_number, double amount,
+                                         const std::string& description, uint64_t expected_version,
+                                         const std::string& idempotency_key) {
+    TransactionResult result;
+    
+    if (isReadOnly()) {
+        result.message = "Read-only node";
         return result;
     }
     
-    if (!account.isActive()) {
-        result.message = "Account is not active";
+    if (!validateAmount(amount)) {
+        result.message = "Invalid amount";
         return result;
     }
     
-    double balance_before = account.getBalance();
+    if (ledger) {
+        // Versions only move when the writer commits, so they cannot guard
+        // a change acknowledged from memory
+        if (expected_version != 0) {
+            result.message = "If-Match is not supported in ledger mode";
+            return result;
+        }
+        Transaction transaction;
+        double new_balance = 0.0;
+        LedgerResult applied = ledger->deposit(account_number, amount, description, new_balance, transaction);
+        return ledgerResult(applied, transaction, new_balance, "Deposit successful");
+    }
     
-    if (account.deposit(amount)) {
-        database->updateAccount(account);
+    return runBalanceChange(account_number, "", [&](TransactionResult& outcome) {
+        Account account;
+        if (!loadForChange(account_number, account)) {
+            outcome.message = "Account not found";
+            return true;
+        }
+        
+        if (expected_version != 0 && account.getVersion() != expected_version) {
+            outcome.message = "Account has changed";
+            outcome.version_mismatch = true;
+            return true;
+        }
+        
+        if (!account.isActive()) {
+            outcome.message = "Account is not active";
+            return true;
+        }
+        
+        double balance_before = account.getBalance();
+        
+        if (!account.deposit(amount)) {
+            outcome.message = "Deposit failed";
+            return true;
+        }
         
         Transaction transaction("", account_number, amount, TransactionType::DEPOSIT, description);
         transaction.setStatus(TransactionStatus::COMPLETED);
         transaction.setBalanceBefore(balance_before);
         transaction.setBalanceAfter(account.getBalance());
         
-        database->saveTransaction(transaction);
+        std::string key_row = idempotencyRow(idempotency_key, transaction, account, "Deposit successful");
+        CommitResult committed = commitChange({account}, transaction, key_row.empty() ? "" : idempotency_key,
+                                              key_row);
+        if (committed == CommitResult::CONFLICT) {
+            return false;
+        }
+        if (committed == CommitResult::FAILED) {
+            outcome.message = "Deposit failed";
+            return true;
+        }
         
-        result.success = true;
-        result.transaction_id = transaction.getTransactionId();
-        result.new_balance = account.getBalance();
-        result.message = "Deposit successful";
+        outcome.success = true;
+        outcome.transaction_id = transaction.getTransactionId();
+        outcome.new_balance = account.getBalance();
+        outcome.account_version = account.getVersion() + 1;
+        outcome.message = "Deposit successful";
         
         logActivity(account.getCustomerId(), "Deposit: $" + std::to_string(amount) + " to " + account_number);
-    } else {
-        result.message = "Deposit failed";
-    }
-    
-    return result;
+        return true;
+    });
 }
 
 TransactionResult BankingService::withdraw(const std::string& account_number, double amount,
-                                          const std::string& description) {
-    std::lock_guard<std::mutex> lock(service_mutex);
-    
+                                          const std::string& description, uint64_t expected_version,
+                                          const std::string& idempotency_key) {
     TransactionResult result;
-    result.success = false;
+    
+    if (isReadOnly()) {
+        result.message = "Read-only node";
+        return result;
+    }
     
     if (!validateAmount(amount)) {
         result.message = "Invalid amount";
         return result;
     }
     
-    Account account;
-    if (!database->loadAccount(account_number, account)) {
-        result.message = "Account not found";
+    if (ledger) {
+        if (expected_version != 0) {
+            result.message = "If-Match is not supported in ledger mode";
+            return result;
+        }
+        Transaction transaction;
+        double new_balance = 0.0;
+        LedgerResult applied = ledger->withdraw(account_number, amount, description, new_balance, transaction);
+        return ledgerResult(applied, transaction, new_balance, "Withdrawal successful");
+    }
+    
+    return runBalanceChange(account_number, "", [&](TransactionResult& outcome) {
+        Account account;
+        if (!loadForChange(account_number, account)) {
+            outcome.message = "Account not found";
+            return true;
+        }
+        
+        if (expected_version != 0 && account.getVersion() != expected_version) {
+            outcome.message = "Account has changed";
+            outcome.version_mismatch = true;
+            return true;
+        }
+        
+        if (!account.isActive()) {
+            outcome.message = "Account is not active";
+            return true;
+        }
+        
+        if (!account.canWithdraw(amount)) {
+            outcome.message = "Insufficient funds or exceeds daily limit";
+            return true;
+        }
+        std::time_t reserved_at = std::time(nullptr);
+        if (!reserveDailyLimit(account, amount, reserved_at)) {
+            outcome.message = "Exceeds daily limit";
+            return true;
+        }
+        
+        double balance_before = account.getBalance();
+        
+        if (!account.withdraw(amount)) {
+            releaseDailyLimit(account_number, amount, reserved_at);
+            outcome.message = "Withdrawal failed";
+            return true;
+        }
+        
+        Transaction transaction(account_number, "", amount, TransactionType::WITHDRAWAL, description);
+        transaction.setStatus(TransactionStatus::COMPLETED);
+        transaction.setBalanceBefore(balance_before);
+        transaction.setBalanceAfter(account.getBalance());
+        
+        std::string key_row = idempotencyRow(idempotency_key, transaction, account, "Withdrawal successful");
+        CommitResult committed = commitChange({account}, transaction, key_row.empty() ? "" : idempotency_key,
+                                              key_row);
+        if (committed != CommitResult::COMMITTED) {
+            releaseDailyLimit(account_number, amount, reserved_at);
+        }
+        if (committed == CommitResult::CONFLICT) {
+            return false;
+        }
+        if (committed == CommitResult::FAILED) {
+            outcome.message = "Withdrawal failed";
+            return true;
+        }
+        
+        outcome.success = true;
+        outcome.transaction_id = transaction.getTransactionId();
+        outcome.new_balance = account.getBalance();
+        outcome.account_version = account.getVersion() + 1;
+        outcome.message = "Withdrawal successful";
+        
+        logActivity(account.getCustomerId(), "Withdrawal: $" + std::to_string(amount) + " from " + account_number);
+        return true;
+    });
+}
+
+TransactionResult BankingService::transfer(const std::string& from_account, const std::string& to_account,
+                                          double amount, const std::string& description,
+                                          uint64_t expected_version, const std::string& idempotency_key) {
+    TransactionResult result;
+    
+    if (isReadOnly()) {
+        result.message = "Read-only node";
         return result;
     }
     
-    if (!account.isActive()) {
-        result.message = "Account is not active";
+    if (!validateAmount(amount)) {
+        result.message = "Invalid amount";
         return result;
     }
     
-    if (!account.canWithdraw(amount)) {
-        result.message = "Insufficient funds or exceeds daily limit";
+    if (from_account == to_account) {
+        result.message = "Cannot transfer to the same account";
         return result;
     }
     
-    double balance_before = account.getBalance();
+    if (ledger) {
+        if (expected_version != 0) {
+            result.message = "If-Match is not supported in ledger mode";
+            return result;
+        }
+        Transaction transaction;
+        double new_balance = 0.0;
+        LedgerResult applied = ledger->transfer(from_account, to_account, amount, description,
+                                                new_balance, transaction);
+        return ledgerResult(applied, transaction, new_balance, "Transfer successful");
+    }
+    
+    if (executors && executors->ownerOf(from_account) != executors->ownerOf(to_account)) {
+        return transferAcrossExecutors(from_account, to_account, amount, description, expected_version,
+                                       idempotency_key);
+    }
     
-    if (account.withdraw(amount)) {
-        database->updateAccount(account);
+    // Both accounts are validated and written as one unit: under both
+    // stripe locks, or against the versions both were read at
+    return runBalanceChange(from_account, to_account, [&](TransactionResult& outcome) {
+        Account from_acc, to_acc;
+        if (!loadForChange(from_account, from_acc) || !loadForChange(to_account, to_acc)) {
+            outcome.message = "One or both accounts not found";
+            return true;
+        }
         
-        Transaction transaction(account_number, "", amount, TransactionType::WITHDRAWAL, description);
+        if (expected_version != 0 && from_acc.getVersion() != expected_version) {
+            outcome.message = "Account has changed";
+            outcome.version_mismatch = true;
+            return true;
+        }
+        
+        if (!from_acc.isActive() || !to_acc.isActive()) {
+            outcome.message = "One or both accounts are not active";
+            return true;
+        }
+        
+        if (!from_acc.canWithdraw(amount)) {
+            outcome.message = "Insufficient funds or exceeds daily limit";
+            return true;
+        }
+        std::time_t reserved_at = std::time(nullptr);
+        if (!reserveDailyLimit(from_acc, amount, reserved_at)) {
+            outcome.message = "Exceeds daily limit";
+            return true;
+        }
+        
+        double from_balance_before = from_acc.getBalance();
+        
+        if (!from_acc.transfer(amount, to_acc)) {
+            releaseDailyLimit(from_account, amount, reserved_at);
+            outcome.message = "Transfer failed";
+            return true;
+        }
+        
+        Transaction transaction(from_account, to_account, amount, TransactionType::TRANSFER, description);
         transaction.setStatus(TransactionStatus::COMPLETED);
+        transaction.setBalanceBefore(from_balance_before);
+        transaction.setBalanceAfter(from_acc.getBalance());
+        
+        std::string key_row = idempotencyRow(idempotency_key, transaction, from_acc, "Transfer successful");
+        CommitResult committed = commitChange({from_acc, to_acc}, transaction,
+                                              key_row.empty() ? "" : idempotency_key, key_row);
+        if (committed != CommitResult::COMMITTED) {
+            releaseDailyLimit(from_account, amount, reserved_at);
+        }
+        if (committed == CommitResult::CONFLICT) {
+            return false;
+        }
+        if (committed == CommitResult::FAILED) {
+            outcome.message = "Transfer failed";
+            return true;
+        }
+        
+        outcome.success = true;
+        outcome.transaction_id = transaction.getTransactionId();
+        outcome.new_balance = from_acc.getBalance();
+        outcome.account_version = from_acc.getVersion() + 1;
+        outcome.message = "Transfer successful";
+        
+        logActivity(from_acc.getCustomerId(), "Transfer: $" + std::to_string(amount) + " from " + from_account + " to " + to_account);
+        return true;
+    });
+}
+
+std::string BankingService::idempotencyRow(const std::string& key, const Transaction& transaction,
+                                           const Account& debited, const std::string& message) {
+    if (key.empty()) {
+        return "";
+    }
+    IdempotencyRecord record;
+    record.key = key;
+    if (!idempotency.claimed(record)) {
+        return "";
+    }
+    record.transaction_id = transaction.getTransactionId();
+    record.new_balance = debited.getBalance();
+    record.account_version = debited.getVersion() + 1;
+    record.message = message;
+    return record.toCsvRow();
+}
+
+TransactionResult BankingService::ledgerResult(LedgerResult applied, const Transaction& transaction,
+                                               double new_balance, const std::string& success_message) {
+    TransactionResult result;
+    switch (applied) {
+        case LedgerResult::APPLIED:
+            result.success = true;
+            result.transaction_id = transaction.getTransactionId();
+            result.new_balance = new_balance;
+            result.message = success_message;
+            break;
+        case LedgerResult::NOT_FOUND:
+            result.message = "Account not found";
+            break;
+        case LedgerResult::INACTIVE:
+            result.message = "Account is not active";
+            break;
+        case LedgerResult::INVALID_AMOUNT:
+            result.message = "Invalid amount";
+            break;
+        case LedgerResult::INSUFFICIENT_FUNDS:
+            result.message = "Insufficient funds or exceeds daily limit";
+            break;
+        case LedgerResult::OVER_DAILY_LIMIT:
+            result.message = "Exceeds daily limit";
+            break;
+        case LedgerResult::FULL:
+            result.message = "Balance ledger is full";
+            break;
+    }
+    return result;
+}
+
+bool BankingService::applyBatchItem(const BatchOperation& operation, const AccountLookup& lookup, std::time_t now,
+                                    TransactionResult& result, Transaction& transaction,
+                                    DailyReservations& reserved) {
+    if (operation.type == BatchOperationType::DEPOSIT) {
+        Account* account = lookup(operation.account_number);
+        if (!account) {
+            result.message = "Account not found";
+            return false;
+        }
+        if (!account->isActive()) {
+            result.message = "Account is not active";
+            return false;
+        }
+        
+        double balance_before = account->getBalance();
+        if (!account->deposit(operation.amount)) {
+            result.message = "Deposit failed";
+            return false;
+        }
+        
+        transaction = Transaction("", operation.account_number, operation.amount, TransactionType::DEPOSIT,
+                                  operation.description.empty() ? "Deposit" : operation.description);
         transaction.setBalanceBefore(balance_before);
-        transaction.setBalanceAfter(account.getBalance());
+        transaction.setBalanceAfter(account->getBalance());
+        result.new_balance = account->getBalance();
+        result.message = "Deposit successful";
+    } else if (operation.type == BatchOperationType::WITHDRAWAL) {
+        Account* account = lookup(operation.account_number);
+        if (!account) {
+            result.message = "Account not found";
+            return false;
+        }
+        if (!account->isActive()) {
+            result.message = "Account is not active";
+            return false;
+        }
+        if (!account->canWithdraw(operation.amount)) {
+            result.message = "Insufficient funds or exceeds daily limit";
+            return false;
+        }
+        if (!reserveDailyLimit(*account, operation.amount, now)) {
+            result.message = "Exceeds daily limit";
+            return false;
+        }
+        reserved.emplace_back(operation.account_number, operation.amount);
         
-        database->saveTransaction(transaction);
+        double balance_before = account->getBalance();
+        account->withdraw(operation.amount);
         
-        result.success = true;
-        result.transaction_id = transaction.getTransactionId();
-        result.new_balance = account.getBalance();
+        transaction = Transaction(operation.account_number, "", operation.amount, TransactionType::WITHDRAWAL,
+                                  operation.description.empty() ? "Withdrawal" : operation.description);
+        transaction.setBalanceBefore(balance_before);
+        transaction.setBalanceAfter(account->getBalance());
+        result.new_balance = account->getBalance();
         result.message = "Withdrawal successful";
-        
-        logActivity(account.getCustomerId(), "Withdrawal: $" + std::to_string(amount) + " from " + account_number);
     } else {
-        result.message = "Withdrawal failed";
+        Account* from_acc = lookup(operation.account_number);
+        Account* to_acc = lookup(operation.to_account);
+        if (!from_acc || !to_acc) {
+            result.message = "One or both accounts not found";
+            return false;
+        }
+        if (!from_acc->isActive() || !to_acc->isActive()) {
+            result.message = "One or both accounts are not active";
+            return false;
+        }
+        if (!from_acc->canWithdraw(operation.amount)) {
+            result.message = "Insufficient funds or exceeds daily limit";
+            return false;
+        }
+        if (!reserveDailyLimit(*from_acc, operation.amount, now)) {
+            result.message = "Exceeds daily limit";
+            return false;
+        }
+        
+        double from_balance_before = from_acc->getBalance();
+        if (!from_acc->transfer(operation.amount, *to_acc)) {
+            releaseDailyLimit(operation.account_number, operation.amount, now);
+            result.message = "Transfer failed";
+            return false;
+        }
+        reserved.emplace_back(operation.account_number, operation.amount);
+        
+        transaction = Transaction(operation.account_number, operation.to_account, operation.amount,
+                                  TransactionType::TRANSFER,
+                                  operation.description.empty() ? "Transfer" : operation.description);
+        transaction.setBalanceBefore(from_balance_before);
+        transaction.setBalanceAfter(from_acc->getBalance());
+        result.new_balance = from_acc->getBalance();
+        result.message = "Transfer successful";
     }
     
-    return result;
+    transaction.setStatus(TransactionStatus::COMPLETED);
+    result.success = true;
+    result.transaction_id = transaction.getTransactionId();
+    return true;
 }
 
-TransactionResult BankingService::transfer(const std::string& from_account, const std::string& to_account,
-                                          double amount, const std::string& description) {
-    std::lock_guard<std::mutex> lock(service_mutex);
+std::vector<TransactionResult> BankingService::executeBatch(const std::vector<BatchOperation>& operations) {
+    std::vector<TransactionResult> results(operations.size());
+    
+    std::string refusal;
+    if (isReadOnly()) {
+        refusal = "Read-only node";
+    } else if (operations.size() > MAX_BATCH_OPERATIONS) {
+        refusal = "Batch too large";
+    }
+    if (!refusal.empty()) {
+        for (auto& result : results) {
+            result.message = refusal;
+        }
+        return results;
+    }
     
-    TransactionResult result;
-    result.success = false;
+    // The ledger and the executors take no locks per change to begin with
+    if (ledger || executors) {
+        for (size_t i = 0; i < operations.size(); ++i) {
+            const BatchOperation& operation = operations[i];
+            std::string description = operation.description;
+            if (operation.type == BatchOperationType::DEPOSIT) {
+                results[i] = deposit(operation.account_number, operation.amount,
+                                     description.empty() ? "Deposit" : description);
+            } else if (operation.type == BatchOperationType::WITHDRAWAL) {
+                results[i] = withdraw(operation.account_number, operation.amount,
+                                      description.empty() ? "Withdrawal" : description);
+            } else {
+                results[i] = transfer(operation.account_number, operation.to_account, operation.amount,
+                                      description.empty() ? "Transfer" : description);
+            }
+        }
+        return results;
+    }
+    
+    std::vector<bool> valid(operations.size(), false);
+    std::vector<std::string> involved;
+    for (size_t i = 0; i < operations.size(); ++i) {
+        const BatchOperation& operation = operations[i];
+        if (!validateAmount(operation.amount)) {
+            results[i].message = "Invalid amount";
+            continue;
+        }
+        if (operation.type == BatchOperationType::TRANSFER && operation.account_number == operation.to_account) {
+            results[i].message = "Cannot transfer to the same account";
+            continue;
+        }
+        valid[i] = true;
+        involved.push_back(operation.account_number);
+        if (operation.type == BatchOperationType::TRANSFER) {
+            involved.push_back(operation.to_account);
+        }
+    }
     
+    auto locks = account_locks.lockAll(involved);
+    
+    // Optimistic writers do not take the locks, so the commit may still
+    // conflict; the batch is then replayed against fresh rows
+    for (int tries = 0; tries < MAX_OPTIMISTIC_ATTEMPTS; ++tries) {
+        std::map<std::string, Account> working;
+        AccountLookup lookup = [&](const std::string& account_number) -> Account* {
+            auto it = working.find(account_number);
+            if (it == working.end()) {
+                Account account;
+                if (!database->loadAccount(account_number, account)) {
+                    return nullptr;
+                }
+                it = working.emplace(account_number, account).first;
+            }
+            return &it->second;
+        };
+        
+        std::vector<Transaction> transactions;
+        std::set<std::string> touched;
+        DailyReservations reserved;
+        std::time_t now = std::time(nullptr);
+        for (size_t i = 0; i < operations.size(); ++i) {
+            if (!valid[i]) {
+                continue;
+            }
+            results[i] = TransactionResult();
+            Transaction transaction;
+            if (!applyBatchItem(operations[i], lookup, now, results[i], transaction, reserved)) {
+                continue;
+            }
+            transactions.push_back(transaction);
+            touched.insert(operations[i].account_number);
+            if (operations[i].type == BatchOperationType::TRANSFER) {
+                touched.insert(operations[i].to_account);
+            }
+        }
+        if (transactions.empty()) {
+            return results;
+        }
+        
+        std::vector<Account> accounts;
+        for (const auto& account_number : touched) {
+            accounts.push_back(working[account_number]);
+        }
+        
+        CommitResult committed = database->commitAccountTransactions(accounts, transactions);
+        if (committed != CommitResult::COMMITTED) {
+            for (const auto& reservation : reserved) {
+                releaseDailyLimit(reservation.first, reservation.second, now);
+            }
+        }
+        if (committed == CommitResult::CONFLICT) {
+            optimistic_conflicts++;
+            continue;
+        }
+        
+        for (size_t i = 0; i < operations.size(); ++i) {
+            if (!valid[i] || !results[i].success) {
+                continue;
+            }
+            if (committed == CommitResult::FAILED) {
+                results[i] = TransactionResult();
+                results[i].message = "Batch commit failed";
+            } else {
+                results[i].account_version = working[operations[i].account_number].getVersion() + 1;
+            }
+        }
+        if (committed == CommitResult::COMMITTED) {
+            logActivity("SYSTEM", "Batch: " + std::to_string(transactions.size()) + " of " +
+                        std::to_string(operations.size()) + " operations applied");
+        }
+        return results;
+    }
+    
+    for (size_t i = 0; i < operations.size(); ++i) {
+        if (valid[i]) {
+            results[i] = TransactionResult();
+            results[i].message = "Account is busy, try again";
+        }
+    }
+    return results;
+}
+
+// Asynchronous operations
+StandingOrderResult BankingService::createStandingOrder(const std::string& from_account,
+                                                        const std::string& to_account, double amount,
+                                                        const std::string& frequency, std::time_t first_run,
+                                                        const std::string& description) {
+    StandingOrderResult result;
+    
+    if (!scheduler) {
+        result.message = "Standing orders are not run on this node";
+        return result;
+    }
     if (!validateAmount(amount)) {
         result.message = "Invalid amount";
         return result;
     }
-    
     if (from_account == to_account) {
         result.message = "Cannot transfer to the same account";
         return result;
     }
+    if (!database->accountExists(from_account) || !database->accountExists(to_account)) {
+        result.message = "Account not found";
+        return result;
+    }
     
-    Account from_acc, to_acc;
-    if (!database->loadAccount(from_account, from_acc) || !database->loadAccount(to_account, to_acc)) {
-        result.message = "One or both accounts not found";
+    std::string frequency_upper = frequency;
+    std::transform(frequency_upper.begin(), frequency_upper.end(), frequency_upper.begin(), ::toupper);
+    StandingOrderFrequency parsed;
+    if (!StandingOrder::stringToFrequency(frequency_upper, parsed)) {
+        result.message = "Frequency must be DAILY, WEEKLY or MONTHLY";
         return result;
     }
     
-    if (!from_acc.isActive() || !to_acc.isActive()) {
-        result.message = "One or both accounts are not active";
+    // A little slack for clocks; runs are never created already missed
+    std::time_t now = std::time(nullptr);
+    if (first_run == 0) {
+        first_run = now;
+    } else if (first_run < now - 60) {
+        result.message = "First run is in the past";
         return result;
     }
     
-    if (!from_acc.canWithdraw(amount)) {
-        result.message = "Insufficient funds or exceeds daily limit";
+    StandingOrder order(from_account, to_account, amount, parsed, first_run, description);
+    if (!scheduler->add(order)) {
+        result.message = "Failed to save standing order";
         return result;
     }
     
-    double from_balance_before = from_acc.getBalance();
-    double to_balance_before = to_acc.getBalance();
+    logActivity("SYSTEM", "Standing order " + order.getOrderId() + " created: " + from_account + " -> " +
+                to_account + " " + order.frequencyToString());
+    result.success = true;
+    result.order = order;
+    result.message = "Standing order created";
+    return result;
+}
+
+StandingOrderResult BankingService::cancelStandingOrder(const std::string& order_id) {
+    StandingOrderResult result;
     
-    if (from_acc.transfer(amount, to_acc)) {
-        database->updateAccount(from_acc);
-        database->updateAccount(to_acc);
-        
-        Transaction transaction(from_account, to_account, amount, TransactionType::TRANSFER, description);
-        transaction.setStatus(TransactionStatus::COMPLETED);
-        transaction.setBalanceBefore(from_balance_before);
-        transaction.setBalanceAfter(from_acc.getBalance());
-        
-        database->saveTransaction(transaction);
-        
-        result.success = true;
-        result.transaction_id = transaction.getTransactionId();
-        result.new_balance = from_acc.getBalance();
-        result.message = "Transfer successful";
-        
-        logActivity(from_acc.getCustomerId(), "Transfer: $" + std::to_string(amount) + " from " + from_account + " to " + to_account);
-    } else {
-        result.message = "Transfer failed";
+    if (!scheduler) {
+        result.message = "Standing orders are not run on this node";
+        return result;
+    }
+    if (!scheduler->cancel(order_id, result.order)) {
+        result.message = "Standing order not found";
+        return result;
     }
     
+    logActivity("SYSTEM", "Standing order " + order_id + " cancelled");
+    result.success = true;
+    result.message = "Standing order cancelled";
     return result;
 }
 
+std::vector<StandingOrder> BankingService::getStandingOrders(const std::string& account_number) {
+    if (!scheduler) {
+        return {};
+    }
+    return scheduler->getOrdersForAccount(account_number);
+}
+
+TaskPool& BankingService::getTaskPool() {
+    return *task_pool;
+}
+
+IdempotencyClaim BankingService::claimIdempotencyKey(const std::string& key, const std::string& fingerprint,
+                                                     TransactionResult& original) {
+    IdempotencyRecord record;
+    IdempotencyClaim claim = idempotency.claim(key, fingerprint, std::time(nullptr), record);
+    if (claim == IdempotencyClaim::REPEAT) {
+        original = TransactionResult();
+        original.success = true;
+        original.transaction_id = record.transaction_id;
+        original.message = record.message;
+        original.new_balance = record.new_balance;
+        original.account_version = record.account_version;
+    }
+    return claim;
+}
+
+void BankingService::finishIdempotencyKey(const std::string& key, const TransactionResult& result) {
+    if (!result.success) {
+        idempotency.abandon(key);
+        return;
+    }
+    
+    IdempotencyRecord record;
+    record.key = key;
+    record.transaction_id = result.transaction_id;
+    record.message = result.message;
+    record.new_balance = result.new_balance;
+    record.account_version = result.account_version;
+    
+    // Keys dropped meanwhile are deleted with one append; a key cleared
+    // while its request ran was stored without being held here
+    std::vector<std::string> dropped;
+    if (!idempotency.complete(record, dropped)) {
+        return;
+    }
+    if (ledger) {
+        // The ledger acknowledges changes before the writer commits them, so
+        // the key is stored as its change is acknowledged instead
+        if (!database->saveIdempotencyRecord(key, record.toCsvRow(), dropped)) {
+            std::cout << "[ERROR] Failed to store idempotency key " << key << std::endl;
+        }
+        return;
+    }
+    if (!dropped.empty() && !database->deleteIdempotencyRecords(dropped)) {
+        std::cout << "[ERROR] Failed to delete " << dropped.size() << " expired idempotency keys" << std::endl;
+    }
+}
+
+void BankingService::runAsync(std::function<TransactionResult()> operation, TransactionCallback done) {
+    task_pool->submit([operation = std::move(operation), done = std::move(done)]() {
+        TransactionResult result;
+        try {
+            result = operation();
+        } catch (const std::exception& e) {
+            result = TransactionResult();
+            result.message = "Internal error";
+        }
+        done(result);
+    });
+}
+
+void BankingService::depositAsync(const std::string& account_number, double amount, const std::string& description,
+                                  uint64_t expected_version, const std::string& idempotency_key,
+                                  TransactionCallback done) {
+    runAsync([=]() { return deposit(account_number, amount, description, expected_version, idempotency_key); },
+             std::move(done));
+}
+
+void BankingService::withdrawAsync(const std::string& account_number, double amount, const std::string& description,
+                                   uint64_t expected_version, const std::string& idempotency_key,
+                                   TransactionCallback done) {
+    runAsync([=]() { return withdraw(account_number, amount, description, expected_version, idempotency_key); },
+             std::move(done));
+}
+
+void BankingService::transferAsync(const std::string& from_account, const std::string& to_account, double amount,
+                                   const std::string& description, uint64_t expected_version,
+                                   const std::string& idempotency_key, TransactionCallback done) {
+    runAsync([=]() {
+        return transfer(from_account, to_account, amount, description, expected_version, idempotency_key);
+    }, std::move(done));
+}
+
+void BankingService::executeBatchAsync(std::vector<BatchOperation> operations, BatchCallback done) {
+    task_pool->submit([this, operations = std::move(operations), done = std::move(done)]() {
+        done(executeBatch(operations));
+    });
+}
+
+std::future<TransactionResult> BankingService::depositAsync(const std::string& account_number, double amount,
+                                                            const std::string& description,
+                                                            uint64_t expected_version) {
+    auto outcome = std::make_shared<std::promise<TransactionResult>>();
+    depositAsync(account_number, amount, description, expected_version, "",
+                 [outcome](const TransactionResult& result) { outcome->set_value(result); });
+    return outcome->get_future();
+}
+
+std::future<TransactionResult> BankingService::withdrawAsync(const std::string& account_number, double amount,
+                                                             const std::string& description,
+                                                             uint64_t expected_version) {
+    auto outcome = std::make_shared<std::promise<TransactionResult>>();
+    withdrawAsync(account_number, amount, description, expected_version, "",
+                  [outcome](const TransactionResult& result) { outcome->set_value(result); });
+    return outcome->get_future();
+}
+
+std::future<TransactionResult> BankingService::transferAsync(const std::string& from_account,
+                                                             const std::string& to_account, double amount,
+                                                             const std::string& description,
+                                                             uint64_t expected_version) {
+    auto outcome = std::make_shared<std::promise<TransactionResult>>();
+    transferAsync(from_account, to_account, amount, description, expected_version, "",
+                  [outcome](const TransactionResult& result) { outcome->set_value(result); });
+    return outcome->get_future();
+}
+
+std::future<std::vector<TransactionResult>> BankingService::executeBatchAsync(std::vector<BatchOperation> operations) {
+    auto outcome = std::make_shared<std::promise<std::vector<TransactionResult>>>();
+    executeBatchAsync(std::move(operations),
+                      [outcome](const std::vector<TransactionResult>& results) { outcome->set_value(results); });
+    return outcome->get_future();
+}
+
 // Transaction History
+bool BankingService::getTransaction(const std::string& transaction_id, Transaction& transaction) {
+    if (replica) {
+        return replica->loadTransaction(transaction_id, transaction);
+    }
+    
+    return database->loadTransaction(transaction_id, transaction);
+}
+
 std::vector<Transaction> BankingService::getAccountTransactions(const std::string& account_number) {
-    std::lock_guard<std::mutex> lock(service_mutex);
     return database->getTransactionsByAccount(account_number);
 }
 
+ScanResult BankingService::scanAccountTransactions(const std::string& account_number, const ScanOptions& options,
+                                                   const TransactionVisitor& visitor) {
+    if (replica) {
+        return replica->scanTransactionsByAccount(account_number, options, visitor);
+    }
+    
+    // Served from a database snapshot; taking no account locks keeps a long
+    // history download from stalling writers
+    return database->scanTransactionsByAccount(account_number, options, visitor);
+}
+
 std::vector<Transaction> BankingService::getUserTransactions(const std::string& user_id) {
-    std::lock_guard<std::mutex> lock(service_mutex);
+    std::unordered_set<std::string> account_numbers;
+    for (const auto& account : database->getAccountsByCustomerId(user_id)) {
+        account_numbers.insert(account.getAccountNumber());
+    }
     
+    // One pass over the history instead of one per account
     std::vector<Transaction> all_transactions;
-    auto user_accounts = getUserAccounts(user_id);
-    
-    for (const auto& account : user_accounts) {
-        auto account_transactions = database->getTransactionsByAccount(account.getAccountNumber());
-        all_transactions.insert(all_transactions.end(), account_transactions.begin(), account_transactions.end());
-    }
+    database->scanTransactions([&](const Transaction& transaction) {
+        return account_numbers.count(transaction.getFromAccountId()) > 0 ||
+               account_numbers.count(transaction.getToAccountId()) > 0;
+    }, ScanOptions(), [&](const Transaction& transaction) {
+        all_transactions.push_back(transaction);
+        return true;
+    });
     
     return all_transactions;
 }
 
 bool BankingService::getAccountBalance(const std::string& account_number, double& balance) {
-    std::lock_guard<std::mutex> lock(service_mutex);
+    if (ledger && ledger->getBalance(account_number, balance)) {
+        return true;
+    }
     
     Account account;
-    if (database->loadAccount(account_number, account)) {
+    bool found = replica ? replica->loadAccount(account_number, account)
+                         : database->loadAccount(account_number, account);
+    if (found) {
         balance = account.getBalance();
         return true;
     }
@@ -531,34 +1733,178 @@ bool BankingService::getAccountBalance(const std::string& account_number, double
 }
 
 bool BankingService::getAccountInfo(const std::string& account_number, Account& account) {
-    std::lock_guard<std::mutex> lock(service_mutex);
-    return database->loadAccount(account_number, account);
+    if (replica) {
+        return replica->loadAccount(account_number, account);
+    }
+    if (!database->loadAccount(account_number, account)) {
+        return false;
+    }
+    
+    // The row's version (and ETag) stays at the last write-behind commit
+    double balance = 0.0;
+    if (ledger && ledger->getBalance(account_number, balance)) {
+        account.setBalance(balance);
+    }
+    return true;
 }
 
 // Reports and Analytics (Admin only)
 double BankingService::getTotalSystemBalance() {
-    std::lock_guard<std::mutex> lock(service_mutex);
     return database->getTotalSystemBalance();
 }
 
 size_t BankingService::getTotalUsers() {
-    std::lock_guard<std::mutex> lock(service_mutex);
     return database->getUserCount();
 }
 
 size_t BankingService::getTotalAccounts() {
-    std::lock_guard<std::mutex> lock(service_mutex);
     return database->getAccountCount();
 }
 
 std::string BankingService::getSystemStatus() {
-    std::lock_guard<std::mutex> lock(service_mutex);
+    if (replica) {
+        ReplicationStatus replication = replica->getStatus();
+        
+        std::ostringstream status;
+        status << "{"
+               << "\"role\":\"replica\","
+               << "\"primary\":\"" << replication.primary_directory << "\","
+               << "\"replication\":{"
+               << "\"applied_rows\":" << replication.applied_rows << ","
+               << "\"lag_bytes\":" << replication.lag_bytes << ","
+               << "\"lag_ms\":" << replication.lag_ms << ","
+               << "\"reloads\":" << replication.reloads
+               << "},"
+               << "\"status\":\"ONLINE\""
+               << "}";
+        return status.str();
+    }
+    
+    CompactionStats compaction = database->getCompactionStats();
+    TieringStats tiering = database->getTieringStats();
     
     std::ostringstream status;
     status << "{"
-           << "\"total_users\":" << getTotalUsers() << ","
-           << "\"total_accounts\":" << getTotalAccounts() << ","
-           << "\"total_balance\":" << std::fixed << std::setprecision(2) << getTotalSystemBalance() << ","
+           << "\"role\":\"" << (read_only ? "standby" : "primary") << "\",";
+    
+    if (standby) {
+        StandbyStatus receiving = standby->getStatus();
+        status << "\"standby\":{"
+               << "\"promoted\":" << (read_only ? "false" : "true") << ","
+               << "\"port\":" << receiving.port << ","
+               << "\"connected\":" << (receiving.connected ? "true" : "false") << ","
+               << "\"applied_seq\":" << receiving.applied_seq << ","
+               << "\"applied_rows\":" << receiving.applied_rows << ","
+               << "\"snapshots\":" << receiving.snapshots << ","
+               << "\"snapshotting\":" << (receiving.snapshotting ? "true" : "false") << ","
+               << "\"last_apply_ms\":" << receiving.last_apply_ms
+               << "},";
+    }
+    
+    if (log_shipper) {
+        ShippingStatus shipping = log_shipper->getStatus();
+        status << "\"shipping\":{"
+               << "\"standby\":\"" << shipping.standby << "\","
+               << "\"mode\":\"" << (shipping.synchronous ? "sync" : "async") << "\","
+               << "\"connected\":" << (shipping.connected ? "true" : "false") << ","
+               << "\"shipped_seq\":" << shipping.shipped_seq << ","
+               << "\"acked_seq\":" << shipping.acked_seq << ","
+               << "\"lag_records\":" << shipping.lag_records << ","
+               << "\"lag_ms\":" << shipping.lag_ms << ","
+               << "\"resyncs\":" << shipping.resyncs << ","
+               << "\"sync_timeouts\":" << shipping.sync_timeouts << ","
+               << "\"degraded\":" << (shipping.degraded ? "true" : "false") << ","
+               << "\"overflows\":" << shipping.overflows
+               << "},";
+    }
+    
+    status << "\"total_users\":" << database->getUserCount() << ","
+           << "\"total_accounts\":" << database->getAccountCount() << ","
+           << "\"total_balance\":" << std::fixed << std::setprecision(2) << database->getTotalSystemBalance() << ","
+           << "\"compaction\":{"
+           << "\"runs\":" << compaction.runs << ","
+           << "\"bytes_reclaimed\":" << compaction.bytes_reclaimed << ","
+           << "\"in_progress\":" << (compaction.in_progress ? "true" : "false") << ","
+           << "\"progress\":" << compaction.progress
+           << "},"
+           << "\"concurrency\":{"
+           << "\"mode\":\"" << (concurrency_mode == ConcurrencyMode::OPTIMISTIC ? "optimistic" : "pessimistic") << "\","
+           << "\"conflicts\":" << optimistic_conflicts << ","
+           << "\"fallbacks\":" << optimistic_fallbacks
+           << "},";
+    
+    TaskPoolStats pool_stats = task_pool->getStats();
+    status << "\"task_pool\":{"
+           << "\"threads\":" << pool_stats.threads << ","
+           << "\"queued\":" << pool_stats.queued << ","
+           << "\"max_queued\":" << pool_stats.max_queued << ","
+           << "\"completed\":" << pool_stats.completed << ","
+           << "\"steals\":" << pool_stats.steals
+           << "},";
+    
+    if (scheduler) {
+        SchedulerStats scheduler_stats = scheduler->getStats();
+        status << "\"standing_orders\":{"
+               << "\"active\":" << scheduler_stats.orders << ","
+               << "\"timers\":" << scheduler_stats.timers << ","
+               << "\"runs\":" << scheduler_stats.runs << ","
+               << "\"failed_runs\":" << scheduler_stats.failed_runs << ","
+               << "\"skipped_runs\":" << scheduler_stats.skipped_runs << ","
+               << "\"recovered_runs\":" << scheduler_stats.recovered_runs << ","
+               << "\"ticks\":" << scheduler_stats.ticks << ","
+               << "\"max_due\":" << scheduler_stats.max_due
+               << "},";
+    }
+    
+    IdempotencyStats idempotency_stats = idempotency.getStats();
+    status << "\"idempotency\":{"
+           << "\"keys\":" << idempotency_stats.keys << ","
+           << "\"capacity\":" << idempotency_stats.capacity << ","
+           << "\"ttl_seconds\":" << idempotency.getTtlSeconds() << ","
+           << "\"repeats\":" << idempotency_stats.repeats << ","
+           << "\"evicted\":" << idempotency_stats.evicted
+           << "},";
+    
+    VelocityStats velocity_stats = velocity.getStats();
+    status << "\"daily_limits\":{"
+           << "\"accounts\":" << velocity_stats.accounts << ","
+           << "\"refused\":" << velocity_stats.refused
+           << "},";
+    
+    if (executors) {
+        ExecutorStats executor_stats = executors->getStats();
+        status << "\"executors\":{"
+               << "\"count\":" << executor_stats.executors << ","
+               << "\"commands\":" << executor_stats.commands << ","
+               << "\"queued\":" << executor_stats.queued << ","
+               << "\"max_queued\":" << executor_stats.max_queued << ","
+               << "\"cached_accounts\":" << executor_stats.cached_accounts << ","
+               << "\"cross_transfers\":" << cross_executor_transfers << ","
+               << "\"stuck_transfers\":" << stuck_transfers
+               << "},";
+    }
+    
+    if (ledger) {
+        LedgerStats ledger_stats = ledger->getStats();
+        status << "\"ledger\":{"
+               << "\"accounts\":" << ledger_stats.accounts << ","
+               << "\"capacity\":" << ledger_stats.capacity << ","
+               << "\"applied\":" << ledger_stats.applied << ","
+               << "\"persisted\":" << ledger_stats.persisted << ","
+               << "\"failed\":" << ledger_stats.failed << ","
+               << "\"pending\":" << (ledger_stats.applied - ledger_stats.persisted - ledger_stats.failed) << ","
+               << "\"batches\":" << ledger_stats.batches << ","
+               << "\"write_failures\":" << ledger_stats.write_failures
+               << "},";
+    }
+    
+    status << "\"tiering\":{"
+           << "\"hot_rows\":" << tiering.hot_rows << ","
+           << "\"hot_bytes\":" << tiering.hot_bytes << ","
+           << "\"demoted_rows\":" << tiering.demoted_rows << ","
+           << "\"hot_reads\":" << tiering.hot_reads << ","
+           << "\"disk_reads\":" << tiering.disk_reads
+           << "},"
            << "\"status\":\"ONLINE\""
            << "}";
     
@@ -0,0 +1,317 @@
+#include "../../include/services/StandingOrderScheduler.h"
+#include "../../include/services/BankingService.h"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <future>
+
+StandingOrderScheduler::StandingOrderScheduler(BankingService& service, Database& database)
+    : service(service), database(database), wheel(std::time(nullptr)) {
+}
+
+StandingOrderScheduler::~StandingOrderScheduler() {
+    stop();
+}
+
+void StandingOrderScheduler::addLocked(const StandingOrder& order) {
+    uint64_t handle = next_handle++;
+    handles[order.getOrderId()] = handle;
+    by_account[order.getFromAccountId()].push_back(handle);
+    by_account[order.getToAccountId()].push_back(handle);
+    orders[handle].order = order;
+    if (order.getStatus() == StandingOrderStatus::ACTIVE) {
+        active_orders++;
+        wheel.schedule(handle, order.getNextRun());
+    }
+}
+
+uint64_t StandingOrderScheduler::firstRunAfter(const StandingOrder& order, std::time_t now) {
+    // Run times only grow with the index: widen, then halve
+    uint64_t low = order.getNextRunIndex();
+    if (order.runTime(low) > now) {
+        return low;
+    }
+    uint64_t step = 1;
+    while (order.runTime(low + step) <= now) {
+        low += step;
+        step *= 2;
+    }
+    uint64_t high = low + step; // runTime(low) <= now < runTime(high)
+    while (high - low > 1) {
+        uint64_t middle = low + (high - low) / 2;
+        if (order.runTime(middle) <= now) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return high;
+}
+
+void StandingOrderScheduler::recoverMadeRuns(std::vector<StandingOrder>& loaded, std::time_t now) {
+    std::unordered_map<std::string, StandingOrder*> overdue;
+    std::time_t oldest = now;
+    for (auto& order : loaded) {
+        if (order.getStatus() == StandingOrderStatus::ACTIVE && order.getNextRun() <= now) {
+            overdue[order.getOrderId()] = &order;
+            oldest = std::min(oldest, order.getNextRun());
+        }
+    }
+    if (overdue.empty()) {
+        return;
+    }
+
+    // A run is made before its order is written back, so a crash in
+    // between leaves the transfer in the history but the order behind it
+    ScanOptions options;
+    options.since = oldest;
+    database.scanTransactions([](const Transaction& transaction) {
+        return transaction.getStatus() == TransactionStatus::COMPLETED &&
+               transaction.getType() == TransactionType::TRANSFER;
+    }, options, [&](const Transaction& transaction) {
+        std::string order_id;
+        uint64_t index = 0;
+        if (!StandingOrder::parseRunDescription(transaction.getDescription(), order_id, index)) {
+            return true;
+        }
+        auto it = overdue.find(order_id);
+        if (it != overdue.end() && index >= it->second->getNextRunIndex()) {
+            recovered_runs += index + 1 - it->second->getNextRunIndex();
+            it->second->setNextRunIndex(index + 1);
+            it->second->setLastResult(transaction.getTransactionId());
+        }
+        return true;
+    });
+}
+
+bool StandingOrderScheduler::load() {
+    std::vector<StandingOrder> loaded;
+    std::string header;
+    if (!database.scanLiveRows("standing_orders", 0, header, [&](const std::string& row) {
+            StandingOrder order;
+            if (order.fromCsvRow(row)) {
+                loaded.push_back(order);
+            }
+            return true;
+        })) {
+        return false;
+    }
+
+    std::vector<uint64_t> stored_index;
+    for (const auto& order : loaded) {
+        stored_index.push_back(order.getNextRunIndex());
+    }
+
+    std::time_t now = std::time(nullptr);
+    recoverMadeRuns(loaded, now);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<StandingOrder> changed;
+    size_t active = 0;
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        StandingOrder& order = loaded[i];
+        if (order.getStatus() == StandingOrderStatus::ACTIVE) {
+            active++;
+            uint64_t behind = firstRunAfter(order, now) - order.getNextRunIndex();
+            if (behind > MAX_CATCH_UP_RUNS) {
+                uint64_t skip = behind - MAX_CATCH_UP_RUNS;
+                order.setNextRunIndex(order.getNextRunIndex() + skip);
+                order.addSkippedRuns(skip);
+                skipped_runs += skip;
+            }
+        }
+        if (order.getNextRunIndex() != stored_index[i]) {
+            changed.push_back(order);
+        }
+        addLocked(order);
+    }
+    if (!database.saveStandingOrders(changed)) {
+        return false;
+    }
+
+    std::cout << "[DEBUG] Standing orders loaded: " << active << " active, " << recovered_runs
+              << " runs found already made, " << skipped_runs << " skipped" << std::endl;
+    return true;
+}
+
+bool StandingOrderScheduler::start() {
+    if (thread.joinable()) {
+        return true;
+    }
+    if (!load()) {
+        std::cout << "[ERROR] Failed to load standing orders" << std::endl;
+        return false;
+    }
+    stopping = false;
+    thread = std::thread(&StandingOrderScheduler::run, this);
+    return true;
+}
+
+void StandingOrderScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void StandingOrderScheduler::run() {
+    while (true) {
+        tick(std::time(nullptr));
+
+        // Sleep to the start of the next second
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        auto now = std::chrono::system_clock::now();
+        auto next_second = std::chrono::time_point_cast<std::chrono::seconds>(now) + std::chrono::seconds(1);
+        if (wake.wait_for(lock, next_second - now, [this]() { return stopping; })) {
+            return;
+        }
+    }
+}
+
+void StandingOrderScheduler::tick(std::time_t now) {
+    struct DueRun {
+        uint64_t handle;
+        uint64_t index;
+    };
+    std::vector<DueRun> due_runs;
+    std::vector<BatchOperation> operations;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<TimerEntry> due;
+        wheel.advance(now, due);
+
+        for (const auto& entry : due) {
+            auto it = orders.find(entry.id);
+            // Timers of cancelled orders are dropped here
+            if (it == orders.end() || it->second.running ||
+                it->second.order.getStatus() != StandingOrderStatus::ACTIVE ||
+                it->second.order.getNextRun() != entry.due) {
+                continue;
+            }
+            const StandingOrder& order = it->second.order;
+            it->second.running = true;
+
+            BatchOperation operation;
+            operation.type = BatchOperationType::TRANSFER;
+            operation.account_number = order.getFromAccountId();
+            operation.to_account = order.getToAccountId();
+            operation.amount = order.getAmount();
+            operation.description = order.runDescription(order.getNextRunIndex());
+            operations.push_back(operation);
+            due_runs.push_back({entry.id, order.getNextRunIndex()});
+        }
+    }
+    ticks++;
+    if (operations.empty()) {
+        return;
+    }
+    size_t seen = max_due.load();
+    while (operations.size() > seen && !max_due.compare_exchange_weak(seen, operations.size())) {
+    }
+
+    // Chunks of one batch each, applied side by side on the task pool
+    std::vector<std::future<std::vector<TransactionResult>>> pending;
+    for (size_t start = 0; start < operations.size(); start += BankingService::MAX_BATCH_OPERATIONS) {
+        size_t end = std::min(operations.size(), start + BankingService::MAX_BATCH_OPERATIONS);
+        pending.push_back(service.executeBatchAsync(
+            std::vector<BatchOperation>(operations.begin() + start, operations.begin() + end)));
+    }
+    std::vector<TransactionResult> results;
+    results.reserve(operations.size());
+    for (auto& chunk : pending) {
+        std::vector<TransactionResult> chunk_results = chunk.get();
+        results.insert(results.end(), chunk_results.begin(), chunk_results.end());
+    }
+
+    // A run that failed is not tried again; the order moves on to its next
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<StandingOrder> changed;
+    changed.reserve(due_runs.size());
+    for (size_t i = 0; i < due_runs.size(); ++i) {
+        Scheduled& scheduled = orders[due_runs[i].handle];
+        scheduled.running = false;
+        StandingOrder& order = scheduled.order;
+        order.setNextRunIndex(due_runs[i].index + 1);
+        if (results[i].success) {
+            runs++;
+            order.setLastResult(results[i].transaction_id);
+        } else {
+            failed_runs++;
+            order.addFailedRun();
+            order.setLastResult(results[i].message);
+        }
+        changed.push_back(order);
+
+        // Still behind after downtime: the next run is already due and
+        // fires on the next tick
+        if (order.getStatus() == StandingOrderStatus::ACTIVE) {
+            wheel.schedule(due_runs[i].handle, order.getNextRun());
+        }
+    }
+    // Under the lock, so a cancel written meanwhile is not overwritten
+    if (!database.saveStandingOrders(changed)) {
+        std::cout << "[ERROR] Failed to store " << changed.size() << " standing orders" << std::endl;
+    }
+}
+
+bool StandingOrderScheduler::add(const StandingOrder& order) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (handles.count(order.getOrderId()) > 0 || !database.saveStandingOrders({order})) {
+        return false;
+    }
+    addLocked(order);
+    return true;
+}
+
+bool StandingOrderScheduler::cancel(const std::string& order_id, StandingOrder& cancelled) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = handles.find(order_id);
+    if (it == handles.end()) {
+        return false;
+    }
+    StandingOrder& order = orders[it->second].order;
+    if (order.getStatus() != StandingOrderStatus::CANCELLED) {
+        StandingOrder updated = order;
+        updated.setStatus(StandingOrderStatus::CANCELLED);
+        if (!database.saveStandingOrders({updated})) {
+            return false;
+        }
+        order = updated;
+        active_orders--;
+    }
+    cancelled = order;
+    return true;
+}
+
+std::vector<StandingOrder> StandingOrderScheduler::getOrdersForAccount(const std::string& account_number) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<StandingOrder> result;
+    auto it = by_account.find(account_number);
+    if (it == by_account.end()) {
+        return result;
+    }
+    for (uint64_t handle : it->second) {
+        result.push_back(orders[handle].order);
+    }
+    return result;
+}
+
+SchedulerStats StandingOrderScheduler::getStats() {
+    SchedulerStats stats;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.orders = active_orders;
+        stats.timers = wheel.size();
+    }
+    stats.runs = runs;
+    stats.failed_runs = failed_runs;
+    stats.skipped_runs = skipped_runs;
+    stats.recovered_runs = recovered_runs;
+    stats.ticks = ticks;
+    stats.max_due = max_due;
+    return stats;
+}
@@ -0,0 +1,372 @@
+// Bulk transaction import
+// Loads historical transactions from CSV files in the transactions table
+// layout straight into a data directory. Worker threads parse and validate
+// chunks of the input in parallel and append the accepted rows to their
+// shard files; the indexes are built once, at the end. The server must not
+// be running on the same data directory while this runs.
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <unordered_set>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <ctime>
+#include "../include/core/Database.h"
+#include "../include/models/Transaction.h"
+
+namespace {
+
+// Input is read in blocks of about this size, cut at a line boundary
+const size_t CHUNK_BYTES = 8 * 1024 * 1024;
+
+// Accepted rows are appended to a shard once a worker has this much
+const size_t FLUSH_BYTES = 1024 * 1024;
+
+// The storage layer is chatty on stdout; the report goes to the real one
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+};
+
+struct Chunk {
+    std::string file;
+    size_t first_line = 1;
+    std::string data;
+};
+
+// Bounded hand-off from the reader to the workers
+class ChunkQueue {
+public:
+    explicit ChunkQueue(size_t capacity) : capacity(capacity), closed(false) {}
+
+    void push(Chunk chunk) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this] { return chunks.size() < capacity; });
+        chunks.push_back(std::move(chunk));
+        not_empty.notify_one();
+    }
+
+    bool pop(Chunk& chunk) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this] { return closed || !chunks.empty(); });
+        if (chunks.empty()) {
+            return false;
+        }
+        chunk = std::move(chunks.front());
+        chunks.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+    }
+
+private:
+    size_t capacity;
+    bool closed;
+    std::deque<Chunk> chunks;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+};
+
+// Transaction ids seen in this import, striped to keep workers apart
+class SeenIds {
+public:
+    bool insert(const std::string& id) {
+        Stripe& stripe = stripes[std::hash<std::string>{}(id) % stripes.size()];
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        return stripe.ids.insert(id).second;
+    }
+
+private:
+    struct Stripe {
+        std::mutex mutex;
+        std::unordered_set<std::string> ids;
+    };
+    std::vector<Stripe> stripes = std::vector<Stripe>(64);
+};
+
+struct ImportState {
+    Database* database = nullptr;
+    SeenIds seen;
+    std::atomic<size_t> rows_read{0};
+    std::atomic<size_t> rows_imported{0};
+    std::atomic<bool> write_failed{false};
+
+    std::mutex rejects_mutex;
+    std::map<std::string, size_t> rejected; // reason -> rows
+    std::ofstream rejects_file;
+};
+
+// Returns an empty string for a valid row, otherwise why it is rejected
+std::string validateRow(ImportState& state, const std::string& row, Transaction& transaction) {
+    if (std::count(row.begin(), row.end(), ',') != 10) {
+        return "wrong field count";
+    }
+    if (!transaction.fromCsvRow(row)) {
+        return "unparseable";
+    }
+    if (!transaction.isValid()) {
+        return "invalid transaction";
+    }
+
+    // fromCsvRow falls back to the current time; history must keep its own
+    std::string timestamp = row;
+    for (int field = 0; field < 9; ++field) {
+        timestamp.erase(0, timestamp.find(',') + 1);
+    }
+    timestamp.erase(timestamp.find(','));
+    std::tm tm = {};
+    std::istringstream in(timestamp);
+    in >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
+    if (in.fail()) {
+        return "bad timestamp";
+    }
+
+    if (!state.seen.insert(transaction.getTransactionId())) {
+        return "duplicate id";
+    }
+    if (state.database->transactionExists(transaction.getTransactionId())) {
+        return "already imported";
+    }
+    return "";
+}
+
+void importWorker(ImportState& state, ChunkQueue& queue) {
+    size_t shard_count = state.database->getShardCount();
+    std::vector<std::string> pending(shard_count);
+    std::map<std::string, size_t> rejected;
+    std::string rejected_rows;
+
+    auto flush = [&](size_t shard) {
+        if (!pending[shard].empty() && !state.database->bulkAppendTransactions(shard, pending[shard])) {
+            state.write_failed = true;
+        }
+        pending[shard].clear();
+    };
+
+    Chunk chunk;
+    while (queue.pop(chunk)) {
+        size_t line_number = chunk.first_line;
+        size_t start = 0;
+        while (start < chunk.data.size()) {
+            size_t end = chunk.data.find('\n', start);
+            if (end == std::string::npos) {
+                end = chunk.data.size();
+            }
+            std::string row = chunk.data.substr(start, end - start);
+            start = end + 1;
+            size_t current_line = line_number++;
+
+            if (!row.empty() && row.back() == '\r') {
+                row.pop_back();
+            }
+            if (row.empty() || (current_line == 1 && row.compare(0, 15, "transaction_id,") == 0)) {
+                continue;
+            }
+            state.rows_read++;
+
+            Transaction transaction;
+            std::string reason = validateRow(state, row, transaction);
+            if (!reason.empty()) {
+                rejected[reason]++;
+                rejected_rows += chunk.file + ":" + std::to_string(current_line) + "," + reason + "," + row + "\n";
+                continue;
+            }
+
+            size_t shard = state.database->transactionShardIndex(transaction);
+            pending[shard] += row;
+            pending[shard] += "\n";
+            state.rows_imported++;
+            if (pending[shard].size() >= FLUSH_BYTES) {
+                flush(shard);
+            }
+        }
+
+        if (!rejected_rows.empty()) {
+            std::lock_guard<std::mutex> lock(state.rejects_mutex);
+            if (state.rejects_file.is_open()) {
+                state.rejects_file << rejected_rows;
+            }
+            rejected_rows.clear();
+        }
+    }
+
+    for (size_t shard = 0; shard < shard_count; ++shard) {
+        flush(shard);
+    }
+
+    std::lock_guard<std::mutex> lock(state.rejects_mutex);
+    for (const auto& entry : rejected) {
+        state.rejected[entry.first] += entry.second;
+    }
+}
+
+// Feeds one file to the workers in line-aligned chunks
+bool readFile(const std::string& path, ChunkQueue& queue) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+
+    size_t next_line = 1;
+    std::string carry;
+    std::vector<char> buffer(CHUNK_BYTES);
+    while (in) {
+        in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        std::streamsize got = in.gcount();
+        if (got <= 0) {
+            break;
+        }
+
+        Chunk chunk;
+        chunk.file = path;
+        chunk.first_line = next_line;
+        chunk.data = std::move(carry);
+        chunk.data.append(buffer.data(), static_cast<size_t>(got));
+
+        // The partial last line goes with the next chunk
+        size_t last_newline = chunk.data.rfind('\n');
+        if (last_newline == std::string::npos) {
+            carry = std::move(chunk.data);
+            continue;
+        }
+        carry = chunk.data.substr(last_newline + 1);
+        chunk.data.resize(last_newline + 1);
+
+        next_line += static_cast<size_t>(std::count(chunk.data.begin(), chunk.data.end(), '\n'));
+        queue.push(std::move(chunk));
+    }
+
+    if (!carry.empty()) {
+        Chunk chunk;
+        chunk.file = path;
+        chunk.first_line = next_line;
+        chunk.data = std::move(carry);
+        queue.push(std::move(chunk));
+    }
+    return true;
+}
+
+void printUsage() {
+    std::cout << "Usage: banking_import --data <path> [options] <file.csv>..." << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --threads <n>    Parser threads (default: hardware threads)" << std::endl;
+    std::cout << "  --shards <n>     Shard count for a new data directory (default: 1)" << std::endl;
+    std::cout << "  --rejects <path> Write rejected rows as file:line,reason,row" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string data_dir;
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t shard_count = 1;
+    std::string rejects_path;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help") {
+            printUsage();
+            return 0;
+        } else if (arg == "--data" && i + 1 < argc) {
+            data_dir = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (arg == "--shards" && i + 1 < argc) {
+            shard_count = std::stoul(argv[++i]);
+        } else if (arg == "--rejects" && i + 1 < argc) {
+            rejects_path = argv[++i];
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    if (data_dir.empty() || inputs.empty()) {
+        printUsage();
+        return 1;
+    }
+
+    std::ostream report(std::cout.rdbuf());
+    static NullBuffer null_buffer;
+    std::cout.rdbuf(&null_buffer);
+
+    Database database(data_dir, shard_count);
+    if (!database.initialize()) {
+        report << "Failed to open data directory " << data_dir << std::endl;
+        return 1;
+    }
+
+    ImportState state;
+    state.database = &database;
+    if (!rejects_path.empty()) {
+        state.rejects_file.open(rejects_path, std::ios::trunc);
+        if (!state.rejects_file.is_open()) {
+            report << "Cannot write " << rejects_path << std::endl;
+            return 1;
+        }
+    }
+
+    auto started = std::chrono::steady_clock::now();
+
+    ChunkQueue queue(threads * 2);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back(importWorker, std::ref(state), std::ref(queue));
+    }
+
+    bool inputs_ok = true;
+    for (const auto& input : inputs) {
+        if (!readFile(input, queue)) {
+            report << "Cannot read " << input << std::endl;
+            inputs_ok = false;
+        }
+    }
+    queue.close();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    auto parsed = std::chrono::steady_clock::now();
+    bool indexed = database.finishBulkImport();
+    auto finished = std::chrono::steady_clock::now();
+
+    double load_seconds = std::chrono::duration<double>(parsed - started).count();
+    double index_seconds = std::chrono::duration<double>(finished - parsed).count();
+    double total_seconds = std::chrono::duration<double>(finished - started).count();
+    size_t rejected_total = state.rows_read - state.rows_imported;
+
+    report << std::fixed << std::setprecision(2);
+    report << "Rows read:     " << state.rows_read << std::endl;
+    report << "Rows imported: " << state.rows_imported << std::endl;
+    report << "Rows rejected: " << rejected_total << std::endl;
+    for (const auto& entry : state.rejected) {
+        report << "  " << entry.first << ": " << entry.second << std::endl;
+    }
+    report << "Parse and write: " << load_seconds << " s, "
+           << (load_seconds > 0 ? state.rows_read / load_seconds : 0.0) << " rows/s ("
+           << threads << " threads)" << std::endl;
+    report << "Index build:     " << index_seconds << " s" << std::endl;
+    report << "Total:           " << total_seconds << " s, "
+           << (total_seconds > 0 ? state.rows_imported / total_seconds : 0.0) << " rows/s imported" << std::endl;
+
+    if (state.write_failed || !indexed) {
+        report << "Import failed while writing " << data_dir << std::endl;
+        return 1;
+    }
+    return inputs_ok ? 0 : 1;
+}